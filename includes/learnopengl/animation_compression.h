@@ -0,0 +1,456 @@
+#pragma once
+
+/* Compressed clip storage. Keys that interpolating their neighbours reproduces within a tolerance are
+   dropped, constant tracks collapse to a single key, rotations are stored as 48-bit smallest-three
+   quaternions and translations/scales as 16-bit values inside a per-track range. Sampling decompresses
+   the two keys around the requested time on the fly. */
+
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <learnopengl/animation.h>
+#include <learnopengl/bone.h>
+#include <learnopengl/skeleton.h>
+
+struct CompressionSettings
+{
+	float positionTolerance = 0.001f;  // model units
+	float rotationTolerance = 0.0005f; // radians
+	float scaleTolerance = 0.0001f;
+};
+
+// Memory of a clip's Bone keys against the compressed copy, and the worst bone-space difference between them
+struct CompressionReport
+{
+	size_t uncompressedBytes;
+	size_t compressedBytes;
+	int uncompressedKeys;
+	int compressedKeys;
+	int constantTracks;
+	float maxPositionError;
+	float maxRotationError; // radians
+	float maxScaleError;
+};
+
+class CompressedClip
+{
+public:
+	CompressedClip() = default;
+
+	CompressedClip(const Skeleton& skeleton, Animation* animation, const CompressionSettings& settings = CompressionSettings())
+	{
+		m_Duration = animation->GetDuration();
+		m_TicksPerSecond = animation->GetTicksPerSecond();
+
+		std::vector<Bone*> tracks = skeleton.BindAnimation(animation);
+
+		// Key times are quantized over [0, m_TimeRange]; a few exporters put keys slightly past the duration
+		m_TimeRange = m_Duration;
+		for (Bone* bone : tracks)
+		{
+			if (!bone)
+				continue;
+			if (!bone->GetPositionKeys().empty())
+				m_TimeRange = glm::max(m_TimeRange, bone->GetPositionKeys().back().timeStamp);
+			if (!bone->GetRotationKeys().empty())
+				m_TimeRange = glm::max(m_TimeRange, bone->GetRotationKeys().back().timeStamp);
+			if (!bone->GetScaleKeys().empty())
+				m_TimeRange = glm::max(m_TimeRange, bone->GetScaleKeys().back().timeStamp);
+		}
+		if (m_TimeRange <= 0.0f)
+			m_TimeRange = 1.0f;
+
+		m_NodeTracks.assign(tracks.size(), -1);
+		for (size_t node = 0; node < tracks.size(); node++)
+		{
+			if (!tracks[node])
+				continue;
+			m_NodeTracks[node] = static_cast<int>(m_Tracks.size());
+			m_Tracks.push_back(CompressTrack(*tracks[node], settings));
+		}
+	}
+
+	// Decompresses the keys around animationTime in each channel of a track and interpolates them like Bone does
+	void SampleTrack(int track, float animationTime, BoneCursor& cursor, glm::vec3& position, glm::quat& rotation, glm::vec3& scale) const
+	{
+		const Track& data = m_Tracks[track];
+		float factor;
+
+		int key = FindKey(data, POSITION, animationTime, cursor.position, factor);
+		int next = key + (data.channels[POSITION].keyCount > 1);
+		position = glm::mix(DecodeVector(data, POSITION, key), DecodeVector(data, POSITION, next), factor);
+
+		key = FindKey(data, ROTATION, animationTime, cursor.rotation, factor);
+		next = key + (data.channels[ROTATION].keyCount > 1);
+		rotation = glm::normalize(glm::slerp(DecodeRotation(data, key), DecodeRotation(data, next), factor));
+
+		key = FindKey(data, SCALE, animationTime, cursor.scale, factor);
+		next = key + (data.channels[SCALE].keyCount > 1);
+		scale = glm::mix(DecodeVector(data, SCALE, key), DecodeVector(data, SCALE, next), factor);
+	}
+
+	glm::mat4 GetTransform(int track, float animationTime, BoneCursor& cursor) const
+	{
+		glm::vec3 position, scale;
+		glm::quat rotation;
+		SampleTrack(track, animationTime, cursor, position, rotation, scale);
+		return glm::translate(glm::mat4(1.0f), position) * glm::toMat4(rotation) * glm::scale(glm::mat4(1.0f), scale);
+	}
+
+	// Track for a skeleton node, -1 when the clip doesn't animate it
+	int GetNodeTrack(int node) const { return m_NodeTracks[node]; }
+	int GetTrackCount() const { return static_cast<int>(m_Tracks.size()); }
+	float GetDuration() const { return m_Duration; }
+	float GetTicksPerSecond() const { return m_TicksPerSecond; }
+
+	size_t GetMemorySize() const
+	{
+		size_t bytes = m_NodeTracks.size() * sizeof(int) + m_Tracks.size() * sizeof(Track);
+		for (int channel = 0; channel < CHANNEL_COUNT; channel++)
+			bytes += (m_Times[channel].size() + m_Values[channel].size()) * sizeof(uint16_t);
+		return bytes;
+	}
+
+	// Samples this clip and the uncompressed one at sampleCount + 1 evenly spaced times and compares the
+	// local (bone-space) translation, rotation and scale of every track
+	CompressionReport Measure(const Skeleton& skeleton, Animation* animation, int sampleCount) const
+	{
+		CompressionReport report = {};
+		report.compressedBytes = GetMemorySize();
+
+		std::vector<Bone*> tracks = skeleton.BindAnimation(animation);
+		for (size_t node = 0; node < tracks.size(); node++)
+		{
+			if (!tracks[node])
+				continue;
+			const Bone& bone = *tracks[node];
+			report.uncompressedKeys += static_cast<int>(bone.GetPositionKeys().size() + bone.GetRotationKeys().size() + bone.GetScaleKeys().size());
+			report.uncompressedBytes += bone.GetPositionKeys().size() * sizeof(KeyPosition)
+				+ bone.GetRotationKeys().size() * sizeof(KeyRotation) + bone.GetScaleKeys().size() * sizeof(KeyScale);
+
+			const Track& track = m_Tracks[m_NodeTracks[node]];
+			bool constant = true;
+			for (int channel = 0; channel < CHANNEL_COUNT; channel++)
+			{
+				report.compressedKeys += track.channels[channel].keyCount;
+				constant = constant && track.channels[channel].keyCount == 1;
+			}
+			report.constantTracks += constant;
+		}
+
+		std::vector<BoneCursor> boneCursors(tracks.size()), cursors(tracks.size());
+		for (int sample = 0; sample <= sampleCount; sample++)
+		{
+			float animationTime = sampleCount > 0 ? m_Duration * sample / sampleCount : 0.0f;
+			for (size_t node = 0; node < tracks.size(); node++)
+			{
+				if (!tracks[node])
+					continue;
+				glm::vec3 position, scale;
+				glm::quat rotation;
+				SampleTrack(m_NodeTracks[node], animationTime, cursors[node], position, rotation, scale);
+
+				const Bone& bone = *tracks[node];
+				report.maxPositionError = glm::max(report.maxPositionError, glm::length(bone.GetInterpolatedPosition(animationTime, boneCursors[node]) - position));
+				report.maxRotationError = glm::max(report.maxRotationError, RotationAngle(bone.GetInterpolatedRotation(animationTime, boneCursors[node]), rotation));
+				report.maxScaleError = glm::max(report.maxScaleError, glm::length(bone.GetInterpolatedScaling(animationTime, boneCursors[node]) - scale));
+			}
+		}
+		return report;
+	}
+
+	// Compress once offline and load the result at startup instead of compressing again. The file is a raw
+	// dump in host byte order, meant for the machine that wrote it.
+	bool Save(const std::string& path) const
+	{
+		std::ofstream file(path, std::ios::binary);
+		if (!file)
+			return false;
+		uint32_t header[4] = { FileMagic, FileVersion, static_cast<uint32_t>(m_NodeTracks.size()), static_cast<uint32_t>(m_Tracks.size()) };
+		float timing[3] = { m_Duration, m_TicksPerSecond, m_TimeRange };
+		file.write(reinterpret_cast<const char*>(header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(timing), sizeof(timing));
+		file.write(reinterpret_cast<const char*>(m_NodeTracks.data()), m_NodeTracks.size() * sizeof(int));
+		file.write(reinterpret_cast<const char*>(m_Tracks.data()), m_Tracks.size() * sizeof(Track));
+		for (int channel = 0; channel < CHANNEL_COUNT; channel++)
+		{
+			uint32_t sizes[2] = { static_cast<uint32_t>(m_Times[channel].size()), static_cast<uint32_t>(m_Values[channel].size()) };
+			file.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+			file.write(reinterpret_cast<const char*>(m_Times[channel].data()), m_Times[channel].size() * sizeof(uint16_t));
+			file.write(reinterpret_cast<const char*>(m_Values[channel].data()), m_Values[channel].size() * sizeof(uint16_t));
+		}
+		return static_cast<bool>(file);
+	}
+
+	bool Load(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		uint32_t header[4];
+		if (!file.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != FileMagic || header[1] != FileVersion)
+			return false;
+		float timing[3];
+		file.read(reinterpret_cast<char*>(timing), sizeof(timing));
+		m_Duration = timing[0];
+		m_TicksPerSecond = timing[1];
+		m_TimeRange = timing[2];
+		m_NodeTracks.resize(header[2]);
+		m_Tracks.resize(header[3]);
+		file.read(reinterpret_cast<char*>(m_NodeTracks.data()), m_NodeTracks.size() * sizeof(int));
+		file.read(reinterpret_cast<char*>(m_Tracks.data()), m_Tracks.size() * sizeof(Track));
+		for (int channel = 0; channel < CHANNEL_COUNT; channel++)
+		{
+			uint32_t sizes[2] = { 0, 0 };
+			file.read(reinterpret_cast<char*>(sizes), sizeof(sizes));
+			m_Times[channel].resize(sizes[0]);
+			m_Values[channel].resize(sizes[1]);
+			file.read(reinterpret_cast<char*>(m_Times[channel].data()), m_Times[channel].size() * sizeof(uint16_t));
+			file.read(reinterpret_cast<char*>(m_Values[channel].data()), m_Values[channel].size() * sizeof(uint16_t));
+		}
+		return static_cast<bool>(file);
+	}
+
+	// Angle between two rotations, from the chord length so tiny errors don't vanish in acos
+	static float RotationAngle(const glm::quat& a, glm::quat b)
+	{
+		if (glm::dot(a, b) < 0.0f)
+			b = -b;
+		glm::quat difference = a - b;
+		float chord = std::sqrt(glm::dot(difference, difference));
+		return 4.0f * std::asin(glm::min(chord * 0.5f, 1.0f));
+	}
+
+private:
+	enum Channel { POSITION = 0, ROTATION, SCALE, CHANNEL_COUNT };
+
+	static const uint32_t FileMagic = 0x504d4341; // "ACMP"
+	static const uint32_t FileVersion = 1;
+
+	struct ChannelKeys
+	{
+		int firstKey; // into m_Times[channel]; values start at firstKey * 3 in m_Values[channel]
+		int keyCount;
+	};
+
+	struct Track
+	{
+		ChannelKeys channels[CHANNEL_COUNT];
+		// Dequantization ranges of the position (0) and scale (1) channels
+		glm::vec3 rangeMin[2];
+		glm::vec3 rangeExtent[2];
+	};
+
+	// One channel of a Bone before quantization; vectors use xyz, rotations xyzw
+	struct ChannelSamples
+	{
+		std::vector<float> times;
+		std::vector<glm::vec4> values;
+	};
+
+	Track CompressTrack(const Bone& bone, const CompressionSettings& settings)
+	{
+		ChannelSamples samples[CHANNEL_COUNT];
+		for (const KeyPosition& key : bone.GetPositionKeys())
+			AddSample(samples[POSITION], key.timeStamp, glm::vec4(key.position, 0.0f));
+		for (const KeyRotation& key : bone.GetRotationKeys())
+			AddSample(samples[ROTATION], key.timeStamp, glm::vec4(key.orientation.x, key.orientation.y, key.orientation.z, key.orientation.w));
+		for (const KeyScale& key : bone.GetScaleKeys())
+			AddSample(samples[SCALE], key.timeStamp, glm::vec4(key.scale, 0.0f));
+
+		// A track without keys on a channel samples as identity, same as a one-key track would
+		if (samples[POSITION].values.empty())
+			AddSample(samples[POSITION], 0.0f, glm::vec4(0.0f));
+		if (samples[ROTATION].values.empty())
+			AddSample(samples[ROTATION], 0.0f, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+		if (samples[SCALE].values.empty())
+			AddSample(samples[SCALE], 0.0f, glm::vec4(1.0f, 1.0f, 1.0f, 0.0f));
+
+		const float tolerances[CHANNEL_COUNT] = { settings.positionTolerance, settings.rotationTolerance, settings.scaleTolerance };
+
+		Track track;
+		for (int channel = 0; channel < CHANNEL_COUNT; channel++)
+		{
+			ChannelSamples reduced = ReduceKeys(samples[channel], channel == ROTATION, tolerances[channel]);
+			int keyCount = static_cast<int>(reduced.values.size());
+			track.channels[channel].firstKey = static_cast<int>(m_Times[channel].size());
+			track.channels[channel].keyCount = keyCount;
+
+			for (float time : reduced.times)
+				m_Times[channel].push_back(Quantize(time / m_TimeRange));
+
+			if (channel == ROTATION)
+			{
+				for (const glm::vec4& value : reduced.values)
+					EncodeRotation(glm::quat(value.w, value.x, value.y, value.z));
+				continue;
+			}
+
+			int range = channel == POSITION ? 0 : 1;
+			glm::vec3 low(reduced.values[0]), high(reduced.values[0]);
+			for (const glm::vec4& value : reduced.values)
+			{
+				low = glm::min(low, glm::vec3(value));
+				high = glm::max(high, glm::vec3(value));
+			}
+			track.rangeMin[range] = low;
+			track.rangeExtent[range] = high - low;
+
+			for (const glm::vec4& value : reduced.values)
+				for (int component = 0; component < 3; component++)
+				{
+					float extent = track.rangeExtent[range][component];
+					float normalized = extent > 0.0f ? (value[component] - low[component]) / extent : 0.0f;
+					m_Values[channel].push_back(Quantize(normalized));
+				}
+		}
+		return track;
+	}
+
+	static void AddSample(ChannelSamples& samples, float time, const glm::vec4& value)
+	{
+		samples.times.push_back(time);
+		samples.values.push_back(value);
+	}
+
+	static glm::vec4 InterpolateSample(const glm::vec4& a, const glm::vec4& b, float factor, bool rotation)
+	{
+		if (!rotation)
+			return glm::mix(a, b, factor);
+		glm::quat q = glm::normalize(glm::slerp(glm::quat(a.w, a.x, a.y, a.z), glm::quat(b.w, b.x, b.y, b.z), factor));
+		return glm::vec4(q.x, q.y, q.z, q.w);
+	}
+
+	static float SampleError(const glm::vec4& a, const glm::vec4& b, bool rotation)
+	{
+		if (!rotation)
+			return glm::length(glm::vec3(a) - glm::vec3(b));
+		return RotationAngle(glm::quat(a.w, a.x, a.y, a.z), glm::quat(b.w, b.x, b.y, b.z));
+	}
+
+	// Greedy key reduction: starting from the last kept key, extend the interval as long as interpolating
+	// across it reproduces every skipped key within tolerance. Tracks that never leave the tolerance around
+	// their first key collapse to that key.
+	static ChannelSamples ReduceKeys(const ChannelSamples& samples, bool rotation, float tolerance)
+	{
+		const int count = static_cast<int>(samples.values.size());
+		ChannelSamples reduced;
+		AddSample(reduced, samples.times[0], samples.values[0]);
+
+		bool constant = true;
+		for (int i = 1; i < count && constant; i++)
+			constant = SampleError(samples.values[0], samples.values[i], rotation) <= tolerance;
+		if (constant)
+			return reduced;
+
+		int anchor = 0;
+		for (int candidate = 2; candidate < count; candidate++)
+		{
+			float span = samples.times[candidate] - samples.times[anchor];
+			bool fits = span > 0.0f;
+			for (int skipped = anchor + 1; skipped < candidate && fits; skipped++)
+			{
+				float factor = (samples.times[skipped] - samples.times[anchor]) / span;
+				glm::vec4 value = InterpolateSample(samples.values[anchor], samples.values[candidate], factor, rotation);
+				fits = SampleError(value, samples.values[skipped], rotation) <= tolerance;
+			}
+			if (!fits)
+			{
+				anchor = candidate - 1;
+				AddSample(reduced, samples.times[anchor], samples.values[anchor]);
+			}
+		}
+		AddSample(reduced, samples.times[count - 1], samples.values[count - 1]);
+		return reduced;
+	}
+
+	static uint16_t Quantize(float normalized)
+	{
+		return static_cast<uint16_t>(glm::clamp(normalized, 0.0f, 1.0f) * 65535.0f + 0.5f);
+	}
+
+	// Smallest three: the largest component is dropped (its sign is made positive, q and -q are the same
+	// rotation) and rebuilt from the unit length; the other three lie in [-1/sqrt(2), 1/sqrt(2)] and get
+	// 15 bits each. The dropped component's index goes in the top bits of the first two words.
+	void EncodeRotation(glm::quat rotation)
+	{
+		rotation = glm::normalize(rotation);
+		float components[4] = { rotation.x, rotation.y, rotation.z, rotation.w };
+		int largest = 0;
+		for (int i = 1; i < 4; i++)
+			if (std::abs(components[i]) > std::abs(components[largest]))
+				largest = i;
+		float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+
+		uint16_t words[3];
+		for (int i = 0, word = 0; i < 4; i++)
+		{
+			if (i == largest)
+				continue;
+			float normalized = (components[i] * sign * SmallestThreeScale + 1.0f) * 0.5f;
+			words[word++] = static_cast<uint16_t>(glm::clamp(normalized, 0.0f, 1.0f) * 32767.0f + 0.5f);
+		}
+		words[0] |= static_cast<uint16_t>((largest & 1) << 15);
+		words[1] |= static_cast<uint16_t>((largest >> 1) << 15);
+		m_Values[ROTATION].insert(m_Values[ROTATION].end(), words, words + 3);
+	}
+
+	glm::quat DecodeRotation(const Track& track, int key) const
+	{
+		const uint16_t* words = &m_Values[ROTATION][(track.channels[ROTATION].firstKey + key) * 3];
+		int largest = (words[0] >> 15) | ((words[1] >> 15) << 1);
+
+		float components[4];
+		float sumOfSquares = 0.0f;
+		for (int i = 0, word = 0; i < 4; i++)
+		{
+			if (i == largest)
+				continue;
+			float value = ((words[word++] & 0x7fff) * (2.0f / 32767.0f) - 1.0f) / SmallestThreeScale;
+			components[i] = value;
+			sumOfSquares += value * value;
+		}
+		components[largest] = std::sqrt(glm::max(0.0f, 1.0f - sumOfSquares));
+		return glm::quat(components[3], components[0], components[1], components[2]);
+	}
+
+	glm::vec3 DecodeVector(const Track& track, int channel, int key) const
+	{
+		const uint16_t* words = &m_Values[channel][(track.channels[channel].firstKey + key) * 3];
+		int range = channel == POSITION ? 0 : 1;
+		return track.rangeMin[range] + glm::vec3(words[0], words[1], words[2]) * (track.rangeExtent[range] / 65535.0f);
+	}
+
+	float DecodeTime(const Track& track, int channel, int key) const
+	{
+		return m_Times[channel][track.channels[channel].firstKey + key] * (m_TimeRange / 65535.0f);
+	}
+
+	// Same lookup and clamping as Bone; reduced tracks are never uniform, so the cursor does the work
+	int FindKey(const Track& track, int channel, float animationTime, int& cursor, float& factor) const
+	{
+		factor = 0.0f;
+		int keyCount = track.channels[channel].keyCount;
+		if (keyCount < 2)
+			return 0;
+
+		int key = FindKeyframe(keyCount, 0.0f, animationTime, cursor, [&](int i) { return DecodeTime(track, channel, i); });
+		float start = DecodeTime(track, channel, key);
+		float span = DecodeTime(track, channel, key + 1) - start;
+		if (span > 0.0f)
+			factor = glm::clamp((animationTime - start) / span, 0.0f, 1.0f);
+		return key;
+	}
+
+	static constexpr float SmallestThreeScale = 1.41421356f; // sqrt(2)
+
+	std::vector<int> m_NodeTracks;
+	std::vector<Track> m_Tracks;
+	std::vector<uint16_t> m_Times[CHANNEL_COUNT];
+	std::vector<uint16_t> m_Values[CHANNEL_COUNT]; // three words per key in every channel
+
+	float m_Duration = 0.0f;
+	float m_TicksPerSecond = 0.0f;
+	float m_TimeRange = 1.0f;
+};
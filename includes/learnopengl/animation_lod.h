@@ -0,0 +1,201 @@
+#pragma once
+
+/* Update-rate LOD for crowds. Each character is evaluated every frame, every second or fourth frame, or
+   not at all, depending on its distance and visibility. The due characters are then time-sliced under a
+   per-frame budget of bone evaluations (one hierarchy node sampled and concatenated), most overdue first,
+   so a spike of due characters spreads over the next frames. Characters that aren't evaluated in a frame
+   hold, interpolate or extrapolate their last two palettes; GetInBetween says which. A character is always
+   evaluated on its first frame, frozen or not and whatever the budget, so it never holds a palette it
+   hasn't got yet. */
+
+#include <algorithm>
+#include <vector>
+#include <glm/glm.hpp>
+
+enum class AnimationLod
+{
+	Full,
+	Half,
+	Quarter,
+	Frozen
+};
+
+enum class LodInBetween
+{
+	Hold,        // keep the last palette
+	Interpolate, // blend the last two palettes; smooth, but runs one update interval behind
+	Extrapolate  // continue the motion of the last two palettes for up to one interval
+};
+
+struct AnimationLodSettings
+{
+	float halfRateDistance = 10.0f;
+	float quarterRateDistance = 25.0f;
+	float frozenDistance = 60.0f;
+	AnimationLod offscreenLod = AnimationLod::Quarter; // at least this coarse when not visible
+	int boneBudget = 0;                                // bone evaluations per frame, 0 for no limit
+	LodInBetween inBetween = LodInBetween::Extrapolate;
+};
+
+struct AnimationLodStats
+{
+	int instanceCounts[4] = {}; // per AnimationLod
+	int updated = 0;
+	int firstEvaluations = 0;   // of the updated, new instances evaluated regardless of LOD and budget
+	int deferred = 0;           // due, but left for a later frame by the budget
+	int boneEvaluations = 0;
+	int skippedBoneEvaluations = 0; // against evaluating every instance every frame
+};
+
+class AnimationLodScheduler
+{
+public:
+	explicit AnimationLodScheduler(const AnimationLodSettings& settings = AnimationLodSettings())
+		: m_Settings(settings)
+	{
+	}
+
+	void SetSettings(const AnimationLodSettings& settings) { m_Settings = settings; }
+	const AnimationLodSettings& GetSettings() const { return m_Settings; }
+
+	// New instances start visible at distance 0. After their first evaluation they're staggered, so
+	// same-rate instances don't keep coming due on the same frame.
+	void Resize(int instanceCount)
+	{
+		size_t oldCount = m_Instances.size();
+		m_Instances.resize(instanceCount);
+		for (size_t i = oldCount; i < m_Instances.size(); i++)
+			m_Instances[i].stagger = static_cast<int>(i % 4);
+	}
+
+	void SetView(int instance, float distance, bool visible)
+	{
+		m_Instances[instance].distance = distance;
+		m_Instances[instance].visible = visible;
+	}
+
+	// Once per frame, before evaluating. bonesPerInstance is the cost of one full evaluation.
+	void Schedule(float dt, int bonesPerInstance)
+	{
+		m_Stats = AnimationLodStats();
+		m_Due.clear();
+		for (int i = 0; i < static_cast<int>(m_Instances.size()); i++)
+		{
+			InstanceState& state = m_Instances[i];
+			state.lod = ChooseLod(state);
+			state.elapsed += dt;
+			state.framesSinceUpdate++;
+			state.scheduled = false;
+			state.firstEvaluation = false;
+			m_Stats.instanceCounts[static_cast<int>(state.lod)]++;
+			if (!state.updatedOnce || (state.lod != AnimationLod::Frozen && state.framesSinceUpdate >= FrameInterval(state.lod)))
+				m_Due.push_back(i);
+		}
+
+		// Never evaluated first, then most overdue (relative to the instance's own rate), nearest first
+		// among equals
+		std::sort(m_Due.begin(), m_Due.end(), [this](int a, int b)
+		{
+			const InstanceState& first = m_Instances[a];
+			const InstanceState& second = m_Instances[b];
+			if (first.updatedOnce != second.updatedOnce)
+				return !first.updatedOnce;
+			if (!first.updatedOnce)
+				return first.distance < second.distance;
+			float overdueA = static_cast<float>(first.framesSinceUpdate) / FrameInterval(first.lod);
+			float overdueB = static_cast<float>(second.framesSinceUpdate) / FrameInterval(second.lod);
+			if (overdueA != overdueB)
+				return overdueA > overdueB;
+			return first.distance < second.distance;
+		});
+
+		for (int instance : m_Due)
+		{
+			InstanceState& state = m_Instances[instance];
+			if (state.updatedOnce && m_Settings.boneBudget > 0 && m_Stats.boneEvaluations + bonesPerInstance > m_Settings.boneBudget)
+			{
+				m_Stats.deferred++;
+				continue;
+			}
+			state.scheduled = true;
+			state.firstEvaluation = !state.updatedOnce;
+			state.advance = state.elapsed;
+			state.interval = state.updatedOnce ? state.elapsed : 0.0f;
+			state.updatedOnce = true;
+			state.elapsed = 0.0f;
+			state.framesSinceUpdate = state.firstEvaluation ? state.stagger : 0;
+			m_Stats.updated++;
+			m_Stats.firstEvaluations += state.firstEvaluation ? 1 : 0;
+			m_Stats.boneEvaluations += bonesPerInstance;
+		}
+		m_Stats.skippedBoneEvaluations = static_cast<int>(m_Instances.size()) * bonesPerInstance - m_Stats.boneEvaluations;
+	}
+
+	// Results of the last Schedule
+	bool IsScheduled(int instance) const { return m_Instances[instance].scheduled; }
+	// Scheduled for the first time: both of its last two palettes should be set to this evaluation
+	bool IsFirstEvaluation(int instance) const { return m_Instances[instance].firstEvaluation; }
+	// Time a scheduled instance advances by: everything since its previous evaluation
+	float GetAdvance(int instance) const { return m_Instances[instance].advance; }
+	AnimationLod GetLod(int instance) const { return m_Instances[instance].lod; }
+	const AnimationLodStats& GetStats() const { return m_Stats; }
+
+	// How to display the instance this frame, with factor 0 at its last evaluation and 1 one update
+	// interval later. Full-rate instances evaluated this frame, frozen ones and those with only one
+	// evaluation so far show their last palette as is.
+	LodInBetween GetInBetween(int instance, float& factor) const
+	{
+		const InstanceState& state = m_Instances[instance];
+		factor = 0.0f;
+		if (state.lod == AnimationLod::Frozen || state.interval <= 0.0f || (state.scheduled && state.lod == AnimationLod::Full))
+			return LodInBetween::Hold;
+		factor = glm::min(state.elapsed / state.interval, 1.0f);
+		return m_Settings.inBetween;
+	}
+
+	static int FrameInterval(AnimationLod lod)
+	{
+		switch (lod)
+		{
+		case AnimationLod::Full: return 1;
+		case AnimationLod::Half: return 2;
+		case AnimationLod::Quarter: return 4;
+		default: return 0;
+		}
+	}
+
+private:
+	struct InstanceState
+	{
+		float distance = 0.0f;
+		bool visible = true;
+		AnimationLod lod = AnimationLod::Full;
+		int framesSinceUpdate = 0;
+		int stagger = 0;       // framesSinceUpdate right after the first evaluation
+		float elapsed = 0.0f;  // since the last evaluation
+		float advance = 0.0f;
+		float interval = 0.0f; // between the last two evaluations
+		bool updatedOnce = false;
+		bool scheduled = false;
+		bool firstEvaluation = false;
+	};
+
+	AnimationLod ChooseLod(const InstanceState& state) const
+	{
+		AnimationLod lod = AnimationLod::Full;
+		if (state.distance >= m_Settings.frozenDistance)
+			lod = AnimationLod::Frozen;
+		else if (state.distance >= m_Settings.quarterRateDistance)
+			lod = AnimationLod::Quarter;
+		else if (state.distance >= m_Settings.halfRateDistance)
+			lod = AnimationLod::Half;
+		if (!state.visible && lod < m_Settings.offscreenLod)
+			lod = m_Settings.offscreenLod;
+		return lod;
+	}
+
+	AnimationLodSettings m_Settings;
+	std::vector<InstanceState> m_Instances;
+	std::vector<int> m_Due;
+	AnimationLodStats m_Stats;
+};
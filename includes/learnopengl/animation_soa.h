@@ -0,0 +1,416 @@
+#pragma once
+
+/* Structure-of-arrays clip storage: every channel keeps the time stamps and each component of all of
+   its tracks in separate aligned arrays, so SimdFloat::Width tracks are interpolated per instruction */
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <learnopengl/simd.h>
+#include <learnopengl/bone.h>
+#include <learnopengl/skeleton.h>
+#include <learnopengl/animation.h>
+
+enum SoaChannel
+{
+	SOA_POSITION = 0,
+	SOA_ROTATION,
+	SOA_SCALE,
+	SOA_CHANNEL_COUNT
+};
+
+// Sizes of the arrays in a clip's data block; everything else follows from ComputeLayout
+struct SoaClipHeader
+{
+	int trackCount;
+	int nodeCount;
+	int keyCounts[SOA_CHANNEL_COUNT];
+	float duration;
+	float ticksPerSecond;
+};
+
+/* Local transforms of every track of a clip, one aligned array per component
+   (position xyz, rotation xyzw, scale xyz) */
+class SoaPose
+{
+public:
+	static const int ComponentCount = 10;
+
+	void Resize(int trackCount)
+	{
+		m_Capacity = SimdPad(glm::max(trackCount, 1));
+		m_Storage.Resize(sizeof(float) * m_Capacity * ComponentCount);
+	}
+
+	float* Data(int component) { return m_Storage.As<float>() + component * m_Capacity; }
+	const float* Data(int component) const { return m_Storage.As<float>() + component * m_Capacity; }
+
+	glm::vec3 GetPosition(int track) const { return glm::vec3(Data(0)[track], Data(1)[track], Data(2)[track]); }
+	glm::quat GetRotation(int track) const { return glm::quat(Data(6)[track], Data(3)[track], Data(4)[track], Data(5)[track]); }
+	glm::vec3 GetScale(int track) const { return glm::vec3(Data(7)[track], Data(8)[track], Data(9)[track]); }
+
+	glm::mat4 GetTransform(int track) const
+	{
+		glm::mat4 translation = glm::translate(glm::mat4(1.0f), GetPosition(track));
+		glm::mat4 rotation = glm::toMat4(GetRotation(track));
+		glm::mat4 scale = glm::scale(glm::mat4(1.0f), GetScale(track));
+		return translation * rotation * scale;
+	}
+
+private:
+	AlignedBuffer m_Storage;
+	int m_Capacity = 0;
+};
+
+// Worst difference between the SIMD sampler and Bone's scalar sampling; rotation is an angle in radians
+struct SoaSamplingError
+{
+	float position;
+	float rotation;
+	float scale;
+};
+
+class SoaClip
+{
+public:
+	SoaClip() = default;
+
+	// Copies the clip's keys into one aligned block, with tracks in skeleton node order
+	SoaClip(const Skeleton& skeleton, Animation* animation)
+	{
+		std::vector<Bone*> tracks = skeleton.BindAnimation(animation);
+		std::vector<Bone*> bones;
+		for (Bone* bone : tracks)
+			if (bone)
+				bones.push_back(bone);
+
+		m_Header.trackCount = static_cast<int>(bones.size());
+		m_Header.nodeCount = skeleton.GetNodeCount();
+		m_Header.duration = animation->GetDuration();
+		m_Header.ticksPerSecond = animation->GetTicksPerSecond();
+		for (int channel = 0; channel < SOA_CHANNEL_COUNT; channel++)
+			m_Header.keyCounts[channel] = 0;
+		for (Bone* bone : bones)
+		{
+			m_Header.keyCounts[SOA_POSITION] += static_cast<int>(bone->GetPositionKeys().size());
+			m_Header.keyCounts[SOA_ROTATION] += static_cast<int>(bone->GetRotationKeys().size());
+			m_Header.keyCounts[SOA_SCALE] += static_cast<int>(bone->GetScaleKeys().size());
+		}
+
+		ComputeLayout();
+		m_Storage.Resize(m_DataSize);
+		m_External = nullptr;
+
+		int* nodeTracks = Writable<int>(m_NodeTrackOffset);
+		int* trackNodes = Writable<int>(m_TrackNodeOffset);
+		for (int node = 0, track = 0; node < m_Header.nodeCount; node++)
+		{
+			nodeTracks[node] = tracks[node] ? track : -1;
+			if (tracks[node])
+				trackNodes[track++] = node;
+		}
+
+		int keyStarts[SOA_CHANNEL_COUNT] = { 0, 0, 0 };
+		for (int track = 0; track < m_Header.trackCount; track++)
+		{
+			const Bone* bone = bones[track];
+			const std::vector<KeyPosition>& positions = bone->GetPositionKeys();
+			const std::vector<KeyRotation>& rotations = bone->GetRotationKeys();
+			const std::vector<KeyScale>& scales = bone->GetScaleKeys();
+
+			WriteTrack(SOA_POSITION, track, keyStarts[SOA_POSITION], static_cast<int>(positions.size()),
+				[&](int key, float* out) { out[0] = positions[key].position.x; out[1] = positions[key].position.y; out[2] = positions[key].position.z; return positions[key].timeStamp; });
+			WriteTrack(SOA_ROTATION, track, keyStarts[SOA_ROTATION], static_cast<int>(rotations.size()),
+				[&](int key, float* out) { out[0] = rotations[key].orientation.x; out[1] = rotations[key].orientation.y; out[2] = rotations[key].orientation.z; out[3] = rotations[key].orientation.w; return rotations[key].timeStamp; });
+			WriteTrack(SOA_SCALE, track, keyStarts[SOA_SCALE], static_cast<int>(scales.size()),
+				[&](int key, float* out) { out[0] = scales[key].scale.x; out[1] = scales[key].scale.y; out[2] = scales[key].scale.z; return scales[key].timeStamp; });
+		}
+	}
+
+	// View over a data block laid out by ComputeLayout that lives elsewhere (e.g. a memory-mapped file)
+	SoaClip(const SoaClipHeader& header, const void* data)
+	{
+		m_Header = header;
+		ComputeLayout();
+		m_External = static_cast<const unsigned char*>(data);
+	}
+
+	// Samples every track at animationTime into pose. cursors holds this caller's key cursors
+	// (resized on first use), so one clip can be sampled by many animators.
+	void Sample(float animationTime, std::vector<int>& cursors, SoaPose& pose) const
+	{
+		const int width = SimdFloat::Width;
+		const int trackCount = m_Header.trackCount;
+		if (trackCount == 0)
+			return;
+		if (static_cast<int>(cursors.size()) != trackCount * SOA_CHANNEL_COUNT)
+			cursors.assign(trackCount * SOA_CHANNEL_COUNT, 0);
+
+		alignas(32) float factor[width];
+		alignas(32) float from[4][width];
+		alignas(32) float to[4][width];
+
+		for (int channel = 0; channel < SOA_CHANNEL_COUNT; channel++)
+		{
+			const int componentCount = GetComponentCount(channel);
+			const int* keyStart = Get<int>(m_Channels[channel].keyStartOffset);
+			const int* keyCount = Get<int>(m_Channels[channel].keyCountOffset);
+			const float* invStep = Get<float>(m_Channels[channel].invStepOffset);
+			const float* times = Get<float>(m_Channels[channel].timesOffset);
+			const float* components[4];
+			for (int component = 0; component < componentCount; component++)
+				components[component] = Get<float>(m_Channels[channel].componentOffsets[component]);
+			int* channelCursors = &cursors[channel * trackCount];
+			float* output[4];
+			for (int component = 0; component < componentCount; component++)
+				output[component] = pose.Data(GetPoseComponent(channel) + component);
+
+			for (int first = 0; first < trackCount; first += width)
+			{
+				// Gather the two keys around animationTime for each lane; key search stays scalar
+				for (int lane = 0; lane < width; lane++)
+				{
+					int track = first + lane;
+					if (track >= trackCount)
+					{
+						// Padding lanes get an identity value so normalizing them is safe
+						factor[lane] = 0.0f;
+						for (int component = 0; component < componentCount; component++)
+							from[component][lane] = to[component][lane] = (component == 3) ? 1.0f : 0.0f;
+						continue;
+					}
+
+					int start = keyStart[track];
+					int count = keyCount[track];
+					int key = 0;
+					factor[lane] = 0.0f;
+					if (count > 1)
+					{
+						key = FindKeyframe(count, invStep[track], animationTime, channelCursors[track],
+							[times, start](int index) { return times[start + index]; });
+						float lastTimeStamp = times[start + key];
+						float framesDiff = times[start + key + 1] - lastTimeStamp;
+						if (framesDiff != 0.0f)
+							factor[lane] = glm::clamp((animationTime - lastTimeStamp) / framesDiff, 0.0f, 1.0f);
+					}
+					int index0 = start + key;
+					int index1 = start + glm::min(key + 1, count - 1);
+					for (int component = 0; component < componentCount; component++)
+					{
+						from[component][lane] = components[component][index0];
+						to[component][lane] = components[component][index1];
+					}
+				}
+
+				SimdFloat t = SimdFloat::Load(factor);
+				if (channel == SOA_ROTATION)
+				{
+					SimdFloat result[4];
+					NlerpBatch(from, to, t, result);
+					for (int component = 0; component < 4; component++)
+						result[component].Store(output[component] + first);
+				}
+				else
+				{
+					for (int component = 0; component < componentCount; component++)
+					{
+						SimdFloat a = SimdFloat::Load(from[component]);
+						SimdFloat b = SimdFloat::Load(to[component]);
+						(a + (b - a) * t).Store(output[component] + first);
+					}
+				}
+			}
+		}
+	}
+
+	// Compares the SIMD sampler with Bone's scalar sampling at sampleCount evenly spaced times
+	SoaSamplingError CompareWithScalar(const Skeleton& skeleton, Animation* animation, int sampleCount) const
+	{
+		SoaSamplingError error = { 0.0f, 0.0f, 0.0f };
+		std::vector<Bone*> tracks = skeleton.BindAnimation(animation);
+		std::vector<BoneCursor> boneCursors(tracks.size());
+		std::vector<int> cursors;
+		SoaPose pose;
+		pose.Resize(m_Header.trackCount);
+
+		for (int sample = 0; sample < sampleCount; sample++)
+		{
+			float animationTime = m_Header.duration * sample / sampleCount;
+			Sample(animationTime, cursors, pose);
+			for (int node = 0; node < m_Header.nodeCount; node++)
+			{
+				int track = GetNodeTrack(node);
+				if (track < 0 || !tracks[node])
+					continue;
+				Bone* bone = tracks[node];
+				glm::vec3 position = bone->GetInterpolatedPosition(animationTime, boneCursors[node]);
+				glm::quat rotation = bone->GetInterpolatedRotation(animationTime, boneCursors[node]);
+				glm::vec3 scale = bone->GetInterpolatedScaling(animationTime, boneCursors[node]);
+				// Angle between the rotations from the chord length, which stays precise for tiny angles unlike acos
+				glm::quat sampled = pose.GetRotation(track);
+				if (glm::dot(rotation, sampled) < 0.0f)
+					sampled = -sampled;
+				glm::quat difference = rotation - sampled;
+				float chord = std::sqrt(glm::dot(difference, difference));
+
+				error.position = glm::max(error.position, glm::length(position - pose.GetPosition(track)));
+				error.rotation = glm::max(error.rotation, 4.0f * std::asin(glm::min(chord * 0.5f, 1.0f)));
+				error.scale = glm::max(error.scale, glm::length(scale - pose.GetScale(track)));
+			}
+		}
+		return error;
+	}
+
+	// Whether every index in the block stays inside the block's own arrays: the header's counts, each track's
+	// key range and the node/track maps. Sample and the getters trust them, so blocks read from a file (which
+	// must already be GetDataSize() bytes long) are checked with this before use.
+	bool IsValid() const
+	{
+		if (m_Header.trackCount < 0 || m_Header.nodeCount < 0 || m_Header.trackCount > m_Header.nodeCount)
+			return false;
+		for (int channel = 0; channel < SOA_CHANNEL_COUNT; channel++)
+			if (m_Header.keyCounts[channel] < 0)
+				return false;
+
+		for (int channel = 0; channel < SOA_CHANNEL_COUNT; channel++)
+		{
+			const int* keyStart = Get<int>(m_Channels[channel].keyStartOffset);
+			const int* keyCount = Get<int>(m_Channels[channel].keyCountOffset);
+			for (int track = 0; track < m_Header.trackCount; track++)
+				if (keyStart[track] < 0 || keyCount[track] < 1 || keyCount[track] > m_Header.keyCounts[channel] - keyStart[track])
+					return false;
+		}
+		for (int node = 0; node < m_Header.nodeCount; node++)
+			if (GetNodeTrack(node) < -1 || GetNodeTrack(node) >= m_Header.trackCount)
+				return false;
+		for (int track = 0; track < m_Header.trackCount; track++)
+			if (GetTrackNode(track) < 0 || GetTrackNode(track) >= m_Header.nodeCount)
+				return false;
+		return true;
+	}
+
+	int GetTrackCount() const { return m_Header.trackCount; }
+	// Track sampled for a skeleton node, -1 when the clip doesn't animate it
+	int GetNodeTrack(int node) const { return Get<int>(m_NodeTrackOffset)[node]; }
+	int GetTrackNode(int track) const { return Get<int>(m_TrackNodeOffset)[track]; }
+	float GetDuration() const { return m_Header.duration; }
+	float GetTicksPerSecond() const { return m_Header.ticksPerSecond; }
+
+	const SoaClipHeader& GetHeader() const { return m_Header; }
+	const void* GetData() const { return Base(); }
+	size_t GetDataSize() const { return m_DataSize; }
+
+	// Rounds a byte offset up so that every array starts on an AlignedBuffer boundary
+	static size_t AlignOffset(size_t offset)
+	{
+		return (offset + AlignedBuffer::Alignment - 1) / AlignedBuffer::Alignment * AlignedBuffer::Alignment;
+	}
+
+private:
+	struct ChannelLayout
+	{
+		size_t keyStartOffset;
+		size_t keyCountOffset;
+		size_t invStepOffset;
+		size_t timesOffset;
+		size_t componentOffsets[4];
+	};
+
+	static int GetComponentCount(int channel) { return channel == SOA_ROTATION ? 4 : 3; }
+	static int GetPoseComponent(int channel) { return channel == SOA_POSITION ? 0 : (channel == SOA_ROTATION ? 3 : 7); }
+
+	// nlerp with zeux's correction of the interpolation factor: within 1e-4 rad of slerp for keys up to 90 degrees apart
+	static void NlerpBatch(const float from[4][SimdFloat::Width], const float to[4][SimdFloat::Width], SimdFloat t, SimdFloat* result)
+	{
+		SimdFloat a[4], b[4];
+		for (int component = 0; component < 4; component++)
+		{
+			a[component] = SimdFloat::Load(from[component]);
+			b[component] = SimdFloat::Load(to[component]);
+		}
+		SimdFloat d = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+		// Take the shortest path, like glm::slerp
+		for (int component = 0; component < 4; component++)
+			b[component] = SimdXorSign(b[component], d);
+		d = SimdAbs(d);
+
+		SimdFloat A = SimdFloat::Set1(1.0904f) + d * (SimdFloat::Set1(-3.2452f) + d * (SimdFloat::Set1(3.55645f) - d * SimdFloat::Set1(1.43519f)));
+		SimdFloat B = SimdFloat::Set1(0.848013f) + d * (SimdFloat::Set1(-1.06021f) + d * SimdFloat::Set1(0.215638f));
+		SimdFloat half = t - SimdFloat::Set1(0.5f);
+		SimdFloat k = A * half * half + B;
+		SimdFloat adjusted = t + t * half * (t - SimdFloat::Set1(1.0f)) * k;
+
+		SimdFloat lengthSquared = SimdFloat::Set1(0.0f);
+		for (int component = 0; component < 4; component++)
+		{
+			result[component] = a[component] + (b[component] - a[component]) * adjusted;
+			lengthSquared = lengthSquared + result[component] * result[component];
+		}
+		SimdFloat invLength = SimdFloat::Set1(1.0f) / SimdSqrt(lengthSquared);
+		for (int component = 0; component < 4; component++)
+			result[component] = result[component] * invLength;
+	}
+
+	// Block layout: per-node and per-track index arrays, then for each channel the per-track
+	// key start/count/step arrays followed by the time stamps and one array per component
+	void ComputeLayout()
+	{
+		size_t offset = 0;
+		m_NodeTrackOffset = offset;
+		offset = AlignOffset(offset + sizeof(int) * m_Header.nodeCount);
+		m_TrackNodeOffset = offset;
+		offset = AlignOffset(offset + sizeof(int) * m_Header.trackCount);
+		for (int channel = 0; channel < SOA_CHANNEL_COUNT; channel++)
+		{
+			ChannelLayout& layout = m_Channels[channel];
+			layout.keyStartOffset = offset;
+			offset = AlignOffset(offset + sizeof(int) * m_Header.trackCount);
+			layout.keyCountOffset = offset;
+			offset = AlignOffset(offset + sizeof(int) * m_Header.trackCount);
+			layout.invStepOffset = offset;
+			offset = AlignOffset(offset + sizeof(float) * m_Header.trackCount);
+			layout.timesOffset = offset;
+			offset = AlignOffset(offset + sizeof(float) * m_Header.keyCounts[channel]);
+			for (int component = 0; component < 4; component++)
+			{
+				layout.componentOffsets[component] = offset;
+				if (component < GetComponentCount(channel))
+					offset = AlignOffset(offset + sizeof(float) * m_Header.keyCounts[channel]);
+			}
+		}
+		m_DataSize = offset;
+	}
+
+	template <typename KeyAt>
+	void WriteTrack(int channel, int track, int& keyStart, int count, KeyAt keyAt)
+	{
+		const ChannelLayout& layout = m_Channels[channel];
+		float* times = Writable<float>(layout.timesOffset);
+		Writable<int>(layout.keyStartOffset)[track] = keyStart;
+		Writable<int>(layout.keyCountOffset)[track] = count;
+
+		float values[4];
+		for (int key = 0; key < count; key++)
+		{
+			times[keyStart + key] = keyAt(key, values);
+			for (int component = 0; component < GetComponentCount(channel); component++)
+				Writable<float>(layout.componentOffsets[component])[keyStart + key] = values[component];
+		}
+		Writable<float>(layout.invStepOffset)[track] = GetUniformKeyInvStep(count,
+			[times, keyStart](int index) { return times[keyStart + index]; });
+		keyStart += count;
+	}
+
+	const unsigned char* Base() const { return m_External ? m_External : m_Storage.As<unsigned char>(); }
+	template <typename T> const T* Get(size_t offset) const { return reinterpret_cast<const T*>(Base() + offset); }
+	template <typename T> T* Writable(size_t offset) { return m_Storage.As<T>(offset); }
+
+	SoaClipHeader m_Header = {};
+	ChannelLayout m_Channels[SOA_CHANNEL_COUNT] = {};
+	size_t m_NodeTrackOffset = 0;
+	size_t m_TrackNodeOffset = 0;
+	size_t m_DataSize = 0;
+
+	AlignedBuffer m_Storage;
+	const unsigned char* m_External = nullptr;
+};
@@ -1,34 +1,56 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <algorithm>
 #include <map>
+#include <memory>
 #include <vector>
 #include <assimp/scene.h>
 #include <assimp/Importer.hpp>
 #include <learnopengl/animation.h>
 #include <learnopengl/bone.h>
+#include <learnopengl/bone_matrix.h>
+#include <learnopengl/skeleton.h>
+#include <learnopengl/animation_soa.h>
+#include <learnopengl/animation_compression.h>
+#include <learnopengl/baked_clip.h>
+#include <learnopengl/blend_tree.h>
+
+// How clip keys are sampled: per bone through Bone, all bones at once from a SoaClip, or per bone from a
+// CompressedClip
+enum class SamplingPath
+{
+	Scalar,
+	SoaSimd,
+	Compressed
+};
 
 class Animator
 {
 public:
+	// Compiles a skeleton of its own from the clip's hierarchy; use the other constructor to share one
 	Animator(Animation* animation)
 	{
-		m_CurrentTime = 0.0;
-		m_CurrentTime2 = 0.0;
+		Init(std::make_shared<const Skeleton>(animation));
 		m_CurrentAnimation = animation;
-		m_CurrentAnimation2 = NULL;
-		m_blendAmount = 0.0f;
-
-		m_FinalBoneMatrices.reserve(100);
+	}
 
-		for (int i = 0; i < 100; i++)
-			m_FinalBoneMatrices.push_back(glm::mat4(1.0f));
+	// Shares a skeleton loaded once for the model. Clips play through PlayAnimation or, for clips that only
+	// exist as SoaClips (e.g. from a cooked file), through a blend tree.
+	explicit Animator(std::shared_ptr<const Skeleton> skeleton)
+	{
+		Init(std::move(skeleton));
 	}
 
 	void UpdateAnimation(float dt)
 	{
 		m_DeltaTime = dt;
-		if (m_CurrentAnimation)
+		if (m_BlendTree)
+		{
+			m_BlendTree->Advance(dt);
+			CalculateBlendTreeTransforms();
+		}
+		else if (m_CurrentAnimation)
 		{
             // Update time for the primary animation
 			m_CurrentTime += m_CurrentAnimation->GetTicksPerSecond() * dt;
@@ -42,7 +64,7 @@ public:
 			}
 
             // Calculate bone transforms for the current frame (will handle blend internally)
-			CalculateBoneTransform(&m_CurrentAnimation->GetRootNode(), glm::mat4(1.0f));
+			CalculateBoneTransforms();
 		}
 	}
 
@@ -56,15 +78,17 @@ public:
 	}
 
     // UpdateBlend now uses the Bone's public GetInterpolatedX methods
-	glm::mat4 UpdateBlend(Bone* Bone1, Bone* Bone2, float time1, float time2, float blend) {
+	glm::mat4 UpdateBlend(Bone* Bone1, Bone* Bone2, BoneCursor& cursor1, BoneCursor& cursor2, float time1, float time2, float blend) {
 		// Get interpolated components directly from each bone
-		glm::vec3 bonePos1 = Bone1->GetInterpolatedPosition(time1);
-		glm::vec3 bonePos2 = Bone2->GetInterpolatedPosition(time2);
-		glm::quat boneRot1 = Bone1->GetInterpolatedRotation(time1);
-		glm::quat boneRot2 = Bone2->GetInterpolatedRotation(time2);
-		glm::vec3 boneScale1 = Bone1->GetInterpolatedScaling(time1);
-		glm::vec3 boneScale2 = Bone2->GetInterpolatedScaling(time2);
+		return BlendTransforms(
+			Bone1->GetInterpolatedPosition(time1, cursor1), Bone1->GetInterpolatedRotation(time1, cursor1), Bone1->GetInterpolatedScaling(time1, cursor1),
+			Bone2->GetInterpolatedPosition(time2, cursor2), Bone2->GetInterpolatedRotation(time2, cursor2), Bone2->GetInterpolatedScaling(time2, cursor2),
+			blend);
+	}
 
+	static glm::mat4 BlendTransforms(const glm::vec3& bonePos1, const glm::quat& boneRot1, const glm::vec3& boneScale1,
+		const glm::vec3& bonePos2, const glm::quat& boneRot2, const glm::vec3& boneScale2, float blend)
+	{
 		// Mix the components
 		glm::vec3 finalPos = glm::mix(bonePos1, bonePos2, blend);
 		glm::quat finalRot = glm::slerp(boneRot1, boneRot2, blend);
@@ -79,59 +103,336 @@ public:
 		return translation * rotation * scale;
 	}
 
-	void CalculateBoneTransform(const AssimpNodeData* node, glm::mat4 parentTransform)
+	// Nodes are stored parent-before-child, so a single forward pass computes every global transform
+	void CalculateBoneTransforms()
 	{
-		std::string nodeName = node->name;
-		// Initialize nodeTransform with the node's original bind pose transform.
-        // This is important for bones that might not be animated in *any* current animation.
-		glm::mat4 nodeTransform = node->transformation;
-
-		Bone* Bone1 = m_CurrentAnimation->FindBone(nodeName);
-		Bone* Bone2 = nullptr;
+		// Only sample the secondary animation if it is set and blending is active
+		int binding1 = GetBindingIndex(m_CurrentAnimation);
+		int binding2 = (m_CurrentAnimation2 && m_blendAmount > 0.0f) ? GetBindingIndex(m_CurrentAnimation2) : -1;
+		ClipBinding& clip1 = m_Bindings[binding1];
+		ClipBinding* clip2 = binding2 >= 0 ? &m_Bindings[binding2] : nullptr;
 
-		// Only look for Bone2 if a secondary animation is set and blending is active
-		if (m_CurrentAnimation2 && m_blendAmount > 0.0f) {
-			Bone2 = m_CurrentAnimation2->FindBone(nodeName);
+		// A single baked clip needs no sampling at all, its palettes are ready-made
+		if (!clip2 && clip1.bakedClip && m_BakedPlayback != BakedPlayback::Disabled)
+		{
+			clip1.bakedClip->Sample(m_CurrentTime, m_BakedPlayback, m_FinalBoneMatrices.data());
+			return;
 		}
 
-		if (Bone1) // If the bone is animated in the primary animation
+		// The SIMD path samples all tracks of a clip up front
+		const SoaPose* soaPose1 = UsesSoa(clip1) ? SampleSoa(clip1, m_CurrentTime, 0) : nullptr;
+		const SoaPose* soaPose2 = clip2 && UsesSoa(*clip2) ? SampleSoa(*clip2, m_CurrentTime2, 1) : nullptr;
+
+		std::vector<glm::mat4>& globalTransforms = GetGlobalTransformScratch(m_Skeleton->GetNodeCount());
+		const std::vector<SkeletonNode>& nodes = m_Skeleton->GetNodes();
+		for (size_t i = 0; i < nodes.size(); i++)
 		{
-            // If we have a second animation bone AND it's found AND we are blending
-			if (Bone2 && m_blendAmount > 0.0f)
+			const SkeletonNode& node = nodes[i];
+			// Un-animated nodes keep their bind pose transform
+			glm::mat4 nodeTransform = node.transformation;
+
+			int nodeIndex = static_cast<int>(i);
+			glm::vec3 pos1, scale1, pos2, scale2;
+			glm::quat rot1, rot2;
+			if (SampleNode(clip1, soaPose1, nodeIndex, m_CurrentTime, pos1, rot1, scale1))
 			{
-				// Calculate a blended transformation for this bone
-				nodeTransform = UpdateBlend(Bone1, Bone2, m_CurrentTime, m_CurrentTime2, m_blendAmount);
+				if (clip2 && SampleNode(*clip2, soaPose2, nodeIndex, m_CurrentTime2, pos2, rot2, scale2))
+					nodeTransform = BlendTransforms(pos1, rot1, scale1, pos2, rot2, scale2, m_blendAmount);
+				else
+					nodeTransform = glm::translate(glm::mat4(1.0f), pos1) * glm::toMat4(rot1) * glm::scale(glm::mat4(1.0f), scale1);
 			}
-			else // No blending for this bone (either no second animation, or blendAmount is 0)
+
+			globalTransforms[i] = node.parent < 0 ? nodeTransform : globalTransforms[node.parent] * nodeTransform;
+
+			if (node.boneIndex >= 0)
+				m_FinalBoneMatrices[node.boneIndex] = ToBoneMatrix(globalTransforms[i] * node.offset);
+		}
+	}
+
+	// Evaluates the blend tree's local pose and turns it into the palette in one pass over the nodes
+	void CalculateBlendTreeTransforms()
+	{
+		int singleClip = m_BlendTree->ResolveSingleClip();
+		if (singleClip >= 0 && m_BakedPlayback != BakedPlayback::Disabled)
+		{
+			int binding = GetTreeClipBinding(singleClip);
+			if (binding >= 0 && m_Bindings[binding].bakedClip)
 			{
-				// Use the primary animation's transform directly
-				nodeTransform = Bone1->GetAnimatedTransform(m_CurrentTime);
+				m_Bindings[binding].bakedClip->Sample(m_BlendTree->GetClipTime(singleClip), m_BakedPlayback, m_FinalBoneMatrices.data());
+				return;
 			}
 		}
-        // If Bone1 is nullptr, nodeTransform remains its bind pose, which is correct
-        // for un-animated bones.
 
-		glm::mat4 globalTransformation = parentTransform * nodeTransform;
+		const LocalTransform* pose = m_BlendTree->Evaluate(GetScratch().poseArena, m_Skeleton->GetNodeCount(), m_Skeleton->GetBindPose().data(),
+			[this](int clip, LocalTransform* clipPose) { SampleClipPose(clip, clipPose); });
 
-		auto boneInfoMap = m_CurrentAnimation->GetBoneIDMap();
-		if (boneInfoMap.find(nodeName) != boneInfoMap.end())
+		std::vector<glm::mat4>& globalTransforms = GetGlobalTransformScratch(m_Skeleton->GetNodeCount());
+		const std::vector<SkeletonNode>& nodes = m_Skeleton->GetNodes();
+		for (size_t i = 0; i < nodes.size(); i++)
 		{
-			int index = boneInfoMap[nodeName].id;
-			glm::mat4 offset = boneInfoMap[nodeName].offset;
-			m_FinalBoneMatrices[index] = globalTransformation * offset;
+			const SkeletonNode& node = nodes[i];
+			glm::mat4 nodeTransform = ComposeTransform(pose[i]);
+			globalTransforms[i] = node.parent < 0 ? nodeTransform : globalTransforms[node.parent] * nodeTransform;
+
+			if (node.boneIndex >= 0)
+				m_FinalBoneMatrices[node.boneIndex] = ToBoneMatrix(globalTransforms[i] * node.offset);
 		}
+	}
 
-		for (int i = 0; i < node->childrenCount; i++)
-			CalculateBoneTransform(&node->children[i], globalTransformation);
+	// Re-samples every animated bone of the clip at a fixed rate so key lookup becomes a direct index
+	static void ResampleAnimation(Animation* animation, float samplesPerSecond)
+	{
+		float ticksPerSample = animation->GetTicksPerSecond() / samplesPerSecond;
+		ResampleNode(animation, &animation->GetRootNode(), ticksPerSample);
 	}
 
-	std::vector<glm::mat4> GetFinalBoneMatrices()
+	// Selects how keys are sampled; clips without a SoaClip/CompressedClip registered for the selected path
+	// fall back to the scalar path
+	void SetSamplingPath(SamplingPath path) { m_SamplingPath = path; }
+	SamplingPath GetSamplingPath() const { return m_SamplingPath; }
+
+	// Registers the structure-of-arrays copy of a clip, built against GetSkeleton(), for the SIMD path
+	void SetSoaClip(Animation* animation, const SoaClip* soaClip)
+	{
+		ClipBinding& binding = m_Bindings[GetBindingIndex(animation)];
+		binding.soaClip = soaClip;
+		binding.soaCursors.clear();
+	}
+
+	// Registers a compressed copy of a clip, built against GetSkeleton(), for the compressed path
+	void SetCompressedClip(Animation* animation, const CompressedClip* compressedClip)
+	{
+		m_Bindings[GetBindingIndex(animation)].compressedClip = compressedClip;
+	}
+
+	// Registers a clip's baked palettes, built against GetSkeleton(). They are used whenever the clip plays
+	// on its own and baked playback is enabled; blends are always sampled.
+	void SetBakedClip(Animation* animation, const BakedClip* bakedClip)
+	{
+		m_Bindings[GetBindingIndex(animation)].bakedClip = bakedClip;
+	}
+
+	// Drops everything bound for a clip (Animation, SoaClip or both) before it's freed
+	void ReleaseClip(Animation* animation, const SoaClip* soaClip)
+	{
+		for (size_t i = m_Bindings.size(); i > 0; i--)
+		{
+			const ClipBinding& binding = m_Bindings[i - 1];
+			if ((animation && binding.animation == animation) || (soaClip && binding.soaClip == soaClip))
+				m_Bindings.erase(m_Bindings.begin() + (i - 1));
+		}
+		if (animation && (m_CurrentAnimation == animation || m_CurrentAnimation2 == animation))
+		{
+			m_CurrentAnimation = m_CurrentAnimation == animation ? NULL : m_CurrentAnimation;
+			m_CurrentAnimation2 = m_CurrentAnimation2 == animation ? NULL : m_CurrentAnimation2;
+		}
+	}
+
+	void SetBakedPlayback(BakedPlayback playback) { m_BakedPlayback = playback; }
+	BakedPlayback GetBakedPlayback() const { return m_BakedPlayback; }
+
+	// While a blend tree is set it drives the pose instead of PlayAnimation's clips; the tree must be built
+	// for this animator's skeleton and outlive its use here. Pass NULL to go back to PlayAnimation.
+	void SetBlendTree(BlendTree* tree) { m_BlendTree = tree; }
+	BlendTree* GetBlendTree() const { return m_BlendTree; }
+
+	const Skeleton& GetSkeleton() const { return *m_Skeleton; }
+	const std::shared_ptr<const Skeleton>& GetSharedSkeleton() const { return m_Skeleton; }
+
+	// Read-only view of the palette (GetSkeleton().GetBoneCount() affine matrices, see bone_matrix.h), valid
+	// until the next UpdateAnimation; no copy is made
+	const std::vector<BoneMatrix>& GetFinalBoneMatrices() const
 	{
 		return m_FinalBoneMatrices;
 	}
 
+	// Bytes owned by this animator alone: playback state, key cursors and palette. The skeleton, clips and
+	// blend tree are shared and not counted.
+	size_t GetMemorySize() const
+	{
+		size_t size = sizeof(*this) + m_FinalBoneMatrices.capacity() * sizeof(BoneMatrix) + m_Bindings.capacity() * sizeof(ClipBinding);
+		for (const ClipBinding& binding : m_Bindings)
+			size += binding.cursors.capacity() * sizeof(BoneCursor) + binding.soaCursors.capacity() * sizeof(int);
+		return size;
+	}
+
+private:
+	// A clip played by this animator: the skeleton's shared track table plus this animator's own key cursors,
+	// allocated only for the sampling path the clip actually goes through
+	struct ClipBinding
+	{
+		Animation* animation;
+		const std::vector<Bone*>* tracks = nullptr;
+		std::vector<BoneCursor> cursors;
+
+		const SoaClip* soaClip = nullptr;
+		std::vector<int> soaCursors;
+
+		const CompressedClip* compressedClip = nullptr;
+		const BakedClip* bakedClip = nullptr;
+	};
+
+	// Clips without an Animation have nothing else to sample
+	bool UsesSoa(const ClipBinding& clip) const { return clip.soaClip && (m_SamplingPath == SamplingPath::SoaSimd || !clip.animation); }
+
+	// Everything an update needs per node or per track only lives for that update, so it sits in per-thread
+	// buffers shared by all animators instead of in each animator
+	struct Scratch
+	{
+		std::vector<glm::mat4> globalTransforms;
+		PoseArena poseArena;
+		SoaPose soaPoses[2];
+		int soaPoseCapacity[2] = { 0, 0 };
+	};
+
+	static Scratch& GetScratch()
+	{
+		static thread_local Scratch scratch;
+		return scratch;
+	}
+
+	static std::vector<glm::mat4>& GetGlobalTransformScratch(int nodeCount)
+	{
+		std::vector<glm::mat4>& globalTransforms = GetScratch().globalTransforms;
+		if (static_cast<int>(globalTransforms.size()) < nodeCount)
+			globalTransforms.resize(nodeCount);
+		return globalTransforms;
+	}
+
+	// Samples all tracks of a SoA clip into scratch pose slot 0 or 1
+	static const SoaPose* SampleSoa(ClipBinding& clip, float time, int slot)
+	{
+		Scratch& scratch = GetScratch();
+		int trackCount = clip.soaClip->GetTrackCount();
+		if (scratch.soaPoseCapacity[slot] < trackCount)
+		{
+			scratch.soaPoses[slot].Resize(trackCount);
+			scratch.soaPoseCapacity[slot] = trackCount;
+		}
+		clip.soaClip->Sample(time, clip.soaCursors, scratch.soaPoses[slot]);
+		return &scratch.soaPoses[slot];
+	}
+
+	// Local transform of a node in one clip through whichever path the clip uses; false if the clip doesn't
+	// animate it. soaPose is the clip's SampleSoa result when it uses the SIMD path.
+	bool SampleNode(ClipBinding& clip, const SoaPose* soaPose, int node, float time, glm::vec3& position, glm::quat& rotation, glm::vec3& scale)
+	{
+		if (soaPose)
+		{
+			int track = clip.soaClip->GetNodeTrack(node);
+			if (track < 0)
+				return false;
+			position = soaPose->GetPosition(track);
+			rotation = soaPose->GetRotation(track);
+			scale = soaPose->GetScale(track);
+			return true;
+		}
+
+		if (clip.cursors.empty())
+			clip.cursors.resize(m_Skeleton->GetNodeCount());
+
+		if (m_SamplingPath == SamplingPath::Compressed && clip.compressedClip)
+		{
+			int track = clip.compressedClip->GetNodeTrack(node);
+			if (track < 0)
+				return false;
+			clip.compressedClip->SampleTrack(track, time, clip.cursors[node], position, rotation, scale);
+			return true;
+		}
+
+		const Bone* bone = clip.tracks ? (*clip.tracks)[node] : nullptr;
+		if (!bone)
+			return false;
+		position = bone->GetInterpolatedPosition(time, clip.cursors[node]);
+		rotation = bone->GetInterpolatedRotation(time, clip.cursors[node]);
+		scale = bone->GetInterpolatedScaling(time, clip.cursors[node]);
+		return true;
+	}
+
+	void Init(std::shared_ptr<const Skeleton> skeleton)
+	{
+		m_CurrentTime = 0.0;
+		m_CurrentTime2 = 0.0;
+		m_CurrentAnimation = NULL;
+		m_CurrentAnimation2 = NULL;
+		m_blendAmount = 0.0f;
+		m_SamplingPath = SamplingPath::Scalar;
+		m_BakedPlayback = BakedPlayback::Disabled;
+		m_BlendTree = NULL;
+
+		m_Skeleton = std::move(skeleton);
+		m_FinalBoneMatrices.assign(m_Skeleton->GetBoneCount(), BoneMatrix(1.0f));
+	}
+
+	// -1 for an empty clip slot
+	int GetTreeClipBinding(int clip)
+	{
+		Animation* animation = m_BlendTree->GetClipAnimation(clip);
+		const SoaClip* soaClip = m_BlendTree->GetClipSoa(clip);
+		if (!animation && !soaClip)
+			return -1;
+		return animation ? GetBindingIndex(animation) : GetSoaBindingIndex(soaClip);
+	}
+
+	// Local pose of one blend tree clip; nodes the clip doesn't animate (all of them for an empty slot) keep
+	// their bind pose
+	void SampleClipPose(int treeClip, LocalTransform* pose)
+	{
+		int binding = GetTreeClipBinding(treeClip);
+		if (binding < 0)
+		{
+			std::copy(m_Skeleton->GetBindPose().begin(), m_Skeleton->GetBindPose().end(), pose);
+			return;
+		}
+		ClipBinding& clip = m_Bindings[binding];
+		float time = m_BlendTree->GetClipTime(treeClip);
+		const SoaPose* soaPose = UsesSoa(clip) ? SampleSoa(clip, time, 0) : nullptr;
+
+		const std::vector<LocalTransform>& bindPose = m_Skeleton->GetBindPose();
+		for (int i = 0; i < m_Skeleton->GetNodeCount(); i++)
+			if (!SampleNode(clip, soaPose, i, time, pose[i].position, pose[i].rotation, pose[i].scale))
+				pose[i] = bindPose[i];
+	}
+
+	// Only a handful of clips are ever played, so a linear search beats a map here; binding happens once per clip
+	int GetBindingIndex(Animation* animation)
+	{
+		for (size_t i = 0; i < m_Bindings.size(); i++)
+			if (m_Bindings[i].animation == animation)
+				return static_cast<int>(i);
+
+		ClipBinding binding;
+		binding.animation = animation;
+		binding.tracks = &m_Skeleton->GetTracks(animation);
+		m_Bindings.push_back(std::move(binding));
+		return static_cast<int>(m_Bindings.size()) - 1;
+	}
+
+	// Binding for a clip that has no Animation behind it; all its sampling goes through the SoaClip
+	int GetSoaBindingIndex(const SoaClip* soaClip)
+	{
+		for (size_t i = 0; i < m_Bindings.size(); i++)
+			if (!m_Bindings[i].animation && m_Bindings[i].soaClip == soaClip)
+				return static_cast<int>(i);
+
+		ClipBinding binding;
+		binding.animation = NULL;
+		binding.soaClip = soaClip;
+		m_Bindings.push_back(std::move(binding));
+		return static_cast<int>(m_Bindings.size()) - 1;
+	}
+
+	static void ResampleNode(Animation* animation, const AssimpNodeData* node, float ticksPerSample)
+	{
+		if (Bone* bone = animation->FindBone(node->name))
+			bone->Resample(ticksPerSample, animation->GetDuration());
+
+		for (int i = 0; i < node->childrenCount; i++)
+			ResampleNode(animation, &node->children[i], ticksPerSample);
+	}
+
 public: // Keep these public for skeletal_animation.cpp state machine
-	std::vector<glm::mat4> m_FinalBoneMatrices;
+	std::vector<BoneMatrix> m_FinalBoneMatrices;
 	Animation* m_CurrentAnimation;
 	Animation* m_CurrentAnimation2;
 	float m_CurrentTime;
@@ -139,4 +440,10 @@ public: // Keep these public for skeletal_animation.cpp state machine
 	float m_DeltaTime;
 	float m_blendAmount;
 
+private:
+	SamplingPath m_SamplingPath;
+	BakedPlayback m_BakedPlayback;
+	BlendTree* m_BlendTree;
+	std::shared_ptr<const Skeleton> m_Skeleton;
+	std::vector<ClipBinding> m_Bindings;
 };
\ No newline at end of file
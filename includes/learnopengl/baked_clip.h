@@ -0,0 +1,92 @@
+#pragma once
+
+/* A clip sampled once at a fixed rate into ready-made palettes. Playback skips key lookup and the
+   hierarchy walk entirely: it copies the nearest frame or interpolates two neighbouring ones. One
+   BakedClip is meant to be shared by every animator playing the clip. */
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <glm/glm.hpp>
+#include <learnopengl/animation.h>
+#include <learnopengl/bone.h>
+#include <learnopengl/bone_matrix.h>
+#include <learnopengl/skeleton.h>
+
+enum class BakedPlayback
+{
+	Disabled,
+	Nearest,
+	Interpolated
+};
+
+class BakedClip
+{
+public:
+	BakedClip() = default;
+
+	// framesPerSecond is in real time; the frames span [0, duration] evenly, both ends included, so a
+	// looping clip interpolates cleanly right up to the wrap
+	BakedClip(const Skeleton& skeleton, Animation* animation, float framesPerSecond = 30.0f)
+	{
+		m_Duration = animation->GetDuration();
+		m_BoneCount = skeleton.GetBoneCount();
+
+		float seconds = m_Duration / animation->GetTicksPerSecond();
+		int intervals = glm::max(1, static_cast<int>(std::lround(seconds * framesPerSecond)));
+		m_FrameCount = intervals + 1;
+		m_FramesPerTick = m_Duration > 0.0f ? intervals / m_Duration : 0.0f;
+
+		const std::vector<SkeletonNode>& nodes = skeleton.GetNodes();
+		std::vector<Bone*> tracks = skeleton.BindAnimation(animation);
+		std::vector<BoneCursor> cursors(nodes.size());
+		std::vector<glm::mat4> globalTransforms(nodes.size());
+		m_Palettes.assign(static_cast<size_t>(m_FrameCount) * m_BoneCount, BoneMatrix(1.0f));
+
+		for (int frame = 0; frame < m_FrameCount; frame++)
+		{
+			float animationTime = glm::min(frame / m_FramesPerTick, m_Duration);
+			BoneMatrix* palette = &m_Palettes[static_cast<size_t>(frame) * m_BoneCount];
+			for (size_t i = 0; i < nodes.size(); i++)
+			{
+				const SkeletonNode& node = nodes[i];
+				glm::mat4 nodeTransform = tracks[i] ? tracks[i]->GetAnimatedTransform(animationTime, cursors[i]) : node.transformation;
+				globalTransforms[i] = node.parent < 0 ? nodeTransform : globalTransforms[node.parent] * nodeTransform;
+				if (node.boneIndex >= 0)
+					palette[node.boneIndex] = ToBoneMatrix(globalTransforms[i] * node.offset);
+			}
+		}
+	}
+
+	// Writes GetBoneCount() matrices for animationTime (in ticks). Interpolated playback blends the two
+	// surrounding palettes component-wise, which is close enough to a proper blend at typical bake rates.
+	void Sample(float animationTime, BakedPlayback playback, BoneMatrix* palette) const
+	{
+		float position = glm::clamp(animationTime * m_FramesPerTick, 0.0f, static_cast<float>(m_FrameCount - 1));
+		if (playback != BakedPlayback::Interpolated)
+		{
+			std::memcpy(palette, GetFrame(static_cast<int>(position + 0.5f)), m_BoneCount * sizeof(BoneMatrix));
+			return;
+		}
+
+		int frame = glm::min(static_cast<int>(position), m_FrameCount - 2);
+		float factor = position - frame;
+		const BoneMatrix* from = GetFrame(frame);
+		const BoneMatrix* to = from + m_BoneCount;
+		for (int bone = 0; bone < m_BoneCount; bone++)
+			palette[bone] = from[bone] + (to[bone] - from[bone]) * factor;
+	}
+
+	const BoneMatrix* GetFrame(int frame) const { return &m_Palettes[static_cast<size_t>(frame) * m_BoneCount]; }
+	int GetFrameCount() const { return m_FrameCount; }
+	int GetBoneCount() const { return m_BoneCount; }
+	float GetDuration() const { return m_Duration; }
+	size_t GetMemorySize() const { return m_Palettes.size() * sizeof(BoneMatrix); }
+
+private:
+	std::vector<BoneMatrix> m_Palettes; // m_FrameCount palettes of m_BoneCount matrices, back to back
+	int m_FrameCount = 0;
+	int m_BoneCount = 0;
+	float m_FramesPerTick = 0.0f;
+	float m_Duration = 0.0f;
+};
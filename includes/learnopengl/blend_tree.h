@@ -0,0 +1,359 @@
+#pragma once
+
+/* Blend tree over local-space poses. Leaves play clips; inner nodes lerp any number of children, add a
+   pose difference on top of a base, or layer one pose over another through a per-node mask. Branches
+   whose weight is below BlendEpsilon are skipped, every clip is sampled at most once per evaluation and
+   intermediate poses come from a PoseArena that is reused frame after frame.
+
+   The tree only describes the blend and owns the clip times; sampling is left to the caller (Animator),
+   so every sampling path works underneath it. */
+
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/quaternion.hpp>
+#include <learnopengl/animation.h>
+#include <learnopengl/animation_soa.h>
+#include <learnopengl/skeleton.h>
+
+// Weights below this count as zero and their branch isn't evaluated
+const float BlendEpsilon = 0.001f;
+
+// Hands out whole poses; Reset makes every pose available again without freeing, so after the first few
+// frames evaluation doesn't allocate. Poses stay valid until the next Reset.
+class PoseArena
+{
+public:
+	void Reset(int nodeCount)
+	{
+		if (nodeCount != m_NodeCount)
+			m_Poses.clear();
+		m_NodeCount = nodeCount;
+		m_Used = 0;
+	}
+
+	LocalTransform* Allocate()
+	{
+		if (m_Used == m_Poses.size())
+			m_Poses.emplace_back(new LocalTransform[m_NodeCount]);
+		return m_Poses[m_Used++].get();
+	}
+
+	size_t GetPoseCount() const { return m_Poses.size(); }
+
+private:
+	std::vector<std::unique_ptr<LocalTransform[]>> m_Poses;
+	size_t m_Used = 0;
+	int m_NodeCount = 0;
+};
+
+enum class BlendNodeType
+{
+	Clip,
+	Lerp,     // normalized weighted blend of any number of children
+	Additive, // base + weight * (additive - reference)
+	Layered   // base blended towards layer by weight * mask[node]
+};
+
+class BlendTree
+{
+public:
+	int AddClip(Animation* animation)
+	{
+		return AddClip(animation, nullptr, animation->GetTicksPerSecond(), animation->GetDuration());
+	}
+
+	// A clip that only exists in structure-of-arrays form, such as one loaded from a cooked file
+	int AddClip(const SoaClip* soaClip)
+	{
+		return AddClip(nullptr, soaClip, soaClip->GetTicksPerSecond(), soaClip->GetDuration());
+	}
+
+	// A slot for a clip that isn't loaded yet; it holds the bind pose and doesn't advance until SetClip fills
+	// it, so it should stay weighted out until then
+	int AddClip()
+	{
+		return AddClip(nullptr, nullptr, 0.0f, 0.0f);
+	}
+
+	// Swaps what a clip slot plays, e.g. once a background load finishes (restarting it from its first
+	// frame) or NULL, NULL when the clip is evicted
+	void SetClip(int clip, Animation* animation, const SoaClip* soaClip)
+	{
+		BlendClip& slot = m_Clips[clip];
+		slot.animation = animation;
+		slot.soaClip = soaClip;
+		slot.ticksPerSecond = animation ? animation->GetTicksPerSecond() : soaClip ? soaClip->GetTicksPerSecond() : 0.0f;
+		slot.duration = animation ? animation->GetDuration() : soaClip ? soaClip->GetDuration() : 0.0f;
+		slot.time = 0.0f;
+	}
+
+	int AddClipNode(int clip)
+	{
+		BlendNode node;
+		node.type = BlendNodeType::Clip;
+		node.clip = clip;
+		return AddNode(node);
+	}
+
+	// Starts out fully on the first child
+	int AddLerpNode(const std::vector<int>& children)
+	{
+		BlendNode node;
+		node.type = BlendNodeType::Lerp;
+		node.children = children;
+		node.weights.assign(children.size(), 0.0f);
+		if (!children.empty())
+			node.weights[0] = 1.0f;
+		return AddNode(node);
+	}
+
+	// Without a reference the additive pose is taken relative to the bind pose
+	int AddAdditiveNode(int base, int additive, int reference = -1)
+	{
+		BlendNode node;
+		node.type = BlendNodeType::Additive;
+		node.children = { base, additive };
+		if (reference >= 0)
+			node.children.push_back(reference);
+		node.weights = { 1.0f, 0.0f };
+		return AddNode(node);
+	}
+
+	// mask holds a weight per skeleton node, see MaskFromNode
+	int AddLayeredNode(int base, int layer, const std::vector<float>& mask)
+	{
+		BlendNode node;
+		node.type = BlendNodeType::Layered;
+		node.children = { base, layer };
+		node.weights = { 1.0f, 0.0f };
+		node.mask = mask;
+		return AddNode(node);
+	}
+
+	// 1 for the named node and everything below it, 0 elsewhere
+	static std::vector<float> MaskFromNode(const Skeleton& skeleton, const std::string& name)
+	{
+		const std::vector<SkeletonNode>& nodes = skeleton.GetNodes();
+		std::vector<float> mask(nodes.size(), 0.0f);
+		int root = skeleton.FindNode(name);
+		for (int i = 0; i < static_cast<int>(nodes.size()); i++)
+			if (i == root || (nodes[i].parent >= 0 && mask[nodes[i].parent] > 0.0f))
+				mask[i] = 1.0f;
+		return mask;
+	}
+
+	void SetRoot(int node) { m_Root = node; }
+	int GetRoot() const { return m_Root; }
+
+	// For lerp nodes the weight of the child in that slot; for additive and layered nodes slot 1 is the
+	// weight of the additive/layer input
+	void SetWeight(int node, int slot, float weight) { m_Nodes[node].weights[slot] = weight; }
+	float GetWeight(int node, int slot) const { return m_Nodes[node].weights[slot]; }
+
+	void SetClipTime(int clip, float time) { m_Clips[clip].time = time; }
+	float GetClipTime(int clip) const { return m_Clips[clip].time; }
+	void SetClipSpeed(int clip, float speed) { m_Clips[clip].speed = speed; }
+	// Exactly one of these is set for each clip, or neither for an empty slot
+	Animation* GetClipAnimation(int clip) const { return m_Clips[clip].animation; }
+	const SoaClip* GetClipSoa(int clip) const { return m_Clips[clip].soaClip; }
+	int GetClipCount() const { return static_cast<int>(m_Clips.size()); }
+
+	// Every clip keeps running whether it contributes or not, so fading one back in continues where it was
+	void Advance(float dt)
+	{
+		for (BlendClip& clip : m_Clips)
+		{
+			if (clip.duration <= 0.0f)
+				continue;
+			clip.time += clip.ticksPerSecond * clip.speed * dt;
+			clip.time = fmod(clip.time, clip.duration);
+		}
+	}
+
+	// The clip the whole tree reduces to when every other branch is weighted out, -1 if it's a real blend
+	int ResolveSingleClip() const { return m_Root >= 0 ? ResolveSingleClip(m_Root) : -1; }
+
+	// Evaluates the tree into a local pose of nodeCount transforms. sampleClip(clip, pose) must fill all
+	// nodeCount entries of pose with the clip at its current time; it's called once per contributing clip.
+	// bindPose is the result when nothing contributes and the reference of additive nodes without one.
+	template <typename SampleClip>
+	const LocalTransform* Evaluate(PoseArena& arena, int nodeCount, const LocalTransform* bindPose, const SampleClip& sampleClip)
+	{
+		arena.Reset(nodeCount);
+		m_ClipPoses.assign(m_Clips.size(), nullptr);
+		if (m_Root < 0)
+			return bindPose;
+		return EvaluateNode(m_Root, arena, nodeCount, bindPose, sampleClip);
+	}
+
+private:
+	struct BlendClip
+	{
+		Animation* animation;
+		const SoaClip* soaClip;
+		float ticksPerSecond;
+		float duration;
+		float time;
+		float speed;
+	};
+
+	int AddClip(Animation* animation, const SoaClip* soaClip, float ticksPerSecond, float duration)
+	{
+		BlendClip clip;
+		clip.animation = animation;
+		clip.soaClip = soaClip;
+		clip.ticksPerSecond = ticksPerSecond;
+		clip.duration = duration;
+		clip.time = 0.0f;
+		clip.speed = 1.0f;
+		m_Clips.push_back(clip);
+		return static_cast<int>(m_Clips.size()) - 1;
+	}
+
+	struct BlendNode
+	{
+		BlendNodeType type;
+		int clip = -1;
+		std::vector<int> children;
+		std::vector<float> weights;
+		std::vector<float> mask;
+	};
+
+	int AddNode(const BlendNode& node)
+	{
+		m_Nodes.push_back(node);
+		return static_cast<int>(m_Nodes.size()) - 1;
+	}
+
+	int ResolveSingleClip(int index) const
+	{
+		const BlendNode& node = m_Nodes[index];
+		if (node.type == BlendNodeType::Clip)
+			return node.clip;
+		if (node.type != BlendNodeType::Lerp)
+			return node.weights[1] < BlendEpsilon ? ResolveSingleClip(node.children[0]) : -1;
+
+		int active = -1;
+		for (size_t i = 0; i < node.children.size(); i++)
+		{
+			if (node.weights[i] < BlendEpsilon)
+				continue;
+			if (active >= 0)
+				return -1;
+			active = static_cast<int>(i);
+		}
+		return active >= 0 ? ResolveSingleClip(node.children[active]) : -1;
+	}
+
+	static void BlendPoses(const LocalTransform* a, const LocalTransform* b, float factor, int nodeCount, LocalTransform* result)
+	{
+		for (int i = 0; i < nodeCount; i++)
+		{
+			result[i].position = glm::mix(a[i].position, b[i].position, factor);
+			result[i].rotation = glm::normalize(glm::slerp(a[i].rotation, b[i].rotation, factor));
+			result[i].scale = glm::mix(a[i].scale, b[i].scale, factor);
+		}
+	}
+
+	template <typename SampleClip>
+	const LocalTransform* EvaluateNode(int index, PoseArena& arena, int nodeCount, const LocalTransform* bindPose, const SampleClip& sampleClip)
+	{
+		const BlendNode& node = m_Nodes[index];
+		switch (node.type)
+		{
+		case BlendNodeType::Clip:
+		{
+			if (!m_ClipPoses[node.clip])
+			{
+				LocalTransform* pose = arena.Allocate();
+				sampleClip(node.clip, pose);
+				m_ClipPoses[node.clip] = pose;
+			}
+			return m_ClipPoses[node.clip];
+		}
+
+		case BlendNodeType::Lerp:
+		{
+			// Running normalized blend: after each child the result is the weighted average of the children so
+			// far, so N children cost N - 1 pose blends
+			const LocalTransform* single = nullptr;
+			LocalTransform* result = nullptr;
+			float accumulated = 0.0f;
+			for (size_t i = 0; i < node.children.size(); i++)
+			{
+				float weight = node.weights[i];
+				if (weight < BlendEpsilon)
+					continue;
+				const LocalTransform* child = EvaluateNode(node.children[i], arena, nodeCount, bindPose, sampleClip);
+				accumulated += weight;
+				if (!single)
+				{
+					single = child;
+					continue;
+				}
+				if (!result)
+				{
+					result = arena.Allocate();
+					BlendPoses(single, child, weight / accumulated, nodeCount, result);
+				}
+				else
+					BlendPoses(result, child, weight / accumulated, nodeCount, result);
+			}
+			if (result)
+				return result;
+			return single ? single : bindPose;
+		}
+
+		case BlendNodeType::Additive:
+		{
+			const LocalTransform* base = EvaluateNode(node.children[0], arena, nodeCount, bindPose, sampleClip);
+			float weight = node.weights[1];
+			if (weight < BlendEpsilon)
+				return base;
+			const LocalTransform* additive = EvaluateNode(node.children[1], arena, nodeCount, bindPose, sampleClip);
+			const LocalTransform* reference = node.children.size() > 2 ? EvaluateNode(node.children[2], arena, nodeCount, bindPose, sampleClip) : bindPose;
+
+			LocalTransform* result = arena.Allocate();
+			const glm::quat identity(1.0f, 0.0f, 0.0f, 0.0f);
+			for (int i = 0; i < nodeCount; i++)
+			{
+				glm::quat delta = glm::inverse(reference[i].rotation) * additive[i].rotation;
+				result[i].position = base[i].position + (additive[i].position - reference[i].position) * weight;
+				result[i].rotation = glm::normalize(base[i].rotation * glm::slerp(identity, delta, weight));
+				result[i].scale = base[i].scale * glm::mix(glm::vec3(1.0f), additive[i].scale / reference[i].scale, weight);
+			}
+			return result;
+		}
+
+		case BlendNodeType::Layered:
+		{
+			const LocalTransform* base = EvaluateNode(node.children[0], arena, nodeCount, bindPose, sampleClip);
+			float weight = node.weights[1];
+			if (weight < BlendEpsilon)
+				return base;
+			const LocalTransform* layer = EvaluateNode(node.children[1], arena, nodeCount, bindPose, sampleClip);
+
+			LocalTransform* result = arena.Allocate();
+			for (int i = 0; i < nodeCount; i++)
+			{
+				float nodeWeight = weight * node.mask[i];
+				if (nodeWeight < BlendEpsilon)
+					result[i] = base[i];
+				else
+					BlendPoses(base + i, layer + i, nodeWeight, 1, result + i);
+			}
+			return result;
+		}
+		}
+		return bindPose;
+	}
+
+	std::vector<BlendClip> m_Clips;
+	std::vector<BlendNode> m_Nodes;
+	std::vector<const LocalTransform*> m_ClipPoses; // this evaluation's sample of each clip, nullptr until needed
+	int m_Root = -1;
+};
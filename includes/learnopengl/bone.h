@@ -3,6 +3,7 @@
 /* Container for bone data */
 
 #include <vector>
+#include <cmath>
 #include <assimp/scene.h>
 #include <list>
 #include <glm/glm.hpp>
@@ -28,6 +29,81 @@ struct KeyScale
 	float timeStamp;
 };
 
+/* Remembers the key interval a track was last sampled in. Playback moves forward
+   in small steps, so the next lookup normally finds its key in the same or the
+   following interval instead of scanning the whole track. */
+struct BoneCursor
+{
+	int position = 0;
+	int rotation = 0;
+	int scale = 0;
+};
+
+// Returns the index of the key starting the interval that contains animationTime (always < keyCount - 1 so
+// the next key is valid); timeAt(i) gives the time stamp of key i. Uniform tracks (invStep > 0) are indexed
+// directly; otherwise the cursor is advanced a few keys from where it was last time and we only fall back
+// to a binary search after a seek or a loop wrap.
+template <typename TimeAt>
+inline int FindKeyframe(int keyCount, float invStep, float animationTime, int& cursor, TimeAt timeAt)
+{
+	const int lastInterval = keyCount - 2;
+	if (lastInterval <= 0)
+		return 0;
+
+	if (invStep > 0.0f)
+	{
+		int index = static_cast<int>((animationTime - timeAt(0)) * invStep);
+		return cursor = glm::clamp(index, 0, lastInterval);
+	}
+
+	const int maxForwardSteps = 4;
+	int index = glm::clamp(cursor, 0, lastInterval);
+	if (animationTime >= timeAt(index))
+	{
+		for (int step = 0; step < maxForwardSteps; ++step)
+		{
+			if (index == lastInterval || animationTime < timeAt(index + 1))
+				return cursor = index;
+			++index;
+		}
+	}
+	else if (animationTime < timeAt(1))
+	{
+		// Looped back to the start of the clip
+		return cursor = 0;
+	}
+
+	// First key after animationTime, searched in [1, keyCount)
+	int low = 1, high = keyCount;
+	while (low < high)
+	{
+		int middle = (low + high) / 2;
+		if (animationTime < timeAt(middle))
+			high = middle;
+		else
+			low = middle + 1;
+	}
+	return cursor = glm::clamp(low - 1, 0, lastInterval);
+}
+
+// 1 / key spacing when the keys are evenly spaced, 0 otherwise
+template <typename TimeAt>
+inline float GetUniformKeyInvStep(int keyCount, TimeAt timeAt)
+{
+	if (keyCount < 3)
+		return 0.0f;
+	float first = timeAt(0);
+	float step = (timeAt(keyCount - 1) - first) / (keyCount - 1);
+	if (step <= 0.0f)
+		return 0.0f;
+	for (int i = 1; i < keyCount; ++i)
+	{
+		if (std::abs(timeAt(i) - (first + i * step)) > step * 1e-3f)
+			return 0.0f;
+	}
+	return 1.0f / step;
+}
+
 class Bone
 {
 public:
@@ -70,6 +146,11 @@ public:
 			data.timeStamp = timeStamp;
 			m_Scales.push_back(data);
 		}
+
+		// Most exported clips are baked at a fixed frame rate; such tracks can be indexed directly
+		m_PositionInvStep = GetUniformInvStep(m_Positions);
+		m_RotationInvStep = GetUniformInvStep(m_Rotations);
+		m_ScaleInvStep = GetUniformInvStep(m_Scales);
 	}
 
 	// This method updates the bone's internal local transform, typically used for non-blended animation
@@ -84,131 +165,155 @@ public:
     // New method to get the animated local transform matrix directly, useful for blending
     glm::mat4 GetAnimatedTransform(float animationTime)
     {
-        glm::mat4 translation = InterpolatePosition(animationTime);
-        glm::mat4 rotation = InterpolateRotation(animationTime);
-        glm::mat4 scale = InterpolateScaling(animationTime);
+        return GetAnimatedTransform(animationTime, m_Cursor);
+    }
+
+    // Same as above, but with a caller-owned cursor so several animators (or threads) can play this bone at once
+    glm::mat4 GetAnimatedTransform(float animationTime, BoneCursor& cursor) const
+    {
+        glm::mat4 translation = glm::translate(glm::mat4(1.0f), GetInterpolatedPosition(animationTime, cursor));
+        glm::mat4 rotation = glm::toMat4(GetInterpolatedRotation(animationTime, cursor));
+        glm::mat4 scale = glm::scale(glm::mat4(1.0f), GetInterpolatedScaling(animationTime, cursor));
         return translation * rotation * scale;
     }
 
 
 	glm::mat4 GetLocalTransform() { return m_LocalTransform; }
+	const std::vector<KeyPosition>& GetPositionKeys() const { return m_Positions; }
+	const std::vector<KeyRotation>& GetRotationKeys() const { return m_Rotations; }
+	const std::vector<KeyScale>& GetScaleKeys() const { return m_Scales; }
 	std::string GetBoneName() const { return m_Name; }
 	int GetBoneID() { return m_ID; }
 
     int GetPositionIndex(float animationTime)
     {
-        for (int index = 0; index < m_NumPositions - 1; ++index)
-        {
-            if (animationTime < m_Positions[index + 1].timeStamp)
-                return index;
-        }
-        if (m_NumPositions > 0) return m_NumPositions - 1;
-        return 0; // Fallback
+        return FindKeyIndex(m_Positions, m_PositionInvStep, animationTime, m_Cursor.position);
     }
 
     int GetRotationIndex(float animationTime)
     {
-        for (int index = 0; index < m_NumRotations - 1; ++index)
-        {
-            if (animationTime < m_Rotations[index + 1].timeStamp)
-                return index;
-        }
-        if (m_NumRotations > 0) return m_NumRotations - 1;
-        return 0; // Fallback
+        return FindKeyIndex(m_Rotations, m_RotationInvStep, animationTime, m_Cursor.rotation);
     }
 
     int GetScaleIndex(float animationTime)
     {
-        for (int index = 0; index < m_NumScalings - 1; ++index)
-        {
-            if (animationTime < m_Scales[index + 1].timeStamp)
-                return index;
-        }
-        if (m_NumScalings > 0) return m_NumScalings - 1;
-        return 0; // Fallback
+        return FindKeyIndex(m_Scales, m_ScaleInvStep, animationTime, m_Cursor.scale);
     }
 
-	float GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime)
+	float GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime) const
 	{
 		float scaleFactor = 0.0f;
 		float midWayLength = animationTime - lastTimeStamp;
 		float framesDiff = nextTimeStamp - lastTimeStamp;
         if (framesDiff == 0) return 0.0f; // Avoid division by zero
 		scaleFactor = midWayLength / framesDiff;
-		return scaleFactor;
+        // Hold the first/last key outside the track's range instead of extrapolating
+		return glm::clamp(scaleFactor, 0.0f, 1.0f);
 	}
 
     // Simplified interpolation methods to directly return glm::mat4
     glm::mat4 InterpolatePosition(float animationTime)
     {
-        if (1 == m_NumPositions)
-            return glm::translate(glm::mat4(1.0f), m_Positions[0].position);
-
-        int p0Index = GetPositionIndex(animationTime);
-        int p1Index = p0Index + 1;
-        float scaleFactor = GetScaleFactor(m_Positions[p0Index].timeStamp,
-            m_Positions[p1Index].timeStamp, animationTime);
-        glm::vec3 finalPosition = glm::mix(m_Positions[p0Index].position, m_Positions[p1Index].position, scaleFactor);
-        return glm::translate(glm::mat4(1.0f), finalPosition);
+        return glm::translate(glm::mat4(1.0f), GetInterpolatedPosition(animationTime));
     }
 
     glm::mat4 InterpolateRotation(float animationTime)
     {
-        if (1 == m_NumRotations)
-        {
-            auto rotation = glm::normalize(m_Rotations[0].orientation);
-            return glm::toMat4(rotation);
-        }
-
-        int p0Index = GetRotationIndex(animationTime);
-        int p1Index = p0Index + 1;
-        float scaleFactor = GetScaleFactor(m_Rotations[p0Index].timeStamp,
-            m_Rotations[p1Index].timeStamp, animationTime);
-        glm::quat finalRotation = glm::slerp(m_Rotations[p0Index].orientation, m_Rotations[p1Index].orientation, scaleFactor);
-        finalRotation = glm::normalize(finalRotation);
-        return glm::toMat4(finalRotation);
+        return glm::toMat4(GetInterpolatedRotation(animationTime));
     }
 
     glm::mat4 InterpolateScaling(float animationTime)
     {
-        if (1 == m_NumScalings)
-            return glm::scale(glm::mat4(1.0f), m_Scales[0].scale);
-
-        int p0Index = GetScaleIndex(animationTime);
-        int p1Index = p0Index + 1;
-        float scaleFactor = GetScaleFactor(m_Scales[p0Index].timeStamp,
-            m_Scales[p1Index].timeStamp, animationTime);
-        glm::vec3 finalScale = glm::mix(m_Scales[p0Index].scale, m_Scales[p1Index].scale, scaleFactor);
-        return glm::scale(glm::mat4(1.0f), finalScale);
+        return glm::scale(glm::mat4(1.0f), GetInterpolatedScaling(animationTime));
     }
 
     // Helper methods to get interpolated components directly (made public for Animator)
-    glm::vec3 GetInterpolatedPosition(float animationTime) {
+    glm::vec3 GetInterpolatedPosition(float animationTime) { return GetInterpolatedPosition(animationTime, m_Cursor); }
+    glm::quat GetInterpolatedRotation(float animationTime) { return GetInterpolatedRotation(animationTime, m_Cursor); }
+    glm::vec3 GetInterpolatedScaling(float animationTime) { return GetInterpolatedScaling(animationTime, m_Cursor); }
+
+    glm::vec3 GetInterpolatedPosition(float animationTime, BoneCursor& cursor) const {
         if (1 == m_NumPositions) return m_Positions[0].position;
-        int p0Index = GetPositionIndex(animationTime);
+        int p0Index = FindKeyIndex(m_Positions, m_PositionInvStep, animationTime, cursor.position);
         int p1Index = p0Index + 1;
         float scaleFactor = GetScaleFactor(m_Positions[p0Index].timeStamp, m_Positions[p1Index].timeStamp, animationTime);
         return glm::mix(m_Positions[p0Index].position, m_Positions[p1Index].position, scaleFactor);
     }
 
-    glm::quat GetInterpolatedRotation(float animationTime) {
+    glm::quat GetInterpolatedRotation(float animationTime, BoneCursor& cursor) const {
         if (1 == m_NumRotations) return glm::normalize(m_Rotations[0].orientation);
-        int p0Index = GetRotationIndex(animationTime);
+        int p0Index = FindKeyIndex(m_Rotations, m_RotationInvStep, animationTime, cursor.rotation);
         int p1Index = p0Index + 1;
         float scaleFactor = GetScaleFactor(m_Rotations[p0Index].timeStamp, m_Rotations[p1Index].timeStamp, animationTime);
         return glm::normalize(glm::slerp(m_Rotations[p0Index].orientation, m_Rotations[p1Index].orientation, scaleFactor));
     }
 
-    glm::vec3 GetInterpolatedScaling(float animationTime) {
+    glm::vec3 GetInterpolatedScaling(float animationTime, BoneCursor& cursor) const {
         if (1 == m_NumScalings) return m_Scales[0].scale;
-        int p0Index = GetScaleIndex(animationTime);
+        int p0Index = FindKeyIndex(m_Scales, m_ScaleInvStep, animationTime, cursor.scale);
         int p1Index = p0Index + 1;
         float scaleFactor = GetScaleFactor(m_Scales[p0Index].timeStamp, m_Scales[p1Index].timeStamp, animationTime);
         return glm::mix(m_Scales[p0Index].scale, m_Scales[p1Index].scale, scaleFactor);
     }
 
+    // Re-samples every track at a fixed rate (in ticks) so key lookup becomes a direct index.
+    // Lossless when the rate matches the rate the clip was exported at.
+    void Resample(float ticksPerSample, float duration)
+    {
+        if (ticksPerSample <= 0.0f || duration <= 0.0f)
+            return;
+
+        int sampleCount = static_cast<int>(std::ceil(duration / ticksPerSample)) + 1;
+        std::vector<KeyPosition> positions;
+        std::vector<KeyRotation> rotations;
+        std::vector<KeyScale> scales;
+        positions.reserve(m_NumPositions > 1 ? sampleCount : 1);
+        rotations.reserve(m_NumRotations > 1 ? sampleCount : 1);
+        scales.reserve(m_NumScalings > 1 ? sampleCount : 1);
+
+        BoneCursor cursor;
+        for (int i = 0; i < sampleCount; ++i)
+        {
+            float timeStamp = i * ticksPerSample;
+            if (m_NumPositions > 1 || i == 0)
+                positions.push_back({ GetInterpolatedPosition(timeStamp, cursor), timeStamp });
+            if (m_NumRotations > 1 || i == 0)
+                rotations.push_back({ GetInterpolatedRotation(timeStamp, cursor), timeStamp });
+            if (m_NumScalings > 1 || i == 0)
+                scales.push_back({ GetInterpolatedScaling(timeStamp, cursor), timeStamp });
+        }
+
+        m_Positions.swap(positions);
+        m_Rotations.swap(rotations);
+        m_Scales.swap(scales);
+        m_NumPositions = static_cast<int>(m_Positions.size());
+        m_NumRotations = static_cast<int>(m_Rotations.size());
+        m_NumScalings = static_cast<int>(m_Scales.size());
+
+        float invStep = 1.0f / ticksPerSample;
+        m_PositionInvStep = m_NumPositions > 1 ? invStep : 0.0f;
+        m_RotationInvStep = m_NumRotations > 1 ? invStep : 0.0f;
+        m_ScaleInvStep = m_NumScalings > 1 ? invStep : 0.0f;
+        m_Cursor = BoneCursor();
+    }
+
 
-private: // The actual member variables remain private
+private:
+    template <typename Key>
+    static int FindKeyIndex(const std::vector<Key>& keys, float invStep, float animationTime, int& cursor)
+    {
+        return FindKeyframe(static_cast<int>(keys.size()), invStep, animationTime, cursor,
+            [&keys](int index) { return keys[index].timeStamp; });
+    }
+
+    template <typename Key>
+    static float GetUniformInvStep(const std::vector<Key>& keys)
+    {
+        return GetUniformKeyInvStep(static_cast<int>(keys.size()),
+            [&keys](int index) { return keys[index].timeStamp; });
+    }
+
+	// The actual member variables remain private
 	std::vector<KeyPosition> m_Positions;
 	std::vector<KeyRotation> m_Rotations;
 	std::vector<KeyScale> m_Scales;
@@ -216,6 +321,12 @@ private: // The actual member variables remain private
 	int m_NumRotations;
 	int m_NumScalings;
 
+	// 1 / key spacing for evenly spaced tracks, 0 when keys have to be searched
+	float m_PositionInvStep = 0.0f;
+	float m_RotationInvStep = 0.0f;
+	float m_ScaleInvStep = 0.0f;
+	BoneCursor m_Cursor;
+
 	glm::mat4 m_LocalTransform;
 	std::string m_Name;
 	int m_ID;
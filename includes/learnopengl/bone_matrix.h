@@ -0,0 +1,20 @@
+#pragma once
+
+/* Palette entries keep only the top three rows of a bone matrix, as the columns of a glm::mat3x4: 48 bytes
+   instead of 64, since the bottom row of an affine transform is always (0, 0, 0, 1). std140 and the
+   instance texture buffer lay a mat3x4 out as three vec4s, so the shaders read the same bytes and skin with
+   vec4(position, 1.0) * matrix. */
+
+#include <glm/glm.hpp>
+
+typedef glm::mat3x4 BoneMatrix;
+
+inline BoneMatrix ToBoneMatrix(const glm::mat4& matrix)
+{
+	return glm::transpose(glm::mat4x3(matrix));
+}
+
+inline glm::mat4 ToMat4(const BoneMatrix& matrix)
+{
+	return glm::mat4(glm::transpose(matrix));
+}
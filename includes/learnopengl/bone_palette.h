@@ -0,0 +1,80 @@
+#pragma once
+
+/* Uniform buffer holding a character's final bone matrices, read by the BonePalette block in anim_model.vs as
+   mat3x4s (see bone_matrix.h) */
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/bone_matrix.h>
+#include <learnopengl/shader_m.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+class BonePaletteBuffer
+{
+public:
+	// Must match MAX_BONES in the shader; 100 mat3x4s is well within the 16KB minimum uniform block size
+	static const int MaxBones = 100;
+
+	BonePaletteBuffer(unsigned int bindingPoint = 0)
+		: m_BindingPoint(bindingPoint)
+	{
+		glGenBuffers(1, &m_UBO);
+		glBindBuffer(GL_UNIFORM_BUFFER, m_UBO);
+		glBufferData(GL_UNIFORM_BUFFER, GetSize(), NULL, GL_STREAM_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, m_BindingPoint, m_UBO);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	~BonePaletteBuffer()
+	{
+		glDeleteBuffers(1, &m_UBO);
+	}
+
+	BonePaletteBuffer(const BonePaletteBuffer&) = delete;
+	BonePaletteBuffer& operator=(const BonePaletteBuffer&) = delete;
+
+	// Points the shader's uniform block at this buffer's binding point; only needed once per program
+	void BindShader(const Shader& shader, const std::string& blockName = "BonePalette") const
+	{
+		unsigned int blockIndex = glGetUniformBlockIndex(shader.ID, blockName.c_str());
+		if (blockIndex != GL_INVALID_INDEX)
+			glUniformBlockBinding(shader.ID, blockIndex, m_BindingPoint);
+	}
+
+	// One buffer update per character. The storage is orphaned first so the driver can hand out fresh
+	// memory instead of waiting for draws still reading last frame's palette (persistent mapping needs
+	// GL 4.4, these demos target 3.3). Skeletons with more than MaxBones bones can't be skinned by this
+	// shader and should be rejected at load; only the first MaxBones matrices would be uploaded.
+	void Upload(const BoneMatrix* matrices, int count)
+	{
+		if (count > MaxBones)
+		{
+			if (!m_ReportedOverflow)
+				std::cout << "ERROR::BONE_PALETTE:: " << count << " bone matrices, only the first " << MaxBones << " are uploaded" << std::endl;
+			m_ReportedOverflow = true;
+			count = MaxBones;
+		}
+		glBindBuffer(GL_UNIFORM_BUFFER, m_UBO);
+		glBufferData(GL_UNIFORM_BUFFER, GetSize(), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, count * sizeof(BoneMatrix), matrices);
+		glBindBufferBase(GL_UNIFORM_BUFFER, m_BindingPoint, m_UBO);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	void Upload(const std::vector<BoneMatrix>& matrices)
+	{
+		Upload(matrices.data(), static_cast<int>(matrices.size()));
+	}
+
+	unsigned int GetID() const { return m_UBO; }
+
+private:
+	static GLsizeiptr GetSize() { return MaxBones * sizeof(BoneMatrix); }
+
+	unsigned int m_UBO = 0;
+	unsigned int m_BindingPoint;
+	bool m_ReportedOverflow = false;
+};
@@ -0,0 +1,319 @@
+#pragma once
+
+/* Loads animation clips on a background thread the first time they're asked for, prefetches the ones
+   likely to be needed next and evicts the least recently used ones under a memory budget. The public
+   interface is meant for one (the main) thread; the loader thread only builds clips, which are handed
+   over in Update, so nothing the main thread holds is ever touched behind its back. */
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <learnopengl/animation.h>
+#include <learnopengl/animation_soa.h>
+#include <learnopengl/bone.h>
+#include <learnopengl/skeleton.h>
+
+enum class ClipState
+{
+	Unloaded,
+	Loading,
+	Ready
+};
+
+class AnimationClipManager
+{
+public:
+	// Clips are read against model, whose bone map Animation extends with missing bones; loads run one at a
+	// time so that map is never written from two threads. memoryBudget is in bytes, 0 for no limit.
+	explicit AnimationClipManager(Model* model, size_t memoryBudget = 0)
+		: m_Model(model), m_MemoryBudget(memoryBudget)
+	{
+		m_Loader = std::thread(&AnimationClipManager::LoaderLoop, this);
+	}
+
+	~AnimationClipManager()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stop = true;
+		}
+		m_WakeUp.notify_all();
+		m_Loader.join();
+	}
+
+	AnimationClipManager(const AnimationClipManager&) = delete;
+	AnimationClipManager& operator=(const AnimationClipManager&) = delete;
+
+	// Under the lock, as growing m_Clips may move the entries while the loader reads a queued clip's path
+	int AddClip(const std::string& path)
+	{
+		ClipEntry entry;
+		entry.path = path;
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Clips.push_back(std::move(entry));
+		return static_cast<int>(m_Clips.size()) - 1;
+	}
+
+	// Every clip gets a SoaClip built against this skeleton from now on: on the loader thread, or here for
+	// clips loaded before it was set (typically the one the skeleton came from)
+	void SetSkeleton(std::shared_ptr<const Skeleton> skeleton)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Skeleton = std::move(skeleton);
+		}
+		for (ClipEntry& entry : m_Clips)
+			if (entry.state == ClipState::Ready && !entry.soaClip)
+				BuildSoaClip(entry.animation.get(), entry.soaClip, entry.size);
+		m_PeakMemoryUsage = glm::max(m_PeakMemoryUsage, m_MemoryUsage);
+	}
+
+	// Called for a clip right before it's freed, to drop every reference to its Animation and SoaClip
+	void SetEvictCallback(std::function<void(int clip, Animation* animation, const SoaClip* soaClip)> callback)
+	{
+		m_EvictCallback = std::move(callback);
+	}
+
+	// Blocks until the clip is loaded; for clips needed before the first frame
+	Animation* Load(int clip)
+	{
+		if (m_Clips[clip].state != ClipState::Ready)
+		{
+			Queue(clip, true);
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_LoadDone.wait(lock, [&]()
+			{
+				for (const FinishedLoad& finished : m_Finished)
+					if (finished.clip == clip)
+						return true;
+				return false;
+			});
+			lock.unlock();
+			TakeFinishedLoads();
+		}
+		m_Clips[clip].lastUse = m_Frame;
+		return m_Clips[clip].animation.get();
+	}
+
+	// Doesn't block: marks the clip as used this frame, which keeps it from being evicted, and queues it
+	// ahead of any prefetch if it isn't loaded. NULL until it's ready.
+	Animation* Request(int clip)
+	{
+		ClipEntry& entry = m_Clips[clip];
+		entry.lastUse = m_Frame;
+		if (entry.state == ClipState::Unloaded)
+			Queue(clip, true);
+		return entry.animation.get();
+	}
+
+	// Queues a clip that may be needed soon behind the requests. It doesn't count as a use, and nothing is
+	// queued once the budget is used up.
+	void Prefetch(int clip)
+	{
+		if (m_Clips[clip].state == ClipState::Unloaded && (m_MemoryBudget == 0 || m_MemoryUsage < m_MemoryBudget))
+			Queue(clip, false);
+	}
+
+	// Once per frame: takes over finished loads, then evicts the least recently used clips not requested
+	// this frame for as long as the budget is exceeded
+	void Update()
+	{
+		TakeFinishedLoads();
+		while (m_MemoryBudget > 0 && m_MemoryUsage > m_MemoryBudget)
+		{
+			int victim = -1;
+			for (int i = 0; i < GetClipCount(); i++)
+			{
+				const ClipEntry& entry = m_Clips[i];
+				if (entry.state == ClipState::Ready && entry.lastUse < m_Frame && (victim < 0 || entry.lastUse < m_Clips[victim].lastUse))
+					victim = i;
+			}
+			if (victim < 0)
+				break;
+			Evict(victim);
+		}
+		m_Frame++;
+	}
+
+	ClipState GetState(int clip) const { return m_Clips[clip].state; }
+	bool IsReady(int clip) const { return m_Clips[clip].state == ClipState::Ready; }
+	Animation* GetAnimation(int clip) const { return m_Clips[clip].animation.get(); }
+	const SoaClip* GetSoaClip(int clip) const { return m_Clips[clip].soaClip.get(); }
+	int GetClipCount() const { return static_cast<int>(m_Clips.size()); }
+
+	// Estimated bytes of the loaded clips (keys, hierarchy copy and SoA data)
+	size_t GetMemoryUsage() const { return m_MemoryUsage; }
+	size_t GetPeakMemoryUsage() const { return m_PeakMemoryUsage; }
+	int GetEvictionCount() const { return m_EvictionCount; }
+
+	// Rough heap size of an Animation: its hierarchy copy, bone tracks and bone map
+	static size_t EstimateSize(Animation* animation)
+	{
+		size_t size = sizeof(Animation) + animation->GetBoneIDMap().size() * (sizeof(BoneInfo) + sizeof(std::string) + 4 * sizeof(void*));
+		std::vector<const AssimpNodeData*> stack = { &animation->GetRootNode() };
+		while (!stack.empty())
+		{
+			const AssimpNodeData* node = stack.back();
+			stack.pop_back();
+			size += sizeof(AssimpNodeData) + node->name.capacity();
+			if (const Bone* bone = animation->FindBone(node->name))
+				size += sizeof(Bone) + bone->GetPositionKeys().capacity() * sizeof(KeyPosition)
+					+ bone->GetRotationKeys().capacity() * sizeof(KeyRotation) + bone->GetScaleKeys().capacity() * sizeof(KeyScale);
+			for (const AssimpNodeData& child : node->children)
+				stack.push_back(&child);
+		}
+		return size;
+	}
+
+private:
+	struct ClipEntry
+	{
+		std::string path;
+		ClipState state = ClipState::Unloaded;
+		std::unique_ptr<Animation> animation;
+		std::unique_ptr<SoaClip> soaClip;
+		size_t size = 0;
+		long long lastUse = -1; // frame of the last Request
+	};
+
+	struct FinishedLoad
+	{
+		int clip;
+		std::unique_ptr<Animation> animation;
+		std::unique_ptr<SoaClip> soaClip;
+		size_t size;
+	};
+
+	// Requests go to the front, prefetches to the back
+	void Queue(int clip, bool urgent)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (m_Clips[clip].state == ClipState::Unloaded)
+		{
+			m_Clips[clip].state = ClipState::Loading;
+			m_Queue.push_back(clip);
+		}
+		if (urgent)
+		{
+			// also promotes a queued prefetch
+			for (auto queued = m_Queue.begin(); queued != m_Queue.end(); ++queued)
+				if (*queued == clip)
+				{
+					m_Queue.erase(queued);
+					m_Queue.push_front(clip);
+					break;
+				}
+		}
+		m_WakeUp.notify_one();
+	}
+
+	void LoaderLoop()
+	{
+		for (;;)
+		{
+			int clip;
+			std::string path;
+			std::shared_ptr<const Skeleton> skeleton;
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_WakeUp.wait(lock, [this]() { return m_Stop || !m_Queue.empty(); });
+				if (m_Stop)
+					return;
+				clip = m_Queue.front();
+				m_Queue.pop_front();
+				path = m_Clips[clip].path;
+				skeleton = m_Skeleton;
+			}
+
+			FinishedLoad load;
+			load.clip = clip;
+			load.animation.reset(new Animation(path, m_Model));
+			load.size = EstimateSize(load.animation.get());
+			if (skeleton)
+			{
+				load.soaClip.reset(new SoaClip(*skeleton, load.animation.get()));
+				load.size += load.soaClip->GetDataSize();
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_Finished.push_back(std::move(load));
+			}
+			m_LoadDone.notify_all();
+		}
+	}
+
+	void TakeFinishedLoads()
+	{
+		std::vector<FinishedLoad> finished;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			finished.swap(m_Finished);
+		}
+		for (FinishedLoad& load : finished)
+		{
+			ClipEntry& entry = m_Clips[load.clip];
+			entry.animation = std::move(load.animation);
+			entry.soaClip = std::move(load.soaClip);
+			entry.size = load.size;
+			// loaded before SetSkeleton
+			if (!entry.soaClip && m_Skeleton)
+				BuildSoaClip(entry.animation.get(), entry.soaClip, entry.size);
+			entry.state = ClipState::Ready;
+			// a fresh clip isn't evicted the frame it arrives
+			entry.lastUse = glm::max(entry.lastUse, m_Frame);
+			m_MemoryUsage += load.size;
+		}
+		m_PeakMemoryUsage = glm::max(m_PeakMemoryUsage, m_MemoryUsage);
+	}
+
+	// Main thread only; counts the SoaClip against the clip's size and the usage
+	void BuildSoaClip(Animation* animation, std::unique_ptr<SoaClip>& soaClip, size_t& size)
+	{
+		soaClip.reset(new SoaClip(*m_Skeleton, animation));
+		size += soaClip->GetDataSize();
+		m_MemoryUsage += soaClip->GetDataSize();
+	}
+
+	void Evict(int clip)
+	{
+		ClipEntry& entry = m_Clips[clip];
+		if (m_EvictCallback)
+			m_EvictCallback(clip, entry.animation.get(), entry.soaClip.get());
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (m_Skeleton)
+				m_Skeleton->ReleaseTracks(entry.animation.get());
+			entry.state = ClipState::Unloaded;
+		}
+		entry.soaClip.reset();
+		entry.animation.reset();
+		m_MemoryUsage -= entry.size;
+		entry.size = 0;
+		m_EvictionCount++;
+	}
+
+	Model* m_Model;
+	size_t m_MemoryBudget;
+	size_t m_MemoryUsage = 0;
+	size_t m_PeakMemoryUsage = 0;
+	int m_EvictionCount = 0;
+	long long m_Frame = 0;
+	std::vector<ClipEntry> m_Clips;
+	std::function<void(int, Animation*, const SoaClip*)> m_EvictCallback;
+
+	// Shared with the loader thread
+	std::mutex m_Mutex;
+	std::condition_variable m_WakeUp;
+	std::condition_variable m_LoadDone;
+	std::deque<int> m_Queue;
+	std::vector<FinishedLoad> m_Finished;
+	std::shared_ptr<const Skeleton> m_Skeleton;
+	bool m_Stop = false;
+	std::thread m_Loader;
+};
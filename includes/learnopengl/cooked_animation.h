@@ -0,0 +1,335 @@
+#pragma once
+
+/* Pre-cooked skeleton, bone-info map and clips in one binary file. The file is memory-mapped and clips
+   are sampled straight out of the mapping through SoaClip views, so loading parses no DAE and copies no
+   keys. Open fails (and callers fall back to Assimp) when the file is missing, from another version or
+   byte order, or older than the sources it was cooked from.
+
+   Layout, all values little-endian, every section starting on a 32-byte boundary:
+     CookedFileHeader
+     CookedNode[nodeCount]           skeleton in Skeleton's parent-before-child order
+     CookedBoneInfo[boneInfoCount]
+     CookedClip[clipCount]
+     names                           not null-terminated, referenced by offset/length
+     clip data blocks                SoaClip layout, one per clip */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <learnopengl/animation.h>
+#include <learnopengl/animation_soa.h>
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/skeleton.h>
+
+struct CookedFileHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t endianTag;    // CookedEndianTag as stored by the cooking machine
+	uint32_t sourceCount;
+	uint64_t sourceStamp;  // hash of the modification times and sizes of the sources
+	uint32_t nodeCount;
+	uint32_t boneInfoCount;
+	uint32_t clipCount;
+	uint32_t padding;
+	uint64_t nodesOffset;
+	uint64_t boneInfoOffset;
+	uint64_t clipsOffset;
+	uint64_t namesOffset;
+	uint64_t namesSize;
+	uint64_t fileSize;
+};
+
+struct CookedNode
+{
+	float transformation[16];
+	float offset[16];
+	int32_t parent;
+	int32_t boneIndex;
+	uint32_t nameOffset;
+	uint32_t nameLength;
+};
+
+struct CookedBoneInfo
+{
+	float offset[16];
+	int32_t id;
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	uint32_t padding;
+};
+
+struct CookedClip
+{
+	SoaClipHeader header;
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	uint32_t padding;
+	uint64_t dataOffset;
+	uint64_t dataSize;
+};
+
+static_assert(sizeof(CookedFileHeader) == 88, "cooked header layout");
+static_assert(sizeof(CookedNode) == 144, "cooked node layout");
+static_assert(sizeof(CookedBoneInfo) == 80, "cooked bone info layout");
+static_assert(sizeof(CookedClip) == 56, "cooked clip layout");
+
+const uint32_t CookedVersion = 1;
+const uint32_t CookedEndianTag = 0x01020304;
+
+class CookedAnimationFile
+{
+public:
+	// Writes the file. sourcePaths are the files the data came from (model and clips); their stamps decide
+	// later whether the cooked file is still current. Clips are cooked against the given skeleton.
+	static bool Cook(const std::string& path, const std::vector<std::string>& sourcePaths, const Skeleton& skeleton,
+		const std::map<std::string, BoneInfo>& boneInfoMap, const std::vector<std::string>& clipNames, const std::vector<Animation*>& clips)
+	{
+		if (!IsLittleEndian())
+			return false;
+
+		CookedFileHeader header = {};
+		std::memcpy(header.magic, "LGAC", 4);
+		header.version = CookedVersion;
+		header.endianTag = CookedEndianTag;
+		header.sourceCount = static_cast<uint32_t>(sourcePaths.size());
+		if (!ComputeSourceStamp(sourcePaths, header.sourceStamp))
+			return false;
+		header.nodeCount = static_cast<uint32_t>(skeleton.GetNodeCount());
+		header.boneInfoCount = static_cast<uint32_t>(boneInfoMap.size());
+		header.clipCount = static_cast<uint32_t>(clips.size());
+
+		std::string names;
+		auto addName = [&names](const std::string& name, uint32_t& offset, uint32_t& length)
+		{
+			offset = static_cast<uint32_t>(names.size());
+			length = static_cast<uint32_t>(name.size());
+			names += name;
+		};
+
+		std::vector<CookedNode> nodes(header.nodeCount);
+		for (int i = 0; i < skeleton.GetNodeCount(); i++)
+		{
+			const SkeletonNode& node = skeleton.GetNodes()[i];
+			std::memcpy(nodes[i].transformation, &node.transformation[0][0], sizeof(nodes[i].transformation));
+			std::memcpy(nodes[i].offset, &node.offset[0][0], sizeof(nodes[i].offset));
+			nodes[i].parent = node.parent;
+			nodes[i].boneIndex = node.boneIndex;
+			addName(skeleton.GetNodeName(i), nodes[i].nameOffset, nodes[i].nameLength);
+		}
+
+		std::vector<CookedBoneInfo> boneInfos;
+		for (const auto& entry : boneInfoMap)
+		{
+			CookedBoneInfo info = {};
+			std::memcpy(info.offset, &entry.second.offset[0][0], sizeof(info.offset));
+			info.id = entry.second.id;
+			addName(entry.first, info.nameOffset, info.nameLength);
+			boneInfos.push_back(info);
+		}
+
+		std::vector<SoaClip> soaClips;
+		std::vector<CookedClip> cookedClips(header.clipCount);
+		for (size_t i = 0; i < clips.size(); i++)
+		{
+			soaClips.push_back(SoaClip(skeleton, clips[i]));
+			cookedClips[i].header = soaClips[i].GetHeader();
+			addName(clipNames[i], cookedClips[i].nameOffset, cookedClips[i].nameLength);
+		}
+
+		size_t offset = SoaClip::AlignOffset(sizeof(CookedFileHeader));
+		header.nodesOffset = offset;
+		offset = SoaClip::AlignOffset(offset + nodes.size() * sizeof(CookedNode));
+		header.boneInfoOffset = offset;
+		offset = SoaClip::AlignOffset(offset + boneInfos.size() * sizeof(CookedBoneInfo));
+		header.clipsOffset = offset;
+		offset = SoaClip::AlignOffset(offset + cookedClips.size() * sizeof(CookedClip));
+		header.namesOffset = offset;
+		header.namesSize = names.size();
+		offset = SoaClip::AlignOffset(offset + names.size());
+		for (size_t i = 0; i < cookedClips.size(); i++)
+		{
+			cookedClips[i].dataOffset = offset;
+			cookedClips[i].dataSize = soaClips[i].GetDataSize();
+			offset = SoaClip::AlignOffset(offset + soaClips[i].GetDataSize());
+		}
+		header.fileSize = offset;
+
+		std::ofstream file(path, std::ios::binary);
+		if (!file)
+			return false;
+		WriteAt(file, 0, &header, sizeof(header));
+		WriteAt(file, header.nodesOffset, nodes.data(), nodes.size() * sizeof(CookedNode));
+		WriteAt(file, header.boneInfoOffset, boneInfos.data(), boneInfos.size() * sizeof(CookedBoneInfo));
+		WriteAt(file, header.clipsOffset, cookedClips.data(), cookedClips.size() * sizeof(CookedClip));
+		WriteAt(file, header.namesOffset, names.data(), names.size());
+		for (size_t i = 0; i < soaClips.size(); i++)
+			WriteAt(file, cookedClips[i].dataOffset, soaClips[i].GetData(), soaClips[i].GetDataSize());
+		WriteAt(file, header.fileSize, NULL, 0);
+		return static_cast<bool>(file);
+	}
+
+	// Maps the file and sets up the skeleton and clip views; false if it's missing, malformed or stale
+	bool Open(const std::string& path, const std::vector<std::string>& sourcePaths)
+	{
+		m_Clips.clear();
+		m_ClipNames.clear();
+		if (!m_File.Open(path) || m_File.Size() < sizeof(CookedFileHeader))
+			return Fail();
+
+		const CookedFileHeader& header = *static_cast<const CookedFileHeader*>(m_File.Data());
+		uint64_t sourceStamp;
+		if (std::memcmp(header.magic, "LGAC", 4) != 0 || header.version != CookedVersion || header.endianTag != CookedEndianTag
+			|| header.fileSize != m_File.Size() || header.sourceCount != sourcePaths.size()
+			|| !ComputeSourceStamp(sourcePaths, sourceStamp) || sourceStamp != header.sourceStamp)
+			return Fail();
+
+		if (!InFile(header.nodesOffset, header.nodeCount * sizeof(CookedNode)) || !InFile(header.boneInfoOffset, header.boneInfoCount * sizeof(CookedBoneInfo))
+			|| !InFile(header.clipsOffset, header.clipCount * sizeof(CookedClip)) || !InFile(header.namesOffset, header.namesSize))
+			return Fail();
+
+		const CookedNode* nodes = At<CookedNode>(header.nodesOffset);
+		std::vector<SkeletonNode> skeletonNodes(header.nodeCount);
+		std::vector<std::string> nodeNames(header.nodeCount);
+		for (uint32_t i = 0; i < header.nodeCount; i++)
+		{
+			std::memcpy(&skeletonNodes[i].transformation[0][0], nodes[i].transformation, sizeof(nodes[i].transformation));
+			std::memcpy(&skeletonNodes[i].offset[0][0], nodes[i].offset, sizeof(nodes[i].offset));
+			skeletonNodes[i].parent = nodes[i].parent;
+			skeletonNodes[i].boneIndex = nodes[i].boneIndex;
+			// parents come first, and bone slots index the palette, so anything else would write out of bounds
+			if (nodes[i].parent < -1 || nodes[i].parent >= static_cast<int32_t>(i)
+				|| nodes[i].boneIndex < -1 || nodes[i].boneIndex >= static_cast<int32_t>(header.boneInfoCount)
+				|| !GetName(nodes[i].nameOffset, nodes[i].nameLength, nodeNames[i]))
+				return Fail();
+		}
+		const CookedBoneInfo* boneInfos = At<CookedBoneInfo>(header.boneInfoOffset);
+		for (uint32_t i = 0; i < header.boneInfoCount; i++)
+			if (boneInfos[i].id < 0 || boneInfos[i].id >= static_cast<int32_t>(header.boneInfoCount))
+				return Fail();
+		m_Skeleton = std::make_shared<const Skeleton>(skeletonNodes, nodeNames);
+
+		const CookedClip* clips = At<CookedClip>(header.clipsOffset);
+		m_Clips.reserve(header.clipCount);
+		for (uint32_t i = 0; i < header.clipCount; i++)
+		{
+			std::string name;
+			SoaClip clip(clips[i].header, At<unsigned char>(clips[i].dataOffset));
+			if (clips[i].header.nodeCount != static_cast<int>(header.nodeCount) || clip.GetDataSize() != clips[i].dataSize
+				|| !InFile(clips[i].dataOffset, clips[i].dataSize) || !GetName(clips[i].nameOffset, clips[i].nameLength, name))
+				return Fail();
+			// a block of the right size can still hold key ranges or track ids that Sample would follow out of it
+			if (!clip.IsValid())
+				return Fail();
+			m_Clips.push_back(clip);
+			m_ClipNames.push_back(name);
+		}
+		return true;
+	}
+
+	const Skeleton& GetSkeleton() const { return *m_Skeleton; }
+	// For animators sharing the skeleton; stays valid after this file is closed
+	const std::shared_ptr<const Skeleton>& GetSharedSkeleton() const { return m_Skeleton; }
+	int GetClipCount() const { return static_cast<int>(m_Clips.size()); }
+	// View into the mapping; valid while this object is alive
+	const SoaClip& GetClip(int clip) const { return m_Clips[clip]; }
+	const std::string& GetClipName(int clip) const { return m_ClipNames[clip]; }
+
+	int FindClip(const std::string& name) const
+	{
+		for (size_t i = 0; i < m_ClipNames.size(); i++)
+			if (m_ClipNames[i] == name)
+				return static_cast<int>(i);
+		return -1;
+	}
+
+	std::map<std::string, BoneInfo> GetBoneInfoMap() const
+	{
+		std::map<std::string, BoneInfo> boneInfoMap;
+		const CookedFileHeader& header = *static_cast<const CookedFileHeader*>(m_File.Data());
+		const CookedBoneInfo* infos = At<CookedBoneInfo>(header.boneInfoOffset);
+		for (uint32_t i = 0; i < header.boneInfoCount; i++)
+		{
+			std::string name;
+			if (!GetName(infos[i].nameOffset, infos[i].nameLength, name))
+				continue;
+			BoneInfo info;
+			info.id = infos[i].id;
+			std::memcpy(&info.offset[0][0], infos[i].offset, sizeof(infos[i].offset));
+			boneInfoMap[name] = info;
+		}
+		return boneInfoMap;
+	}
+
+private:
+	static bool IsLittleEndian()
+	{
+		uint32_t tag = CookedEndianTag;
+		unsigned char first;
+		std::memcpy(&first, &tag, 1);
+		return first == 0x04;
+	}
+
+	// FNV-1a over the modification time and size of every source, in order
+	static bool ComputeSourceStamp(const std::vector<std::string>& sourcePaths, uint64_t& stamp)
+	{
+		stamp = 14695981039346656037ull;
+		for (const std::string& path : sourcePaths)
+		{
+			int64_t values[2];
+			if (!MappedFile::GetFileStamp(path, values[0], values[1]))
+				return false;
+			const unsigned char* bytes = reinterpret_cast<const unsigned char*>(values);
+			for (size_t i = 0; i < sizeof(values); i++)
+				stamp = (stamp ^ bytes[i]) * 1099511628211ull;
+		}
+		return true;
+	}
+
+	static void WriteAt(std::ofstream& file, uint64_t offset, const void* data, size_t size)
+	{
+		// Sections follow each other in order, so only alignment padding is ever skipped
+		static const char zeros[AlignedBuffer::Alignment] = {};
+		uint64_t position = static_cast<uint64_t>(file.tellp());
+		while (position < offset)
+		{
+			size_t padding = static_cast<size_t>(std::min<uint64_t>(offset - position, sizeof(zeros)));
+			file.write(zeros, padding);
+			position += padding;
+		}
+		if (size > 0)
+			file.write(static_cast<const char*>(data), size);
+	}
+
+	bool InFile(uint64_t offset, uint64_t size) const { return offset <= m_File.Size() && size <= m_File.Size() - offset; }
+
+	bool GetName(uint32_t offset, uint32_t length, std::string& name) const
+	{
+		const CookedFileHeader& header = *static_cast<const CookedFileHeader*>(m_File.Data());
+		if (static_cast<uint64_t>(offset) + length > header.namesSize)
+			return false;
+		name.assign(At<char>(header.namesOffset + offset), length);
+		return true;
+	}
+
+	template <typename T> const T* At(uint64_t offset) const { return reinterpret_cast<const T*>(static_cast<const unsigned char*>(m_File.Data()) + offset); }
+
+	bool Fail()
+	{
+		m_Clips.clear();
+		m_ClipNames.clear();
+		m_File.Close();
+		return false;
+	}
+
+	MappedFile m_File;
+	std::shared_ptr<const Skeleton> m_Skeleton = std::make_shared<const Skeleton>();
+	std::vector<SoaClip> m_Clips;
+	std::vector<std::string> m_ClipNames;
+};
@@ -0,0 +1,169 @@
+#pragma once
+
+/* Linear blend skinning on the CPU, following the same rules as anim_model.vs: influences with id -1 are
+   skipped, and a vertex with an id past the palette is drawn in its bind pose. It serves as a software
+   fallback and as a reference to diff the shader against. SkinReference is a line-by-line port of the
+   shader loop; Skin gives the same result faster by resolving those rules once per mesh, blending the
+   four matrices a column at a time with SimdFloat4 and splitting the vertices over a TaskPool. */
+
+#include <cmath>
+#include <vector>
+#include <glm/glm.hpp>
+#include <learnopengl/simd.h>
+#include <learnopengl/task_pool.h>
+
+class SkinningMesh
+{
+public:
+	static const int MaxInfluences = 4; // MAX_BONE_INFLUENCE in the shader
+
+	void Reserve(int vertexCount)
+	{
+		m_Positions.reserve(vertexCount);
+		m_Normals.reserve(vertexCount);
+		m_BoneIds.reserve(vertexCount);
+		m_Weights.reserve(vertexCount);
+	}
+
+	void AddVertex(const glm::vec3& position, const glm::vec3& normal, const glm::ivec4& boneIds, const glm::vec4& weights)
+	{
+		m_Positions.push_back(position);
+		m_Normals.push_back(normal);
+		m_BoneIds.push_back(boneIds);
+		m_Weights.push_back(weights);
+		m_PreparedBoneCount = -1;
+	}
+
+	// Takes anything shaped like the Vertex of mesh.h (Position, Normal, m_BoneIDs, m_Weights)
+	template <typename VertexType>
+	void AddVertices(const std::vector<VertexType>& vertices)
+	{
+		Reserve(GetVertexCount() + static_cast<int>(vertices.size()));
+		for (const VertexType& vertex : vertices)
+			AddVertex(vertex.Position, vertex.Normal,
+				glm::ivec4(vertex.m_BoneIDs[0], vertex.m_BoneIDs[1], vertex.m_BoneIDs[2], vertex.m_BoneIDs[3]),
+				glm::vec4(vertex.m_Weights[0], vertex.m_Weights[1], vertex.m_Weights[2], vertex.m_Weights[3]));
+	}
+
+	int GetVertexCount() const { return static_cast<int>(m_Positions.size()); }
+	const glm::vec3* GetPositions() const { return m_Positions.data(); }
+	const glm::vec3* GetNormals() const { return m_Normals.data(); }
+
+	// Shader loop as written. Positions keep the w = 1 weighting of the shader (no renormalisation), normals
+	// go through the upper 3x3 of the same matrices and are normalised.
+	void SkinReference(const glm::mat4* palette, int boneCount, glm::vec3* positions, glm::vec3* normals) const
+	{
+		for (int v = 0; v < GetVertexCount(); v++)
+		{
+			glm::vec4 totalPosition(0.0f);
+			glm::vec3 totalNormal(0.0f);
+			for (int i = 0; i < MaxInfluences; i++)
+			{
+				int boneId = m_BoneIds[v][i];
+				if (boneId == -1)
+					continue;
+				if (boneId >= boneCount || boneId < 0)
+				{
+					totalPosition = glm::vec4(m_Positions[v], 1.0f);
+					totalNormal = m_Normals[v];
+					break;
+				}
+				totalPosition += palette[boneId] * glm::vec4(m_Positions[v], 1.0f) * m_Weights[v][i];
+				totalNormal += glm::mat3(palette[boneId]) * m_Normals[v] * m_Weights[v][i];
+			}
+			positions[v] = glm::vec3(totalPosition);
+			normals[v] = glm::dot(totalNormal, totalNormal) > 0.0f ? glm::normalize(totalNormal) : totalNormal;
+		}
+	}
+
+	// SkinReference's output up to float rounding (the matrices are blended before transforming rather than
+	// after). With a pool the vertices are split into chunks across its threads.
+	void Skin(const glm::mat4* palette, int boneCount, glm::vec3* positions, glm::vec3* normals, TaskPool* pool = nullptr)
+	{
+		Prepare(boneCount);
+		const int grainSize = 16384;
+		auto body = [&](int begin, int end, int) { SkinRange(palette, begin, end, positions, normals); };
+		if (pool)
+			pool->ParallelFor(GetVertexCount(), grainSize, body);
+		else
+			body(0, GetVertexCount(), 0);
+	}
+
+private:
+	// Skipped influences become weight 0 on bone 0 and bind-pose vertices are flagged with a negative first
+	// id, so the kernel only has one (rarely taken) branch per vertex. Redone when the palette size changes.
+	void Prepare(int boneCount)
+	{
+		if (boneCount == m_PreparedBoneCount)
+			return;
+		m_PreparedBoneCount = boneCount;
+		m_PreparedIds.resize(m_BoneIds.size());
+		m_PreparedWeights.resize(m_Weights.size());
+		for (size_t v = 0; v < m_BoneIds.size(); v++)
+		{
+			glm::ivec4 ids(0);
+			glm::vec4 weights(0.0f);
+			for (int i = 0; i < MaxInfluences; i++)
+			{
+				int boneId = m_BoneIds[v][i];
+				if (boneId == -1)
+					continue;
+				if (boneId >= boneCount || boneId < 0)
+				{
+					ids = glm::ivec4(-1);
+					break;
+				}
+				ids[i] = boneId;
+				weights[i] = m_Weights[v][i];
+			}
+			m_PreparedIds[v] = ids;
+			m_PreparedWeights[v] = weights;
+		}
+	}
+
+	void SkinRange(const glm::mat4* palette, int begin, int end, glm::vec3* positions, glm::vec3* normals) const
+	{
+		float result[4];
+		for (int v = begin; v < end; v++)
+		{
+			const glm::ivec4& ids = m_PreparedIds[v];
+			if (ids.x < 0)
+			{
+				positions[v] = m_Positions[v];
+				normals[v] = m_Normals[v];
+				continue;
+			}
+
+			// Blend the columns of the four matrices; the bind-pose transform below then happens once
+			const glm::vec4& weights = m_PreparedWeights[v];
+			SimdFloat4 columns[4];
+			for (int c = 0; c < 4; c++)
+				columns[c] = SimdFloat4::LoadUnaligned(&palette[ids.x][c][0]) * SimdFloat4::Set1(weights.x)
+					+ SimdFloat4::LoadUnaligned(&palette[ids.y][c][0]) * SimdFloat4::Set1(weights.y)
+					+ SimdFloat4::LoadUnaligned(&palette[ids.z][c][0]) * SimdFloat4::Set1(weights.z)
+					+ SimdFloat4::LoadUnaligned(&palette[ids.w][c][0]) * SimdFloat4::Set1(weights.w);
+
+			const glm::vec3& position = m_Positions[v];
+			const glm::vec3& normal = m_Normals[v];
+			SimdFloat4 rotated = columns[0] * SimdFloat4::Set1(position.x) + columns[1] * SimdFloat4::Set1(position.y)
+				+ columns[2] * SimdFloat4::Set1(position.z);
+			(rotated + columns[3]).StoreUnaligned(result);
+			positions[v] = glm::vec3(result[0], result[1], result[2]);
+
+			(columns[0] * SimdFloat4::Set1(normal.x) + columns[1] * SimdFloat4::Set1(normal.y)
+				+ columns[2] * SimdFloat4::Set1(normal.z)).StoreUnaligned(result);
+			glm::vec3 skinnedNormal(result[0], result[1], result[2]);
+			float lengthSquared = glm::dot(skinnedNormal, skinnedNormal);
+			normals[v] = lengthSquared > 0.0f ? skinnedNormal / std::sqrt(lengthSquared) : skinnedNormal;
+		}
+	}
+
+	std::vector<glm::vec3> m_Positions;
+	std::vector<glm::vec3> m_Normals;
+	std::vector<glm::ivec4> m_BoneIds;
+	std::vector<glm::vec4> m_Weights;
+
+	int m_PreparedBoneCount = -1;
+	std::vector<glm::ivec4> m_PreparedIds;
+	std::vector<glm::vec4> m_PreparedWeights;
+};
@@ -0,0 +1,230 @@
+#pragma once
+
+/* Animates many characters that share one skeleton and a set of clips. Clip and skeleton data is bound
+   up front and only read during Update, while everything that changes per character (clips in play,
+   times, key cursors) lives in per-instance arrays, so instances are evaluated in parallel without locks.
+   The palettes of all instances are written to one contiguous array. */
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+#include <learnopengl/animation.h>
+#include <learnopengl/animation_lod.h>
+#include <learnopengl/animator.h>
+#include <learnopengl/baked_clip.h>
+#include <learnopengl/bone.h>
+#include <learnopengl/bone_matrix.h>
+#include <learnopengl/skeleton.h>
+#include <learnopengl/task_pool.h>
+
+class CrowdAnimator
+{
+public:
+	// The skeleton is compiled from the given clip's hierarchy, like Animator does
+	explicit CrowdAnimator(Animation* animation)
+		: m_Skeleton(std::make_shared<const Skeleton>(animation))
+	{
+	}
+
+	explicit CrowdAnimator(std::shared_ptr<const Skeleton> skeleton)
+		: m_Skeleton(std::move(skeleton))
+	{
+	}
+
+	// Binds a clip to the skeleton and returns its handle; do this before the first Update
+	int AddClip(Animation* animation)
+	{
+		ClipData clip;
+		clip.tracks = m_Skeleton->BindAnimation(animation);
+		clip.ticksPerSecond = animation->GetTicksPerSecond();
+		clip.duration = animation->GetDuration();
+		m_Clips.push_back(std::move(clip));
+		return static_cast<int>(m_Clips.size()) - 1;
+	}
+
+	// Instances playing the clip on its own copy its baked palettes instead of sampling it, while baked
+	// playback is enabled. The BakedClip is only read, so one bake serves every instance.
+	void SetBakedClip(int clip, const BakedClip* bakedClip) { m_Clips[clip].baked = bakedClip; }
+	void SetBakedPlayback(BakedPlayback playback) { m_BakedPlayback = playback; }
+
+	int AddInstance(int clip, float startTime = 0.0f)
+	{
+		InstanceState instance;
+		instance.clip = clip;
+		instance.clip2 = -1;
+		instance.time = startTime;
+		instance.time2 = 0.0f;
+		instance.blend = 0.0f;
+		m_Instances.push_back(instance);
+
+		size_t nodeCount = m_Skeleton->GetNodes().size();
+		m_Cursors.resize(m_Instances.size() * nodeCount * 2);
+		m_Palettes.resize(m_Instances.size() * GetBoneCount(), BoneMatrix(1.0f));
+		return static_cast<int>(m_Instances.size()) - 1;
+	}
+
+	// Same meaning as Animator::PlayAnimation; pass -1 as clip2 to play a single clip
+	void PlayAnimation(int instance, int clip, int clip2, float time1, float time2, float blend)
+	{
+		InstanceState& state = m_Instances[instance];
+		state.clip = clip;
+		state.clip2 = clip2;
+		state.time = time1;
+		state.time2 = time2;
+		state.blend = blend;
+	}
+
+	// Advances and evaluates every instance, spreading them over the pool's threads
+	void Update(float dt, TaskPool& pool, int grainSize = 16)
+	{
+		if (static_cast<int>(m_Scratch.size()) < pool.GetThreadCount())
+			m_Scratch.resize(pool.GetThreadCount(), std::vector<glm::mat4>(m_Skeleton->GetNodes().size()));
+
+		pool.ParallelFor(static_cast<int>(m_Instances.size()), grainSize, [this, dt](int begin, int end, int threadIndex)
+		{
+			std::vector<glm::mat4>& globalTransforms = m_Scratch[threadIndex];
+			for (int instance = begin; instance < end; instance++)
+				UpdateInstance(instance, dt, GetPalette(instance), globalTransforms);
+		});
+	}
+
+	// Like Update, but only the instances the scheduler picked this frame are evaluated, each advancing by
+	// the time since its own last evaluation. The others get a palette derived from their last two
+	// evaluations. Call lod.SetView for every instance before this.
+	void Update(float dt, TaskPool& pool, AnimationLodScheduler& lod, int grainSize = 16)
+	{
+		if (static_cast<int>(m_Scratch.size()) < pool.GetThreadCount())
+			m_Scratch.resize(pool.GetThreadCount(), std::vector<glm::mat4>(m_Skeleton->GetNodes().size()));
+		if (m_KeyPalettes.size() != m_Palettes.size() * 2)
+			m_KeyPalettes.resize(m_Palettes.size() * 2, BoneMatrix(1.0f));
+		lod.Resize(GetInstanceCount());
+		lod.Schedule(dt, m_Skeleton->GetNodeCount());
+
+		pool.ParallelFor(static_cast<int>(m_Instances.size()), grainSize, [this, &lod](int begin, int end, int threadIndex)
+		{
+			std::vector<glm::mat4>& globalTransforms = m_Scratch[threadIndex];
+			int boneCount = GetBoneCount();
+			for (int instance = begin; instance < end; instance++)
+			{
+				BoneMatrix* previous = &m_KeyPalettes[static_cast<size_t>(instance) * 2 * boneCount];
+				BoneMatrix* latest = previous + boneCount;
+				if (lod.IsScheduled(instance))
+				{
+					std::copy(latest, latest + boneCount, previous);
+					UpdateInstance(instance, lod.GetAdvance(instance), latest, globalTransforms);
+					// rather than the bind pose, until there's a second evaluation to move between
+					if (lod.IsFirstEvaluation(instance))
+						std::copy(latest, latest + boneCount, previous);
+				}
+
+				float factor;
+				LodInBetween inBetween = lod.GetInBetween(instance, factor);
+				BoneMatrix* palette = GetPalette(instance);
+				for (int bone = 0; bone < boneCount; bone++)
+				{
+					if (inBetween == LodInBetween::Interpolate)
+						palette[bone] = previous[bone] + (latest[bone] - previous[bone]) * factor;
+					else if (inBetween == LodInBetween::Extrapolate)
+						palette[bone] = latest[bone] + (latest[bone] - previous[bone]) * factor;
+					else
+						palette[bone] = latest[bone];
+				}
+			}
+		});
+	}
+
+	int GetInstanceCount() const { return static_cast<int>(m_Instances.size()); }
+	int GetBoneCount() const { return m_Skeleton->GetBoneCount(); }
+	const Skeleton& GetSkeleton() const { return *m_Skeleton; }
+
+	// Bytes of per-instance state (clips, times, key cursors, palettes); skeleton and clips are shared
+	size_t GetInstanceMemorySize() const
+	{
+		size_t palettes = m_KeyPalettes.empty() ? 1 : 3; // the LOD path keeps its last two evaluations too
+		return sizeof(InstanceState) + 2 * m_Skeleton->GetNodes().size() * sizeof(BoneCursor) + palettes * GetBoneCount() * sizeof(BoneMatrix);
+	}
+
+	// GetBoneCount() affine matrices (see bone_matrix.h) per instance, instances back to back
+	const std::vector<BoneMatrix>& GetPalettes() const { return m_Palettes; }
+	const BoneMatrix* GetPalette(int instance) const { return &m_Palettes[static_cast<size_t>(instance) * GetBoneCount()]; }
+	BoneMatrix* GetPalette(int instance) { return &m_Palettes[static_cast<size_t>(instance) * GetBoneCount()]; }
+
+private:
+	// Read-only once Update starts
+	struct ClipData
+	{
+		std::vector<Bone*> tracks;
+		float ticksPerSecond;
+		float duration;
+		const BakedClip* baked = nullptr;
+	};
+
+	struct InstanceState
+	{
+		int clip;
+		int clip2;
+		float time;
+		float time2;
+		float blend;
+	};
+
+	void UpdateInstance(int instance, float dt, BoneMatrix* palette, std::vector<glm::mat4>& globalTransforms)
+	{
+		InstanceState& state = m_Instances[instance];
+		const ClipData& clip1 = m_Clips[state.clip];
+		state.time = fmod(state.time + clip1.ticksPerSecond * dt, clip1.duration);
+
+		const ClipData* clip2 = nullptr;
+		if (state.clip2 >= 0)
+		{
+			const ClipData& secondary = m_Clips[state.clip2];
+			state.time2 = fmod(state.time2 + secondary.ticksPerSecond * dt, secondary.duration);
+			if (state.blend > 0.0f)
+				clip2 = &secondary;
+		}
+
+		if (!clip2 && clip1.baked && m_BakedPlayback != BakedPlayback::Disabled)
+		{
+			clip1.baked->Sample(state.time, m_BakedPlayback, palette);
+			return;
+		}
+
+		const std::vector<SkeletonNode>& nodes = m_Skeleton->GetNodes();
+		BoneCursor* cursors1 = &m_Cursors[static_cast<size_t>(instance) * nodes.size() * 2];
+		BoneCursor* cursors2 = cursors1 + nodes.size();
+
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			const SkeletonNode& node = nodes[i];
+			glm::mat4 nodeTransform = node.transformation;
+
+			const Bone* bone1 = clip1.tracks[i];
+			const Bone* bone2 = clip2 ? clip2->tracks[i] : nullptr;
+			if (bone1 && bone2)
+			{
+				nodeTransform = Animator::BlendTransforms(
+					bone1->GetInterpolatedPosition(state.time, cursors1[i]), bone1->GetInterpolatedRotation(state.time, cursors1[i]), bone1->GetInterpolatedScaling(state.time, cursors1[i]),
+					bone2->GetInterpolatedPosition(state.time2, cursors2[i]), bone2->GetInterpolatedRotation(state.time2, cursors2[i]), bone2->GetInterpolatedScaling(state.time2, cursors2[i]),
+					state.blend);
+			}
+			else if (bone1)
+				nodeTransform = bone1->GetAnimatedTransform(state.time, cursors1[i]);
+
+			globalTransforms[i] = node.parent < 0 ? nodeTransform : globalTransforms[node.parent] * nodeTransform;
+
+			if (node.boneIndex >= 0)
+				palette[node.boneIndex] = ToBoneMatrix(globalTransforms[i] * node.offset);
+		}
+	}
+
+	std::shared_ptr<const Skeleton> m_Skeleton;
+	std::vector<ClipData> m_Clips;
+	BakedPlayback m_BakedPlayback = BakedPlayback::Disabled;
+
+	std::vector<InstanceState> m_Instances;
+	std::vector<BoneCursor> m_Cursors;                 // two slots (primary, secondary clip) of one cursor per node, per instance
+	std::vector<BoneMatrix> m_Palettes;
+	std::vector<BoneMatrix> m_KeyPalettes;             // previous and latest evaluated palette per instance, for LOD updates
+	std::vector<std::vector<glm::mat4>> m_Scratch;     // global transforms, one buffer per pool thread
+};
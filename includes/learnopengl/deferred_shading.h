@@ -0,0 +1,271 @@
+#pragma once
+
+/* Deferred shading: the scene is drawn once into a G-buffer, then lit light by light from what it holds, so a
+   fragment hidden behind another is never lit and a light only costs the pixels it reaches. The G-buffer is
+   12 bytes a pixel:
+   - albedo and specular strength, RGBA8;
+   - the world-space normal folded onto an octahedron, two 16 bit components;
+   - depth, 24 bits (with 8 of stencil so it blits to a default framebuffer's), from which the light pass
+     rebuilds each pixel's position with the inverse view-projection instead of storing it.
+   The light pass draws a full-screen triangle for the lights reaching every pixel and, for point lights, one
+   instanced sphere each, of the radius they were culled with (ClusteredPointLight). Its back faces are drawn
+   where they lie behind the scene, which still works with the camera inside the sphere, and the lights add up
+   with blending. */
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/light_clusters.h>
+#include <learnopengl/shader_m.h>
+
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+class DeferredShading
+{
+public:
+	static const size_t BytesPerPixel = 4 + 4 + 4;
+
+	// The light shaders' samplers go on three consecutive units from firstTextureUnit
+	explicit DeferredShading(int firstTextureUnit = 7)
+		: m_FirstTextureUnit(firstTextureUnit)
+	{
+		glGenFramebuffers(1, &m_FBO);
+		glGenTextures(3, m_Textures);
+		glGenVertexArrays(1, &m_FullScreenVAO);
+		BuildLightVolume();
+	}
+
+	~DeferredShading()
+	{
+		glDeleteVertexArrays(1, &m_FullScreenVAO);
+		glDeleteVertexArrays(1, &m_VolumeVAO);
+		glDeleteBuffers(1, &m_VolumeVBO);
+		glDeleteBuffers(1, &m_VolumeEBO);
+		glDeleteBuffers(1, &m_InstanceVBO);
+		glDeleteTextures(3, m_Textures);
+		glDeleteFramebuffers(1, &m_FBO);
+	}
+
+	DeferredShading(const DeferredShading&) = delete;
+	DeferredShading& operator=(const DeferredShading&) = delete;
+
+	// (Re)allocates the G-buffer when the size changed; call with the framebuffer's size each frame
+	void Resize(int width, int height)
+	{
+		if (width == m_Width && height == m_Height)
+			return;
+		m_Width = width;
+		m_Height = height;
+		GLint previousTexture, previousFramebuffer;
+		glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+		glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+		const GLenum internalFormats[3] = { GL_RGBA8, GL_RG16, GL_DEPTH24_STENCIL8 };
+		const GLenum formats[3] = { GL_RGBA, GL_RG, GL_DEPTH_STENCIL };
+		const GLenum types[3] = { GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT, GL_UNSIGNED_INT_24_8 };
+		for (int i = 0; i < 3; i++)
+		{
+			glBindTexture(GL_TEXTURE_2D, m_Textures[i]);
+			glTexImage2D(GL_TEXTURE_2D, 0, internalFormats[i], width, height, 0, formats[i], types[i], NULL);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+		glBindTexture(GL_TEXTURE_2D, previousTexture);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, m_FBO);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_Textures[0], 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_Textures[1], 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, m_Textures[2], 0);
+		const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glDrawBuffers(2, drawBuffers);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cout << "ERROR::DEFERRED_SHADING:: G-buffer framebuffer is not complete" << std::endl;
+		glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+	}
+
+	// Binds and clears the G-buffer for the geometry pass; the background keeps a depth of 1
+	void BeginGeometryPass() const
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, m_FBO);
+		glViewport(0, 0, m_Width, m_Height);
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	}
+
+	// Points a light shader's samplers at this object's texture units; needed once per program
+	void BindShader(const Shader& shader) const
+	{
+		shader.use();
+		shader.setInt("gAlbedoSpecular", m_FirstTextureUnit);
+		shader.setInt("gNormal", m_FirstTextureUnit + 1);
+		shader.setInt("gDepth", m_FirstTextureUnit + 2);
+	}
+
+	// Binds the G-buffer's textures to their units, after the geometry pass and before the light pass
+	void Bind() const
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			glActiveTexture(GL_TEXTURE0 + m_FirstTextureUnit + i);
+			glBindTexture(GL_TEXTURE_2D, m_Textures[i]);
+		}
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	// A triangle covering the viewport, for the shader in use; its vertex shader places the corners from
+	// gl_VertexID. Depth isn't tested, so the shader should discard the background itself.
+	void DrawFullScreen() const
+	{
+		GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+		glDisable(GL_DEPTH_TEST);
+		glBindVertexArray(m_FullScreenVAO);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glBindVertexArray(0);
+		if (depthTest)
+			glEnable(GL_DEPTH_TEST);
+	}
+
+	/* One sphere per light, for the shader in use, added onto what is in the framebuffer: the instance
+	   attributes 1 to 3 are the light's three vec4s. The framebuffer must hold the G-buffer's depth
+	   (CopyDepth), which the spheres are tested against. */
+	void DrawPointLights(const ClusteredPointLight* lights, int count)
+	{
+		if (count <= 0)
+			return;
+		glBindBuffer(GL_ARRAY_BUFFER, m_InstanceVBO);
+		glBufferData(GL_ARRAY_BUFFER, static_cast<size_t>(count) * sizeof(ClusteredPointLight), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<size_t>(count) * sizeof(ClusteredPointLight), lights);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+		GLboolean cullFace = glIsEnabled(GL_CULL_FACE);
+		glEnable(GL_DEPTH_TEST);
+		glDepthFunc(GL_GEQUAL);
+		glDepthMask(GL_FALSE);
+		// spheres reaching past the far plane are flattened onto it rather than cut open
+		glEnable(GL_DEPTH_CLAMP);
+		glEnable(GL_CULL_FACE);
+		glCullFace(GL_FRONT);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE);
+
+		glBindVertexArray(m_VolumeVAO);
+		glDrawElementsInstanced(GL_TRIANGLES, m_VolumeIndexCount, GL_UNSIGNED_SHORT, 0, count);
+		glBindVertexArray(0);
+
+		glDisable(GL_BLEND);
+		glCullFace(GL_BACK);
+		if (!cullFace)
+			glDisable(GL_CULL_FACE);
+		glDisable(GL_DEPTH_CLAMP);
+		glDepthMask(GL_TRUE);
+		glDepthFunc(GL_LESS);
+		if (!depthTest)
+			glDisable(GL_DEPTH_TEST);
+	}
+
+	void DrawPointLights(const std::vector<ClusteredPointLight>& lights)
+	{
+		DrawPointLights(lights.data(), static_cast<int>(lights.size()));
+	}
+
+	// Copies the G-buffer's depth into framebuffer (0 for the window's, whose depth must be 24 bits with 8 of
+	// stencil), for the light volumes and for whatever is drawn forward after the light pass
+	void CopyDepth(unsigned int framebuffer) const
+	{
+		GLint previousFramebuffer;
+		glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, m_FBO);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+		glBlitFramebuffer(0, 0, m_Width, m_Height, 0, 0, m_Width, m_Height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+	}
+
+	unsigned int GetFramebuffer() const { return m_FBO; }
+	int GetWidth() const { return m_Width; }
+	int GetHeight() const { return m_Height; }
+
+private:
+	// An icosahedron split once into 80 triangles, pushed out so its faces stay outside the unit sphere
+	void BuildLightVolume()
+	{
+		const float t = (1.0f + std::sqrt(5.0f)) / 2.0f;
+		std::vector<glm::vec3> vertices = {
+			{ -1, t, 0 }, { 1, t, 0 }, { -1, -t, 0 }, { 1, -t, 0 },
+			{ 0, -1, t }, { 0, 1, t }, { 0, -1, -t }, { 0, 1, -t },
+			{ t, 0, -1 }, { t, 0, 1 }, { -t, 0, -1 }, { -t, 0, 1 }
+		};
+		const unsigned short icosahedron[] = {
+			0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11, 1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+			3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9, 4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1
+		};
+		for (glm::vec3& vertex : vertices)
+			vertex = glm::normalize(vertex);
+
+		std::vector<unsigned short> indices;
+		auto midpoint = [&vertices](unsigned short a, unsigned short b)
+		{
+			vertices.push_back(glm::normalize(vertices[a] + vertices[b]));
+			return static_cast<unsigned short>(vertices.size() - 1);
+		};
+		for (size_t i = 0; i < sizeof(icosahedron) / sizeof(icosahedron[0]); i += 3)
+		{
+			// shared edges get their midpoint twice, which only costs a few vertices
+			unsigned short a = icosahedron[i], b = icosahedron[i + 1], c = icosahedron[i + 2];
+			unsigned short ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+			const unsigned short split[] = { a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca };
+			indices.insert(indices.end(), split, split + 12);
+		}
+
+		// the vertices are on the sphere, so its faces cut inside it: scale by the nearest face's distance
+		float nearest = 1.0f;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			const glm::vec3& a = vertices[indices[i]];
+			glm::vec3 normal = glm::normalize(glm::cross(vertices[indices[i + 1]] - a, vertices[indices[i + 2]] - a));
+			nearest = glm::min(nearest, std::abs(glm::dot(normal, a)));
+		}
+		for (glm::vec3& vertex : vertices)
+			vertex /= nearest;
+		m_VolumeIndexCount = static_cast<int>(indices.size());
+
+		glGenVertexArrays(1, &m_VolumeVAO);
+		glGenBuffers(1, &m_VolumeVBO);
+		glGenBuffers(1, &m_VolumeEBO);
+		glGenBuffers(1, &m_InstanceVBO);
+		glBindVertexArray(m_VolumeVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, m_VolumeVBO);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_VolumeEBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), indices.data(), GL_STATIC_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+
+		glBindBuffer(GL_ARRAY_BUFFER, m_InstanceVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(ClusteredPointLight), NULL, GL_STREAM_DRAW);
+		for (int i = 0; i < 3; i++)
+		{
+			glEnableVertexAttribArray(1 + i);
+			glVertexAttribPointer(1 + i, 4, GL_FLOAT, GL_FALSE, sizeof(ClusteredPointLight), (void*)(i * sizeof(glm::vec4)));
+			glVertexAttribDivisor(1 + i, 1);
+		}
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	int m_FirstTextureUnit;
+	int m_Width = 0;
+	int m_Height = 0;
+	unsigned int m_FBO = 0;
+	unsigned int m_Textures[3] = {}; // albedo and specular, normal, depth
+	unsigned int m_FullScreenVAO = 0;
+	unsigned int m_VolumeVAO = 0;
+	unsigned int m_VolumeVBO = 0;
+	unsigned int m_VolumeEBO = 0;
+	unsigned int m_InstanceVBO = 0;
+	int m_VolumeIndexCount = 0;
+};
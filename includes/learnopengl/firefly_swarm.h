@@ -0,0 +1,221 @@
+#pragma once
+
+/* Fireflies circling a common centre, kept as a structure of arrays so SimdFloat::Width of them move per
+   instruction. Update advances every orbit on the task pool and writes the new positions both to the arrays
+   (for whatever reads them on the CPU, such as the lights) and straight into the mapped instance buffer, which
+   holds them planar too: all x, then all y, then all z, each array a float attribute of its own. Colors don't
+   change as the swarm moves, so they sit in a second buffer that is only uploaded after Set. Every firefly is
+   then drawn with one instanced call. */
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <learnopengl/simd.h>
+#include <learnopengl/task_pool.h>
+
+#include <cmath>
+#include <vector>
+
+class FireflySwarm
+{
+public:
+	enum Component
+	{
+		POSITION_X = 0,
+		POSITION_Y,
+		POSITION_Z,
+		ORBIT_RADIUS,
+		ORBIT_SPEED,
+		ORBIT_ANGLE,
+		COLOR_R,
+		COLOR_G,
+		COLOR_B,
+		COMPONENT_COUNT
+	};
+
+	// Fireflies per task: enough that a chunk takes a few tens of microseconds
+	static const int GrainSize = 16384;
+
+	FireflySwarm()
+	{
+		glGenBuffers(1, &m_PositionVBO);
+		glGenBuffers(1, &m_ColorVBO);
+	}
+
+	~FireflySwarm()
+	{
+		glDeleteBuffers(1, &m_PositionVBO);
+		glDeleteBuffers(1, &m_ColorVBO);
+	}
+
+	FireflySwarm(const FireflySwarm&) = delete;
+	FireflySwarm& operator=(const FireflySwarm&) = delete;
+
+	// Makes room for count fireflies, all zeroed (so sitting still on the centre) until Set
+	void Resize(int count)
+	{
+		m_Count = count;
+		m_Capacity = SimdPad(glm::max(count, 1));
+		m_Storage.Resize(sizeof(float) * m_Capacity * COMPONENT_COUNT);
+		m_ColorsDirty = true;
+	}
+
+	// orbitAngle in radians, orbitSpeed in radians a second
+	void Set(int index, float orbitRadius, float orbitSpeed, float orbitAngle, const glm::vec3& color)
+	{
+		Data(ORBIT_RADIUS)[index] = orbitRadius;
+		Data(ORBIT_SPEED)[index] = orbitSpeed;
+		Data(ORBIT_ANGLE)[index] = WrapAngle(orbitAngle);
+		Data(COLOR_R)[index] = color.x;
+		Data(COLOR_G)[index] = color.y;
+		Data(COLOR_B)[index] = color.z;
+		m_ColorsDirty = true;
+	}
+
+	// Adds the instance attributes to a VAO holding the cube: x, y and z of the position as three floats at
+	// location to location + 2, then the color. Call again after Resize, as the arrays move with the capacity.
+	void AttachInstanceAttributes(unsigned int VAO, unsigned int location = 1)
+	{
+		m_VAO = VAO;
+		m_Location = location;
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, m_PositionVBO);
+		for (unsigned int axis = 0; axis < 3; axis++)
+			AttachAttribute(location + axis, 1, axis * m_Capacity * sizeof(float));
+		glBindBuffer(GL_ARRAY_BUFFER, m_ColorVBO);
+		AttachAttribute(location + 3, 3, 0);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		m_AttachedCapacity = m_Capacity;
+	}
+
+	/* Moves every firefly deltaTime seconds along its orbit about center (on pool if given) and streams the
+	   positions to the GPU. Each circles in the xz plane while bobbing up and down at half the orbit's rate:
+	   center + (cos(angle) * radius, sin(angle / 2) * 0.3, sin(angle) * radius). */
+	void Update(float deltaTime, const glm::vec3& center, TaskPool* pool = nullptr)
+	{
+		if (m_AttachedCapacity != m_Capacity && m_VAO != 0)
+			AttachInstanceAttributes(m_VAO, m_Location);
+		if (m_ColorsDirty)
+			UploadColors();
+
+		// Orphaned first, like UniformBuffer::Upload, so mapping never waits on last frame's draw
+		size_t bytes = sizeof(float) * m_Capacity * 3;
+		glBindBuffer(GL_ARRAY_BUFFER, m_PositionVBO);
+		glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+		float* mapped = static_cast<float*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+
+		int blockCount = m_Capacity / SimdFloat::Width;
+		int grainBlocks = glm::max(GrainSize / SimdFloat::Width, 1);
+		auto body = [&](int begin, int end, int)
+		{
+			UpdateBlocks(begin * SimdFloat::Width, end * SimdFloat::Width, deltaTime, center, mapped);
+		};
+		if (pool)
+			pool->ParallelFor(blockCount, grainBlocks, body);
+		else
+			body(0, blockCount, 0);
+
+		// Unmap can fail if the storage was lost (a mode switch, say); the arrays are fine, so just redo the
+		// upload from them
+		if (mapped == NULL || glUnmapBuffer(GL_ARRAY_BUFFER) == GL_FALSE)
+			glBufferData(GL_ARRAY_BUFFER, bytes, Data(POSITION_X), GL_STREAM_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// Draws vertexCount vertices of the cube in VAO once per firefly
+	void Draw(unsigned int VAO, int vertexCount) const
+	{
+		if (m_Count == 0)
+			return;
+		glBindVertexArray(VAO);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, vertexCount, m_Count);
+	}
+
+	float* Data(int component) { return m_Storage.As<float>() + component * m_Capacity; }
+	const float* Data(int component) const { return m_Storage.As<float>() + component * m_Capacity; }
+
+	glm::vec3 GetPosition(int index) const { return glm::vec3(Data(POSITION_X)[index], Data(POSITION_Y)[index], Data(POSITION_Z)[index]); }
+	glm::vec3 GetColor(int index) const { return glm::vec3(Data(COLOR_R)[index], Data(COLOR_G)[index], Data(COLOR_B)[index]); }
+	int GetCount() const { return m_Count; }
+
+private:
+	AlignedBuffer m_Storage;
+	int m_Count = 0;
+	int m_Capacity = 0;
+	unsigned int m_PositionVBO = 0;
+	unsigned int m_ColorVBO = 0;
+	unsigned int m_VAO = 0;
+	unsigned int m_Location = 1;
+	int m_AttachedCapacity = 0;
+	bool m_ColorsDirty = false;
+
+	// sin(angle / 2) repeats every 4 pi, so angles are kept in [0, 4 pi) to hold on to float precision
+	static float WrapAngle(float angle)
+	{
+		const float period = 4.0f * glm::pi<float>();
+		float wrapped = std::fmod(angle, period);
+		return wrapped < 0.0f ? wrapped + period : wrapped;
+	}
+
+	void UpdateBlocks(int begin, int end, float deltaTime, const glm::vec3& center, float* mapped)
+	{
+		const SimdFloat dt = SimdFloat::Set1(deltaTime);
+		const SimdFloat period = SimdFloat::Set1(4.0f * glm::pi<float>());
+		const SimdFloat inversePeriod = SimdFloat::Set1(1.0f / (4.0f * glm::pi<float>()));
+		const SimdFloat half = SimdFloat::Set1(0.5f);
+		const SimdFloat bob = SimdFloat::Set1(0.3f);
+		const SimdFloat centerX = SimdFloat::Set1(center.x);
+		const SimdFloat centerY = SimdFloat::Set1(center.y);
+		const SimdFloat centerZ = SimdFloat::Set1(center.z);
+		float* x = Data(POSITION_X);
+		float* y = Data(POSITION_Y);
+		float* z = Data(POSITION_Z);
+		const float* radius = Data(ORBIT_RADIUS);
+		const float* speed = Data(ORBIT_SPEED);
+		float* angle = Data(ORBIT_ANGLE);
+
+		for (int i = begin; i < end; i += SimdFloat::Width)
+		{
+			SimdFloat a = SimdFloat::Load(angle + i) + SimdFloat::Load(speed + i) * dt;
+			a = a - period * SimdFloor(a * inversePeriod);
+			a.Store(angle + i);
+
+			SimdFloat sine, cosine, halfSine, halfCosine;
+			SimdSinCos(a, sine, cosine);
+			SimdSinCos(a * half, halfSine, halfCosine);
+			SimdFloat r = SimdFloat::Load(radius + i);
+			SimdFloat px = centerX + cosine * r;
+			SimdFloat py = centerY + halfSine * bob;
+			SimdFloat pz = centerZ + sine * r;
+
+			px.Store(x + i);
+			py.Store(y + i);
+			pz.Store(z + i);
+			if (mapped)
+			{
+				px.StoreUnaligned(mapped + i);
+				py.StoreUnaligned(mapped + m_Capacity + i);
+				pz.StoreUnaligned(mapped + 2 * m_Capacity + i);
+			}
+		}
+	}
+
+	void UploadColors()
+	{
+		std::vector<glm::vec3> colors(m_Count);
+		for (int i = 0; i < m_Count; i++)
+			colors[i] = GetColor(i);
+		glBindBuffer(GL_ARRAY_BUFFER, m_ColorVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * m_Count, colors.data(), GL_STATIC_DRAW);
+		m_ColorsDirty = false;
+	}
+
+	static void AttachAttribute(unsigned int location, int size, size_t offset)
+	{
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, size * sizeof(float), (void*)offset);
+		glVertexAttribDivisor(location, 1);
+	}
+};
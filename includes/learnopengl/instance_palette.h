@@ -0,0 +1,147 @@
+#pragma once
+
+/* Matrices of a whole crowd in one texture buffer, read by the instanced path of anim_model.vs: per instance
+   its model matrix followed by its bone matrices, each matrix the three RGBA32F texels of a mat3x4 (see
+   bone_matrix.h), so instance gl_InstanceID starts at gl_InstanceID * (bones + 1) matrices. Each mesh is then drawn once for every instance with
+   glDrawElementsInstanced instead of once per character with its own palette upload. Texture buffers are
+   core in GL 3.1, so this stays within the 3.3 the demos target (SSBOs need 4.3). */
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/bone_matrix.h>
+#include <learnopengl/shader_m.h>
+
+#include <string>
+#include <vector>
+
+class InstancePaletteBuffer
+{
+public:
+	// textureUnit should be one the meshes' own textures never use
+	explicit InstancePaletteBuffer(int textureUnit = 15)
+		: m_TextureUnit(textureUnit)
+	{
+		glGenBuffers(1, &m_TBO);
+		glBindBuffer(GL_TEXTURE_BUFFER, m_TBO);
+		glBufferData(GL_TEXTURE_BUFFER, sizeof(BoneMatrix), NULL, GL_STREAM_DRAW);
+		glGenTextures(1, &m_Texture);
+		glBindTexture(GL_TEXTURE_BUFFER, m_Texture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_TBO);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		// GL 3.3 only guarantees 65536 texels, a few hundred characters; real drivers allow far more
+		GLint maxTexels = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+		m_MaxMatrices = glm::max(maxTexels / 3, 1);
+	}
+
+	~InstancePaletteBuffer()
+	{
+		glDeleteTextures(1, &m_Texture);
+		glDeleteBuffers(1, &m_TBO);
+	}
+
+	InstancePaletteBuffer(const InstancePaletteBuffer&) = delete;
+	InstancePaletteBuffer& operator=(const InstancePaletteBuffer&) = delete;
+
+	// Points the shader's samplerBuffer at this buffer's texture unit. Needed even when the shader only
+	// draws single characters, since an unset sampler would share unit 0 with the diffuse texture.
+	void BindShader(const Shader& shader, const std::string& samplerName = "instanceMatrices") const
+	{
+		shader.use();
+		shader.setInt(samplerName, m_TextureUnit);
+	}
+
+	// Packs a model matrix (which must be affine too) and boneCount bone matrices per instance; palettes are
+	// back to back, as CrowdAnimator::GetPalettes keeps them. Nothing reaches the GPU until Draw.
+	void SetInstances(const glm::mat4* models, const BoneMatrix* palettes, int instanceCount, int boneCount)
+	{
+		m_InstanceCount = instanceCount;
+		m_Stride = boneCount + 1;
+		m_Matrices.resize(static_cast<size_t>(instanceCount) * m_Stride);
+		for (int i = 0; i < instanceCount; i++)
+		{
+			BoneMatrix* instance = &m_Matrices[static_cast<size_t>(i) * m_Stride];
+			instance[0] = ToBoneMatrix(models[i]);
+			for (int bone = 0; bone < boneCount; bone++)
+				instance[1 + bone] = palettes[static_cast<size_t>(i) * boneCount + bone];
+		}
+	}
+
+	// Draws every instance of every mesh of model (mesh.h's Mesh, with public VAO, indices and textures)
+	// and returns the number of draw calls: one per mesh, times the batches needed when the instances
+	// don't fit the texture buffer at once. Each batch is uploaded in one buffer update, orphaning the old
+	// storage like BonePaletteBuffer does.
+	template <typename ModelType>
+	int Draw(ModelType& model, const Shader& shader)
+	{
+		if (m_InstanceCount == 0)
+			return 0;
+		shader.use();
+		shader.setBool("instanced", true);
+		shader.setInt("instanceStride", m_Stride);
+
+		int drawCalls = 0;
+		int batchSize = glm::max(m_MaxMatrices / m_Stride, 1);
+		for (int first = 0; first < m_InstanceCount; first += batchSize)
+		{
+			int count = glm::min(batchSize, m_InstanceCount - first);
+			glBindBuffer(GL_TEXTURE_BUFFER, m_TBO);
+			glBufferData(GL_TEXTURE_BUFFER, static_cast<size_t>(count) * m_Stride * sizeof(BoneMatrix), NULL, GL_STREAM_DRAW);
+			glBufferSubData(GL_TEXTURE_BUFFER, 0, static_cast<size_t>(count) * m_Stride * sizeof(BoneMatrix), &m_Matrices[static_cast<size_t>(first) * m_Stride]);
+			glBindBuffer(GL_TEXTURE_BUFFER, 0);
+			glActiveTexture(GL_TEXTURE0 + m_TextureUnit);
+			glBindTexture(GL_TEXTURE_BUFFER, m_Texture);
+
+			for (auto& mesh : model.meshes)
+			{
+				BindMeshTextures(mesh, shader);
+				glBindVertexArray(mesh.VAO);
+				glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(mesh.indices.size()), GL_UNSIGNED_INT, 0, count);
+				drawCalls++;
+			}
+		}
+		glBindVertexArray(0);
+		glActiveTexture(GL_TEXTURE0);
+		shader.setBool("instanced", false);
+		return drawCalls;
+	}
+
+	int GetInstanceCount() const { return m_InstanceCount; }
+
+private:
+	// Same texture naming as Mesh::Draw (texture_diffuse1, texture_specular1...)
+	template <typename MeshType>
+	static void BindMeshTextures(const MeshType& mesh, const Shader& shader)
+	{
+		unsigned int diffuseNr = 1;
+		unsigned int specularNr = 1;
+		unsigned int normalNr = 1;
+		unsigned int heightNr = 1;
+		for (unsigned int i = 0; i < mesh.textures.size(); i++)
+		{
+			glActiveTexture(GL_TEXTURE0 + i);
+			std::string name = mesh.textures[i].type;
+			std::string number;
+			if (name == "texture_diffuse")
+				number = std::to_string(diffuseNr++);
+			else if (name == "texture_specular")
+				number = std::to_string(specularNr++);
+			else if (name == "texture_normal")
+				number = std::to_string(normalNr++);
+			else if (name == "texture_height")
+				number = std::to_string(heightNr++);
+			glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
+			glBindTexture(GL_TEXTURE_2D, mesh.textures[i].id);
+		}
+	}
+
+	unsigned int m_TBO = 0;
+	unsigned int m_Texture = 0;
+	int m_TextureUnit;
+	int m_MaxMatrices = 1;
+	int m_InstanceCount = 0;
+	int m_Stride = 1;
+	std::vector<BoneMatrix> m_Matrices;
+};
@@ -0,0 +1,435 @@
+#pragma once
+
+/* Clustered forward lighting: the view frustum is cut into tilesX x tilesY screen tiles and depth slices spaced
+   logarithmically between the near and far planes, and every point light is listed in the clusters its
+   sphere of influence (radius from its attenuation, LightRadius) overlaps. A fragment then only walks the
+   lights of its own cluster, so its cost follows how many lights reach it rather than how many there are.
+
+   The lights are assigned on the CPU each frame, one depth slice per task: the slice first keeps the lights
+   whose depth range reaches it, each row of tiles keeps those of the slice that reach the row and each
+   cluster those of its row, every test being a sphere against the box around the cluster, SimdFloat::Width
+   lights at a time. Everything the shaders read is in three texture buffers (core in GL 3.1; SSBOs would need
+   4.3): the lights, each cluster's offset and count into the index list, and the index list itself. */
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader_m.h>
+#include <learnopengl/simd.h>
+#include <learnopengl/task_pool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A point light as the shaders read it, three RGBA32F texels
+struct ClusteredPointLight
+{
+	glm::vec3 position;
+	float radius;       // where it stops lighting anything, see LightClusters::LightRadius
+	glm::vec3 color;    // diffuse and specular
+	float ambient;      // ambient as a fraction of color
+	float constant;
+	float linear;
+	float quadratic;
+	float padding;
+};
+
+class LightClusters
+{
+public:
+	// The shaders' samplers go on three consecutive units from firstTextureUnit
+	LightClusters(int tilesX = 16, int tilesY = 16, int slices = 24, int firstTextureUnit = 4)
+		: m_TilesX(tilesX), m_TilesY(tilesY), m_Slices(slices), m_FirstTextureUnit(firstTextureUnit)
+	{
+		glGenBuffers(3, m_TBOs);
+		glGenTextures(3, m_Textures);
+		const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+		for (int i = 0; i < 3; i++)
+		{
+			glBindBuffer(GL_TEXTURE_BUFFER, m_TBOs[i]);
+			glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+			glBindTexture(GL_TEXTURE_BUFFER, m_Textures[i]);
+			glTexBuffer(GL_TEXTURE_BUFFER, formats[i], m_TBOs[i]);
+		}
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		// GL 3.3 only guarantees 65536 texels per buffer; real drivers allow far more
+		GLint maxTexels = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+		m_MaxTexels = static_cast<size_t>(std::max(maxTexels, 1));
+
+		m_Slice.resize(m_Slices);
+		m_Ranges.resize(static_cast<size_t>(GetClusterCount()) * 2);
+	}
+
+	~LightClusters()
+	{
+		glDeleteTextures(3, m_Textures);
+		glDeleteBuffers(3, m_TBOs);
+	}
+
+	LightClusters(const LightClusters&) = delete;
+	LightClusters& operator=(const LightClusters&) = delete;
+
+	/* Distance at which constant + linear d + quadratic d^2 has dimmed the brightest channel of color to
+	   threshold (5/256 by default, below what 8 bits per channel show). The shaders fade lights out towards
+	   it so nothing pops at cluster edges. */
+	static float LightRadius(const glm::vec3& color, float constant, float linear, float quadratic, float threshold = 5.0f / 256.0f)
+	{
+		float brightest = glm::max(glm::max(color.x, color.y), color.z);
+		if (quadratic <= 0.0f)
+			return linear > 0.0f ? glm::max((brightest / threshold - constant) / linear, 0.0f) : 1e30f;
+		float discriminant = linear * linear - 4.0f * quadratic * (constant - brightest / threshold);
+		return glm::max((-linear + std::sqrt(glm::max(discriminant, 0.0f))) / (2.0f * quadratic), 0.0f);
+	}
+
+	// Points the shaders' samplers at this object's texture units; needed once per program
+	void BindShader(const Shader& shader) const
+	{
+		shader.use();
+		shader.setInt("pointLightData", m_FirstTextureUnit);
+		shader.setInt("clusterRanges", m_FirstTextureUnit + 1);
+		shader.setInt("clusterLightIndices", m_FirstTextureUnit + 2);
+	}
+
+	/* Depth the first slice reaches; the others divide the rest of the frustum logarithmically. Slicing all
+	   the way from a near plane of 0.1 would spend half of them on the first few units in front of the camera,
+	   where there's rarely anything to light, and leave the distant slices so deep that a surface seen at a
+	   glancing angle crosses one with every light along the way in its list. 0 slices from the near plane. */
+	void SetNearSplit(float depth) { m_NearSplit = depth; }
+	float GetNearSplit() const { return m_NearSplit; }
+
+	/* Assigns the lights to the clusters of a perspective camera (view matrix, vertical field of view in
+	   radians, aspect ratio, near and far planes) and uploads all three buffers. pool, if given, takes a
+	   depth slice per task. */
+	void Update(const ClusteredPointLight* lights, int lightCount, const glm::mat4& view, float fovY, float aspect,
+		float nearPlane, float farPlane, TaskPool* pool = nullptr)
+	{
+		// every light texel must fit a texture buffer
+		lightCount = std::min(lightCount, static_cast<int>(m_MaxTexels / 3));
+		m_LightCount = lightCount;
+		m_Near = nearPlane;
+		m_Far = farPlane;
+		m_TanHalfY = std::tan(fovY * 0.5f);
+		m_TanHalfX = m_TanHalfY * aspect;
+
+		// the lights in view space, structure of arrays, depth positive in front of the camera
+		int padded = SimdPad(lightCount);
+		if (m_ViewLights.Size() < static_cast<size_t>(padded) * 4 * sizeof(float))
+			m_ViewLights.Resize(static_cast<size_t>(padded) * 4 * sizeof(float));
+		float* xs = m_ViewLights.As<float>();
+		float* ys = xs + padded;
+		float* depths = ys + padded;
+		float* radii = depths + padded;
+		for (int i = 0; i < padded; i++)
+		{
+			if (i < lightCount)
+			{
+				glm::vec4 position = view * glm::vec4(lights[i].position, 1.0f);
+				xs[i] = position.x;
+				ys[i] = position.y;
+				depths[i] = -position.z;
+				radii[i] = lights[i].radius;
+			}
+			else
+			{
+				// padding lanes sit behind the camera, where no slice reaches
+				xs[i] = ys[i] = radii[i] = 0.0f;
+				depths[i] = -1e30f;
+			}
+		}
+
+		int threadCount = pool ? pool->GetThreadCount() : 1;
+		if (static_cast<int>(m_Scratch.size()) < threadCount)
+			m_Scratch.resize(threadCount);
+		auto assignSlices = [&](int begin, int end, int thread)
+		{
+			for (int slice = begin; slice < end; slice++)
+				AssignSlice(slice, padded, m_Scratch[thread]);
+		};
+		if (pool)
+			pool->ParallelFor(m_Slices, 1, assignSlices);
+		else
+			assignSlices(0, m_Slices, 0);
+
+		// each slice's lists start where the previous slice's end; past the texture buffer's limit the
+		// remaining clusters lose their lights
+		m_Indices.clear();
+		m_DroppedCount = 0;
+		m_MaxClusterLights = 0;
+		m_OccupiedClusterCount = 0;
+		int clustersPerSlice = m_TilesX * m_TilesY;
+		for (int slice = 0; slice < m_Slices; slice++)
+		{
+			const SliceLists& lists = m_Slice[slice];
+			for (int cluster = 0; cluster < clustersPerSlice; cluster++)
+			{
+				uint32_t first = lists.offsets[cluster];
+				uint32_t count = lists.offsets[cluster + 1] - first;
+				uint32_t kept = static_cast<uint32_t>(std::min<size_t>(count, m_MaxTexels - m_Indices.size()));
+				size_t index = static_cast<size_t>(slice * clustersPerSlice + cluster) * 2;
+				m_Ranges[index] = static_cast<uint32_t>(m_Indices.size());
+				m_Ranges[index + 1] = kept;
+				m_Indices.insert(m_Indices.end(), lists.indices.begin() + first, lists.indices.begin() + first + kept);
+				m_DroppedCount += count - kept;
+				m_MaxClusterLights = std::max(m_MaxClusterLights, static_cast<int>(count));
+				m_OccupiedClusterCount += count > 0 ? 1 : 0;
+			}
+		}
+
+		Upload(0, lights, static_cast<size_t>(lightCount) * sizeof(ClusteredPointLight));
+		Upload(1, m_Ranges.data(), m_Ranges.size() * sizeof(uint32_t));
+		Upload(2, m_Indices.data(), m_Indices.size() * sizeof(uint32_t));
+	}
+
+	void Update(const std::vector<ClusteredPointLight>& lights, const glm::mat4& view, float fovY, float aspect,
+		float nearPlane, float farPlane, TaskPool* pool = nullptr)
+	{
+		Update(lights.data(), static_cast<int>(lights.size()), view, fovY, aspect, nearPlane, farPlane, pool);
+	}
+
+	// Binds the three buffers to their texture units, before drawing with the shaders
+	void Bind() const
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			glActiveTexture(GL_TEXTURE0 + m_FirstTextureUnit + i);
+			glBindTexture(GL_TEXTURE_BUFFER, m_Textures[i]);
+		}
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	/* What the shaders need to find a fragment's cluster: the grid size with the light count, and the near and
+	   far planes with the scale and bias taking the log of a view depth to its slice */
+	glm::ivec4 GetGridParameters() const { return glm::ivec4(m_TilesX, m_TilesY, m_Slices, m_LightCount); }
+	glm::vec4 GetDepthParameters() const
+	{
+		// depths short of the split come out below 1, which the shaders clamp to the first slice
+		int first = FirstLogSlice();
+		float split = LogSliceStart();
+		float scale = (m_Slices - first) / std::log(m_Far / split);
+		return glm::vec4(m_Near, m_Far, scale, first - std::log(split) * scale);
+	}
+	// Tiles per pixel, for a viewport of the given size
+	glm::vec4 GetTileParameters(int viewportWidth, int viewportHeight) const
+	{
+		return glm::vec4(static_cast<float>(m_TilesX) / viewportWidth, static_cast<float>(m_TilesY) / viewportHeight, 0.0f, 0.0f);
+	}
+
+	int GetClusterCount() const { return m_TilesX * m_TilesY * m_Slices; }
+	int GetLightCount() const { return m_LightCount; }
+	size_t GetIndexCount() const { return m_Indices.size(); }
+	int GetMaxClusterLights() const { return m_MaxClusterLights; }
+	// Clusters with at least one light, and the lights an average one of them holds: what a lit fragment pays,
+	// which stays about level however many lights there are as long as they spread out rather than pile up
+	int GetOccupiedClusterCount() const { return m_OccupiedClusterCount; }
+	float GetAverageClusterLights() const
+	{
+		return m_OccupiedClusterCount > 0 ? static_cast<float>(m_Indices.size() + m_DroppedCount) / m_OccupiedClusterCount : 0.0f;
+	}
+	// Light references left out because the index list outgrew the texture buffer
+	size_t GetDroppedCount() const { return m_DroppedCount; }
+
+private:
+	struct SliceLists
+	{
+		std::vector<uint32_t> offsets; // per cluster of the slice, and one past the last
+		std::vector<uint32_t> indices;
+	};
+
+	// Lights (indices and view-space spheres, structure of arrays) still in the running at one level
+	struct Candidates
+	{
+		AlignedBuffer spheres;
+		std::vector<uint32_t> indices;
+		int count = 0;
+
+		float* X() { return spheres.As<float>(); }
+		float* Y() { return X() + Capacity(); }
+		float* Depth() { return Y() + Capacity(); }
+		float* Radius() { return Depth() + Capacity(); }
+		int Capacity() const { return static_cast<int>(indices.size()); }
+
+		void Reserve(int capacity)
+		{
+			if (Capacity() >= capacity)
+				return;
+			spheres.Resize(static_cast<size_t>(capacity) * 4 * sizeof(float));
+			indices.resize(capacity);
+		}
+	};
+
+	struct Scratch
+	{
+		Candidates slice;
+		Candidates row;
+	};
+
+	// Keeps the lanes of from, SimdFloat::Width lights from first on, whose bits are set in mask
+	static void Keep(int mask, int first, const float* x, const float* y, const float* depth, const float* radius,
+		const uint32_t* indices, Candidates& to)
+	{
+		for (int lane = 0; mask != 0; lane++, mask >>= 1)
+		{
+			if (!(mask & 1))
+				continue;
+			int i = first + lane;
+			to.X()[to.count] = x[i];
+			to.Y()[to.count] = y[i];
+			to.Depth()[to.count] = depth[i];
+			to.Radius()[to.count] = radius[i];
+			to.indices[to.count] = indices ? indices[i] : static_cast<uint32_t>(i);
+			to.count++;
+		}
+	}
+
+	// Lanes of the spheres at index i whose squared distance to the box is below their squared radius
+	static int SpheresInBox(const float* x, const float* y, const float* depth, const float* radius, int i,
+		const glm::vec3& boxMin, const glm::vec3& boxMax)
+	{
+		SimdFloat zero = SimdFloat::Set1(0.0f);
+		SimdFloat cx = SimdFloat::Load(x + i);
+		SimdFloat cy = SimdFloat::Load(y + i);
+		SimdFloat cz = SimdFloat::Load(depth + i);
+		SimdFloat r = SimdFloat::Load(radius + i);
+		SimdFloat dx = SimdMax(SimdMax(SimdFloat::Set1(boxMin.x) - cx, cx - SimdFloat::Set1(boxMax.x)), zero);
+		SimdFloat dy = SimdMax(SimdMax(SimdFloat::Set1(boxMin.y) - cy, cy - SimdFloat::Set1(boxMax.y)), zero);
+		SimdFloat dz = SimdMax(SimdMax(SimdFloat::Set1(boxMin.z) - cz, cz - SimdFloat::Set1(boxMax.z)), zero);
+		return SimdMoveMask(SimdLess(dx * dx + dy * dy + dz * dz, r * r));
+	}
+
+	// Clears the padding lanes after count so they never pass a test
+	static void PadCandidates(Candidates& candidates)
+	{
+		for (int i = candidates.count; i < SimdPad(candidates.count); i++)
+		{
+			candidates.X()[i] = candidates.Y()[i] = candidates.Radius()[i] = 0.0f;
+			candidates.Depth()[i] = -1e30f;
+		}
+	}
+
+	// 1 if the first slice runs from the near plane to the split, 0 if there's no split inside the frustum
+	int FirstLogSlice() const { return m_NearSplit > m_Near && m_NearSplit < m_Far && m_Slices > 1 ? 1 : 0; }
+	float LogSliceStart() const { return FirstLogSlice() ? m_NearSplit : m_Near; }
+
+	float SliceDepth(int slice) const
+	{
+		int first = FirstLogSlice();
+		if (slice < first)
+			return m_Near;
+		float start = LogSliceStart();
+		return start * std::pow(m_Far / start, static_cast<float>(slice - first) / (m_Slices - first));
+	}
+
+	// View-space extent along one axis of tile (of tiles) across depths near to far, tanHalf being the half
+	// extent at depth 1
+	static void TileExtent(int tile, int tiles, float tanHalf, float nearDepth, float farDepth, float& low, float& high)
+	{
+		float from = (-1.0f + 2.0f * tile / tiles) * tanHalf;
+		float to = (-1.0f + 2.0f * (tile + 1) / tiles) * tanHalf;
+		low = glm::min(from * nearDepth, from * farDepth);
+		high = glm::max(to * nearDepth, to * farDepth);
+	}
+
+	void AssignSlice(int slice, int padded, Scratch& scratch)
+	{
+		float nearDepth = SliceDepth(slice);
+		float farDepth = SliceDepth(slice + 1);
+		const float* xs = m_ViewLights.As<float>();
+		const float* ys = xs + padded;
+		const float* depths = ys + padded;
+		const float* radii = depths + padded;
+
+		// the lights whose depth range overlaps the slice's
+		Candidates& inSlice = scratch.slice;
+		inSlice.Reserve(padded);
+		inSlice.count = 0;
+		SimdFloat sliceNear = SimdFloat::Set1(nearDepth);
+		SimdFloat sliceFar = SimdFloat::Set1(farDepth);
+		for (int i = 0; i < padded; i += SimdFloat::Width)
+		{
+			SimdFloat depth = SimdFloat::Load(depths + i);
+			SimdFloat radius = SimdFloat::Load(radii + i);
+			int mask = SimdMoveMask(SimdLess(depth - radius, sliceFar)) & SimdMoveMask(SimdLess(sliceNear, depth + radius));
+			if (mask)
+				Keep(mask, i, xs, ys, depths, radii, nullptr, inSlice);
+		}
+		PadCandidates(inSlice);
+
+		SliceLists& lists = m_Slice[slice];
+		lists.offsets.assign(static_cast<size_t>(m_TilesX) * m_TilesY + 1, 0);
+		lists.indices.clear();
+		Candidates& inRow = scratch.row;
+		inRow.Reserve(SimdPad(inSlice.count));
+		float sliceHalfWidth = m_TanHalfX * farDepth;
+		for (int tileY = 0; tileY < m_TilesY; tileY++)
+		{
+			glm::vec3 rowMin, rowMax;
+			TileExtent(tileY, m_TilesY, m_TanHalfY, nearDepth, farDepth, rowMin.y, rowMax.y);
+			rowMin.x = -sliceHalfWidth;
+			rowMax.x = sliceHalfWidth;
+			rowMin.z = nearDepth;
+			rowMax.z = farDepth;
+			inRow.count = 0;
+			for (int i = 0; i < inSlice.count; i += SimdFloat::Width)
+			{
+				int mask = SpheresInBox(inSlice.X(), inSlice.Y(), inSlice.Depth(), inSlice.Radius(), i, rowMin, rowMax);
+				if (mask)
+					Keep(mask, i, inSlice.X(), inSlice.Y(), inSlice.Depth(), inSlice.Radius(), inSlice.indices.data(), inRow);
+			}
+			PadCandidates(inRow);
+
+			for (int tileX = 0; tileX < m_TilesX; tileX++)
+			{
+				glm::vec3 boxMin = rowMin, boxMax = rowMax;
+				TileExtent(tileX, m_TilesX, m_TanHalfX, nearDepth, farDepth, boxMin.x, boxMax.x);
+				for (int i = 0; i < inRow.count; i += SimdFloat::Width)
+				{
+					int mask = SpheresInBox(inRow.X(), inRow.Y(), inRow.Depth(), inRow.Radius(), i, boxMin, boxMax);
+					for (int lane = 0; mask != 0; lane++, mask >>= 1)
+						if (mask & 1)
+							lists.indices.push_back(inRow.indices[i + lane]);
+				}
+				lists.offsets[tileY * m_TilesX + tileX + 1] = static_cast<uint32_t>(lists.indices.size());
+			}
+		}
+	}
+
+	// Orphans the buffer's storage, as BonePaletteBuffer does, and writes data in one call
+	void Upload(int buffer, const void* data, size_t bytes)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, m_TBOs[buffer]);
+		glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(bytes, 16), NULL, GL_STREAM_DRAW);
+		if (bytes > 0)
+			glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	}
+
+	int m_TilesX;
+	int m_TilesY;
+	int m_Slices;
+	int m_FirstTextureUnit;
+	size_t m_MaxTexels = 65536;
+
+	unsigned int m_TBOs[3] = {}; // lights, cluster ranges, light indices
+	unsigned int m_Textures[3] = {};
+
+	float m_Near = 0.1f;
+	float m_Far = 100.0f;
+	float m_NearSplit = 0.0f;
+	float m_TanHalfX = 1.0f;
+	float m_TanHalfY = 1.0f;
+	int m_LightCount = 0;
+	AlignedBuffer m_ViewLights;
+	std::vector<Scratch> m_Scratch;
+	std::vector<SliceLists> m_Slice;
+	std::vector<uint32_t> m_Ranges;  // offset and count per cluster, slice by slice, row by row
+	std::vector<uint32_t> m_Indices;
+	size_t m_DroppedCount = 0;
+	int m_MaxClusterLights = 0;
+	int m_OccupiedClusterCount = 0;
+};
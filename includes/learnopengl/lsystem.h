@@ -0,0 +1,286 @@
+#pragma once
+
+/* Deterministic, context-free L-system derived lazily. Rules live in a table indexed by symbol, and the
+   length every symbol expands to after each number of rewrites is computed up front, so the final string
+   never has to exist: a Cursor walks the derivation tree depth first with one frame per rewrite level
+   (O(iterations) memory), and Seek jumps to any position by skipping whole subtrees by their length.
+   MaterializeParallel builds the string generation by generation on a TaskPool instead. */
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <learnopengl/task_pool.h>
+
+class LSystem
+{
+public:
+	LSystem() { m_Rules.resize(SymbolCount); m_HasRule.assign(SymbolCount, false); Changed(); }
+
+	LSystem(const std::string& axiom, int iterations)
+		: LSystem()
+	{
+		m_Axiom = axiom;
+		m_Iterations = iterations;
+		Changed();
+	}
+
+	void SetAxiom(const std::string& axiom) { m_Axiom = axiom; Changed(); }
+	void SetIterations(int iterations) { m_Iterations = iterations; Changed(); }
+
+	void SetRule(char symbol, const std::string& production)
+	{
+		m_Rules[Index(symbol)] = production;
+		m_HasRule[Index(symbol)] = true;
+		Changed();
+	}
+
+	// Changes with every setter and is never shared by two differently configured systems (copies keep it),
+	// so whatever is derived from the string can be cached against it
+	uint64_t GetVersion() const { return m_Version; }
+
+	const std::string& GetAxiom() const { return m_Axiom; }
+	int GetIterations() const { return m_Iterations; }
+	bool HasRule(char symbol) const { return m_HasRule[Index(symbol)]; }
+	// Empty when the symbol has no rule
+	const std::string& GetProduction(char symbol) const { return m_Rules[Index(symbol)]; }
+
+	// Symbols in the fully derived string; saturates at SIZE_MAX
+	size_t GetLength() const { return m_Length; }
+
+	// Symbols one symbol turns into after depth rewrites
+	size_t GetExpansionLength(char symbol, int depth) const
+	{
+		return m_Lengths[static_cast<size_t>(depth) * SymbolCount + Index(symbol)];
+	}
+
+	// Bytes of the length table, the only state that grows with the derivation (linearly in iterations)
+	size_t GetMemorySize() const
+	{
+		return sizeof(*this) + m_Lengths.capacity() * sizeof(size_t) + m_Axiom.capacity();
+	}
+
+	/* Streams the derived string from a position. Each frame is one production being read at one rewrite
+	   level; the top frame always sits on a symbol that isn't rewritten any further. */
+	class Cursor
+	{
+	public:
+		bool Done() const { return m_Frames.empty(); }
+		char Get() const { const Frame& frame = m_Frames.back(); return frame.symbols[frame.index]; }
+		size_t GetPosition() const { return m_Position; }
+
+		void Next()
+		{
+			m_Position++;
+			if (Advance())
+				Descend(0);
+		}
+
+		size_t GetMemorySize() const { return sizeof(*this) + m_Frames.capacity() * sizeof(Frame); }
+
+	private:
+		friend class LSystem;
+
+		struct Frame
+		{
+			const char* symbols;
+			size_t count;
+			size_t index;
+			int depth; // rewrites still to apply to symbols[index]
+		};
+
+		// Pushes productions until the top symbol is final, skipping `skip` symbols of the expansion on the way
+		void Descend(size_t skip)
+		{
+			for (;;)
+			{
+				Frame& frame = m_Frames.back();
+				while (skip > 0)
+				{
+					size_t length = m_System->GetExpansionLength(frame.symbols[frame.index], frame.depth);
+					if (skip < length)
+						break;
+					skip -= length;
+					frame.index++;
+				}
+				char symbol = frame.symbols[frame.index];
+				if (frame.depth == 0 || !m_System->HasRule(symbol))
+					return;
+				const std::string& production = m_System->GetProduction(symbol);
+				if (production.empty())
+				{
+					// an erasing rule expands to nothing: carry on as if the symbol had been read
+					if (!Advance())
+						return;
+					continue;
+				}
+				m_Frames.push_back({ production.data(), production.size(), 0, frame.depth - 1 });
+			}
+		}
+
+		// Steps past the current symbol, closing finished productions; false at the end of the string
+		bool Advance()
+		{
+			m_Frames.back().index++;
+			while (m_Frames.back().index == m_Frames.back().count)
+			{
+				m_Frames.pop_back();
+				if (m_Frames.empty())
+					return false;
+				m_Frames.back().index++;
+			}
+			return true;
+		}
+
+		const LSystem* m_System = nullptr;
+		std::vector<Frame> m_Frames;
+		size_t m_Position = 0;
+	};
+
+	// Cursor on the symbol at position (Done() if position is past the end). The system must outlive it and
+	// stay unchanged while it's used.
+	Cursor Seek(size_t position) const
+	{
+		Cursor cursor;
+		cursor.m_System = this;
+		cursor.m_Position = position;
+		if (position >= GetLength())
+			return cursor;
+		cursor.m_Frames.reserve(m_Iterations + 1);
+		cursor.m_Frames.push_back({ m_Axiom.data(), m_Axiom.size(), 0, m_Iterations });
+		cursor.Descend(position);
+		return cursor;
+	}
+
+	Cursor Begin() const { return Seek(0); }
+
+	// Symbol at position without materializing anything; O(iterations * production length)
+	char At(size_t position) const { return Seek(position).Get(); }
+
+	// The whole string, for when it really is needed (export, caching). Sized exactly up front.
+	std::string Materialize() const
+	{
+		std::string result;
+		result.reserve(GetLength());
+		for (Cursor cursor = Begin(); !cursor.Done(); cursor.Next())
+			result.push_back(cursor.Get());
+		return result;
+	}
+
+	/* Same string as Materialize. Each generation is split into blocks; the threads sum the production
+	   lengths of their blocks, an exclusive scan over those sums gives every block its output offset, and
+	   the threads then write their blocks' productions straight into the next generation, sized exactly.
+	   Peak memory is the last two generations. */
+	std::string MaterializeParallel(TaskPool& pool, int blockSize = 1 << 16) const
+	{
+		size_t productionLengths[SymbolCount];
+		for (size_t symbol = 0; symbol < SymbolCount; symbol++)
+			productionLengths[symbol] = m_HasRule[symbol] ? m_Rules[symbol].size() : 1;
+
+		std::string current = m_Axiom;
+		std::string next;
+		std::vector<size_t> blockOffsets;
+		for (int generation = 0; generation < m_Iterations; generation++)
+		{
+			size_t length = current.size();
+			int blockCount = static_cast<int>((length + blockSize - 1) / blockSize);
+			blockOffsets.assign(static_cast<size_t>(blockCount) + 1, 0);
+
+			pool.ParallelFor(blockCount, 1, [&](int begin, int end, int)
+			{
+				for (int block = begin; block < end; block++)
+				{
+					size_t first = static_cast<size_t>(block) * blockSize;
+					size_t last = first + blockSize < length ? first + blockSize : length;
+					size_t blockLength = 0;
+					for (size_t i = first; i < last; i++)
+						blockLength += productionLengths[Index(current[i])];
+					blockOffsets[block + 1] = blockLength;
+				}
+			});
+			for (int block = 0; block < blockCount; block++)
+				blockOffsets[block + 1] += blockOffsets[block];
+
+			next.resize(blockOffsets[blockCount]);
+			pool.ParallelFor(blockCount, 1, [&](int begin, int end, int)
+			{
+				for (int block = begin; block < end; block++)
+				{
+					size_t first = static_cast<size_t>(block) * blockSize;
+					size_t last = first + blockSize < length ? first + blockSize : length;
+					char* out = &next[0] + blockOffsets[block];
+					for (size_t i = first; i < last; i++)
+					{
+						char symbol = current[i];
+						if (m_HasRule[Index(symbol)])
+						{
+							const std::string& production = m_Rules[Index(symbol)];
+							for (char produced : production)
+								*out++ = produced;
+						}
+						else
+							*out++ = symbol;
+					}
+				}
+			});
+			current.swap(next);
+		}
+		return current;
+	}
+
+private:
+	static const size_t SymbolCount = 256;
+
+	static size_t Index(char symbol) { return static_cast<unsigned char>(symbol); }
+
+	static size_t SaturatingAdd(size_t a, size_t b) { return a > SIZE_MAX - b ? SIZE_MAX : a + b; }
+
+	static uint64_t NextVersion()
+	{
+		static std::atomic<uint64_t> counter(0);
+		return ++counter;
+	}
+
+	// The length table is rebuilt by every setter rather than on first use, so the const getters only ever
+	// read it and any number of threads can stream or measure one system at once
+	void Changed()
+	{
+		UpdateLengths();
+		m_Version = NextVersion();
+	}
+
+	// m_Lengths[depth][symbol], depth 0 being the symbol itself
+	void UpdateLengths()
+	{
+		m_Lengths.assign((static_cast<size_t>(m_Iterations) + 1) * SymbolCount, 1);
+		for (int depth = 1; depth <= m_Iterations; depth++)
+		{
+			const size_t* previous = &m_Lengths[static_cast<size_t>(depth - 1) * SymbolCount];
+			size_t* current = &m_Lengths[static_cast<size_t>(depth) * SymbolCount];
+			for (size_t symbol = 0; symbol < SymbolCount; symbol++)
+			{
+				if (!m_HasRule[symbol])
+					continue;
+				size_t length = 0;
+				for (char produced : m_Rules[symbol])
+					length = SaturatingAdd(length, previous[Index(produced)]);
+				current[symbol] = length;
+			}
+		}
+
+		m_Length = 0;
+		const size_t* top = &m_Lengths[static_cast<size_t>(m_Iterations) * SymbolCount];
+		for (char symbol : m_Axiom)
+			m_Length = SaturatingAdd(m_Length, top[Index(symbol)]);
+	}
+
+	std::string m_Axiom;
+	int m_Iterations = 0;
+	std::vector<std::string> m_Rules;
+	std::vector<bool> m_HasRule;
+	uint64_t m_Version = 0;
+
+	std::vector<size_t> m_Lengths;
+	size_t m_Length = 0;
+};
@@ -0,0 +1,453 @@
+#pragma once
+
+/* Thousands of L-system trees sharing a handful of variants (each an LSystemMesh, its turtle run once), placed
+   from a seed with their own position, yaw and scale. Each frame the trees outside the view frustum are
+   skipped and the rest are sorted by distance into:
+   - near trees, drawn as meshes at the level of detail their distance calls for, one glDrawElementsInstanced
+     per variant and level in use;
+   - far trees, drawn as impostors: camera-facing quads textured with the variant as seen from the nearest of
+     a few directions around its up axis, rendered once into an atlas at load time (BakeImpostors), all in
+     one instanced draw;
+   - and trees in the band between, drawn both ways and cross-faded with a screen-space dither that gives every
+     pixel to exactly one of the two, so nothing needs sorting or blending.
+   The atlases hold albedo with coverage, and the normal in the view's frame with the specular strength, so
+   6.tree_impostor.fs lights impostors with the scene's lights like 6.multiple_lights.fs does the meshes. */
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <learnopengl/lsystem.h>
+#include <learnopengl/lsystem_mesh.h>
+#include <learnopengl/lsystem_tree.h>
+#include <learnopengl/shader_m.h>
+#include <learnopengl/task_pool.h>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+struct ForestTree
+{
+	glm::vec3 position; // where the variant's turtle started
+	float yaw;          // about the up axis, in radians
+	float scale;
+	int variant;
+};
+
+// Per-instance attributes of a tree drawn as a mesh: its model matrix at locations 3 to 6, the mesh's share of
+// the cross-fade at 11
+struct ForestMeshInstance
+{
+	glm::mat4 model;
+	float fade;
+};
+
+// Per-instance attributes of an impostor, at locations 1 and 2 of 6.tree_impostor.vs
+struct ForestImpostorInstance
+{
+	glm::vec4 positionScale;
+	glm::vec3 yawVariantFade; // fade is the mesh's share, the impostor takes the rest
+};
+
+class LSystemForest
+{
+public:
+	static const int MaxVariants = 16; // MAX_TREE_VARIANTS in 6.tree_impostor.vs
+
+	LSystemForest()
+	{
+		glGenBuffers(1, &m_MeshInstanceVBO);
+
+		// one quad, corners -1 to 1, as a triangle strip; everything else is per impostor
+		const float corners[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+		glGenVertexArrays(1, &m_ImpostorVAO);
+		glGenBuffers(1, &m_QuadVBO);
+		glGenBuffers(1, &m_ImpostorInstanceVBO);
+		glBindVertexArray(m_ImpostorVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, m_QuadVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+		glBindBuffer(GL_ARRAY_BUFFER, m_ImpostorInstanceVBO);
+		AttachInstanceAttribute(1, 4, sizeof(ForestImpostorInstance), offsetof(ForestImpostorInstance, positionScale));
+		AttachInstanceAttribute(2, 3, sizeof(ForestImpostorInstance), offsetof(ForestImpostorInstance, yawVariantFade));
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	~LSystemForest()
+	{
+		glDeleteBuffers(1, &m_MeshInstanceVBO);
+		glDeleteVertexArrays(1, &m_ImpostorVAO);
+		glDeleteBuffers(1, &m_QuadVBO);
+		glDeleteBuffers(1, &m_ImpostorInstanceVBO);
+		glDeleteTextures(2, m_Atlases);
+	}
+
+	LSystemForest(const LSystemForest&) = delete;
+	LSystemForest& operator=(const LSystemForest&) = delete;
+
+	// Runs the turtle (on pool if given) and builds the variant's mesh; -1 once MaxVariants are taken.
+	// Variants are added before Scatter and BakeImpostors.
+	int AddVariant(const LSystem& system, const TurtleState& initialTurtleState, float angle, float scaleFactor, TaskPool* pool = nullptr)
+	{
+		if (static_cast<int>(m_Variants.size()) >= MaxVariants)
+			return -1;
+		std::vector<int> previousSegments;
+		std::vector<SegmentInstance> segments = LSystemTree::Interpret(system, initialTurtleState, angle, scaleFactor, pool, &previousSegments);
+		std::unique_ptr<LSystemMesh> mesh(new LSystemMesh());
+		mesh->Build(segments, previousSegments);
+		m_Variants.push_back(std::move(mesh));
+		return static_cast<int>(m_Variants.size()) - 1;
+	}
+
+	/* count trees spread evenly over the ring between innerRadius and outerRadius around center (in its xz
+	   plane), each with a random yaw, scale and variant. The same seed gives the same forest everywhere: the
+	   numbers come straight from mt19937, whose sequence the standard fixes, not from its distributions. */
+	void Scatter(int count, const glm::vec3& center, float innerRadius, float outerRadius, uint32_t seed,
+		float minScale = 0.7f, float maxScale = 1.3f)
+	{
+		std::mt19937 random(seed);
+		auto next = [&random]() { return static_cast<float>(random() >> 8) / 16777216.0f; };
+		m_Trees.clear();
+		if (m_Variants.empty())
+			return;
+		m_Trees.reserve(count);
+		for (int i = 0; i < count; i++)
+		{
+			float radius = std::sqrt(glm::mix(innerRadius * innerRadius, outerRadius * outerRadius, next()));
+			float angle = next() * glm::two_pi<float>();
+			ForestTree tree;
+			tree.position = center + glm::vec3(std::cos(angle), 0.0f, std::sin(angle)) * radius;
+			tree.yaw = next() * glm::two_pi<float>();
+			tree.scale = glm::mix(minScale, maxScale, next());
+			tree.variant = glm::min(static_cast<int>(next() * m_Variants.size()), static_cast<int>(m_Variants.size()) - 1);
+			m_Trees.push_back(tree);
+		}
+		PlaceTrees();
+	}
+
+	/* Renders every variant, fully grown and without wind, from viewCount directions around its up axis into
+	   the atlases, a tileSize square per variant (row) and view (column), fitted to the variant's bounding
+	   sphere. bakeShader is 6.multiple_lights.vs with 6.tree_impostor_bake.fs, and the material's textures
+	   must be bound as for drawing the trees (diffuse on unit 0, specular on 1). Both atlases are cleared to
+	   zero, so their mipmaps average everything premultiplied by coverage; the impostor shader divides it out. */
+	void BakeImpostors(const Shader& bakeShader, int tileSize = 256, int viewCount = 8)
+	{
+		m_ViewCount = viewCount;
+		int width = tileSize * viewCount;
+		int height = tileSize * glm::max(GetVariantCount(), 1);
+		int maxLevel = 0;
+		while ((tileSize >> (maxLevel + 1)) >= 8)
+			maxLevel++;
+
+		// the material's textures stay where the caller bound them; the atlases are only bound to be set up
+		GLint previousTexture;
+		glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+		if (!m_Atlases[0])
+			glGenTextures(2, m_Atlases);
+		for (int i = 0; i < 2; i++)
+		{
+			glBindTexture(GL_TEXTURE_2D, m_Atlases[i]);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			// below 8 texels a tile would bleed into its neighbours
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, maxLevel);
+		}
+		glBindTexture(GL_TEXTURE_2D, previousTexture);
+
+		GLint previousFramebuffer;
+		GLint previousViewport[4];
+		glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+		glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+		unsigned int framebuffer, depthBuffer;
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_Atlases[0], 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_Atlases[1], 0);
+		glGenRenderbuffers(1, &depthBuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+		const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glDrawBuffers(2, drawBuffers);
+
+		bakeShader.use();
+		bakeShader.setMat4("model", glm::mat4(1.0f));
+		bakeShader.setFloat("growthProgress", 1.0f);
+		bakeShader.setFloat("windStrength", 0.0f);
+		// still normalized by the shader, so it mustn't be left at zero even without wind
+		bakeShader.setVec3("windDirection", glm::vec3(1.0f, 0.0f, 0.0f));
+		bakeShader.setBool("instanced", false);
+		bakeShader.setBool("treeInstances", false);
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		// keeps every view inside its tile; enabled after the clear, which has to reach the whole atlas
+		glEnable(GL_SCISSOR_TEST);
+		for (int variant = 0; variant < GetVariantCount(); variant++)
+		{
+			const LSystemMesh& mesh = *m_Variants[variant];
+			glm::vec3 center = mesh.GetCenter();
+			float radius = glm::max(mesh.GetRadius(), 1e-3f);
+			bakeShader.setMat4("projection", glm::ortho(-radius, radius, -radius, radius, radius, 3.0f * radius));
+			for (int view = 0; view < viewCount; view++)
+			{
+				glViewport(view * tileSize, variant * tileSize, tileSize, tileSize);
+				glScissor(view * tileSize, variant * tileSize, tileSize, tileSize);
+				// the same azimuth the impostor shader picks the view by: atan(x, z) of the direction to the camera
+				float azimuth = glm::two_pi<float>() * view / viewCount;
+				glm::vec3 toCamera(std::sin(azimuth), 0.0f, std::cos(azimuth));
+				bakeShader.setMat4("view", glm::lookAt(center + toCamera * (2.0f * radius), center, glm::vec3(0.0f, 1.0f, 0.0f)));
+				mesh.Draw(bakeShader, 0);
+			}
+		}
+		glDisable(GL_SCISSOR_TEST);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+		glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+		glDeleteRenderbuffers(1, &depthBuffer);
+		glDeleteFramebuffers(1, &framebuffer);
+		for (int i = 0; i < 2; i++)
+		{
+			glBindTexture(GL_TEXTURE_2D, m_Atlases[i]);
+			glGenerateMipmap(GL_TEXTURE_2D);
+		}
+		glBindTexture(GL_TEXTURE_2D, previousTexture);
+		m_Baked = true;
+	}
+
+	// Trees nearer than distance are meshes only, beyond distance + fadeWidth impostors only (until the
+	// impostors are baked every tree is a mesh)
+	void SetImpostorDistance(float distance, float fadeWidth)
+	{
+		m_ImpostorDistance = distance;
+		m_FadeWidth = glm::max(fadeWidth, 1e-3f);
+	}
+
+	// Once per frame, before drawing: culls, sorts the trees into meshes and impostors and uploads both
+	void Update(const glm::mat4& projection, const glm::mat4& view, const glm::vec3& cameraPosition, float viewportHeight)
+	{
+		glm::vec4 planes[6];
+		FrustumPlanes(projection * view, planes);
+
+		size_t batchCount = m_Variants.size() * LSystemMesh::MaxLods;
+		m_Batches.resize(batchCount);
+		for (std::vector<ForestMeshInstance>& batch : m_Batches)
+			batch.clear();
+		m_ImpostorInstances.clear();
+		m_CulledCount = 0;
+		m_MeshTreeCount = 0;
+		m_MeshTriangleCount = 0;
+
+		for (size_t i = 0; i < m_Trees.size(); i++)
+		{
+			const ForestTree& tree = m_Trees[i];
+			const Placement& placement = m_Placements[i];
+			if (!SphereInFrustum(planes, placement.center, placement.radius))
+			{
+				m_CulledCount++;
+				continue;
+			}
+			float distance = glm::length(placement.center - cameraPosition);
+			float fade = m_Baked ? glm::clamp(1.0f - (distance - m_ImpostorDistance) / m_FadeWidth, 0.0f, 1.0f) : 1.0f;
+			if (fade > 0.0f)
+			{
+				const LSystemMesh& mesh = *m_Variants[tree.variant];
+				int lod = mesh.SelectLodAtDistance(distance / tree.scale, projection, viewportHeight);
+				m_Batches[tree.variant * LSystemMesh::MaxLods + lod].push_back({ placement.model, fade });
+				m_MeshTreeCount++;
+				m_MeshTriangleCount += mesh.GetTriangleCount(lod);
+			}
+			if (fade < 1.0f)
+			{
+				ForestImpostorInstance impostor;
+				impostor.positionScale = glm::vec4(tree.position, tree.scale);
+				impostor.yawVariantFade = glm::vec3(tree.yaw, static_cast<float>(tree.variant), fade);
+				m_ImpostorInstances.push_back(impostor);
+			}
+		}
+
+		// batches back to back in one buffer, each draw pointing the attributes at its own
+		m_MeshInstances.clear();
+		m_BatchFirst.resize(batchCount);
+		for (size_t batch = 0; batch < batchCount; batch++)
+		{
+			m_BatchFirst[batch] = m_MeshInstances.size();
+			m_MeshInstances.insert(m_MeshInstances.end(), m_Batches[batch].begin(), m_Batches[batch].end());
+		}
+		Upload(m_MeshInstanceVBO, m_MeshInstances.data(), m_MeshInstances.size() * sizeof(ForestMeshInstance));
+		Upload(m_ImpostorInstanceVBO, m_ImpostorInstances.data(), m_ImpostorInstances.size() * sizeof(ForestImpostorInstance));
+	}
+
+	// The mesh trees with the lighting shader (6.multiple_lights), which draws them while "treeInstances" is
+	// set; returns the number of draw calls
+	int DrawMeshes(const Shader& shader) const
+	{
+		int drawCalls = 0;
+		shader.setBool("treeInstances", true);
+		for (size_t batch = 0; batch < m_Batches.size(); batch++)
+		{
+			int count = static_cast<int>(m_Batches[batch].size());
+			if (count == 0)
+				continue;
+			const LSystemMesh& mesh = *m_Variants[batch / LSystemMesh::MaxLods];
+			int lod = static_cast<int>(batch % LSystemMesh::MaxLods);
+			glBindVertexArray(mesh.GetVAO(lod));
+			glBindBuffer(GL_ARRAY_BUFFER, m_MeshInstanceVBO);
+			size_t first = m_BatchFirst[batch] * sizeof(ForestMeshInstance);
+			for (unsigned int column = 0; column < 4; column++)
+				AttachInstanceAttribute(3 + column, 4, sizeof(ForestMeshInstance), first + offsetof(ForestMeshInstance, model) + column * sizeof(glm::vec4));
+			AttachInstanceAttribute(11, 1, sizeof(ForestMeshInstance), first + offsetof(ForestMeshInstance, fade));
+			mesh.DrawInstanced(shader, lod, count);
+			drawCalls++;
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		shader.setBool("treeInstances", false);
+		return drawCalls;
+	}
+
+	// Sets the uniforms of a 6.tree_impostor program that only change with the variants and the bake: the
+	// atlases' texture units (2 and 3, clear of the material's), the view count and every variant's bounding
+	// sphere. Once per program after BakeImpostors.
+	void BindImpostorShader(const Shader& shader) const
+	{
+		std::vector<glm::vec4> bounds;
+		for (int variant = 0; variant < GetVariantCount(); variant++)
+			bounds.push_back(glm::vec4(m_Variants[variant]->GetCenter(), m_Variants[variant]->GetRadius()));
+		shader.use();
+		shader.setInt("impostorAlbedo", 2);
+		shader.setInt("impostorNormal", 3);
+		shader.setInt("viewCount", m_ViewCount);
+		shader.setInt("variantCount", GetVariantCount());
+		if (!bounds.empty())
+			glUniform4fv(shader.getUniformLocation("variantBounds"), static_cast<GLsizei>(bounds.size()), &bounds[0][0]);
+	}
+
+	// The impostors in one draw call with a 6.tree_impostor program set up by BindImpostorShader, whose
+	// camera and light uniforms the caller sets. Returns the number of draw calls.
+	int DrawImpostors(const Shader& shader) const
+	{
+		if (m_ImpostorInstances.empty())
+			return 0;
+		shader.use();
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, m_Atlases[0]);
+		glActiveTexture(GL_TEXTURE3);
+		glBindTexture(GL_TEXTURE_2D, m_Atlases[1]);
+		glActiveTexture(GL_TEXTURE0);
+		glBindVertexArray(m_ImpostorVAO);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(m_ImpostorInstances.size()));
+		glBindVertexArray(0);
+		return 1;
+	}
+
+	int GetVariantCount() const { return static_cast<int>(m_Variants.size()); }
+	const LSystemMesh& GetVariant(int variant) const { return *m_Variants[variant]; }
+	const std::vector<ForestTree>& GetTrees() const { return m_Trees; }
+	unsigned int GetAlbedoAtlas() const { return m_Atlases[0]; }
+	unsigned int GetNormalAtlas() const { return m_Atlases[1]; }
+
+	// Of the last Update; trees in the cross-fade count as both a mesh and an impostor
+	int GetCulledCount() const { return m_CulledCount; }
+	int GetMeshTreeCount() const { return m_MeshTreeCount; }
+	int GetImpostorCount() const { return static_cast<int>(m_ImpostorInstances.size()); }
+	size_t GetMeshTriangleCount() const { return m_MeshTriangleCount; }
+
+private:
+	// What Update needs of a tree, worked out once by Scatter
+	struct Placement
+	{
+		glm::mat4 model;
+		glm::vec3 center; // of its bounding sphere
+		float radius;
+	};
+
+	void PlaceTrees()
+	{
+		m_Placements.resize(m_Trees.size());
+		for (size_t i = 0; i < m_Trees.size(); i++)
+		{
+			const ForestTree& tree = m_Trees[i];
+			const LSystemMesh& mesh = *m_Variants[tree.variant];
+			Placement& placement = m_Placements[i];
+			placement.model = glm::scale(glm::rotate(glm::translate(glm::mat4(1.0f), tree.position), tree.yaw, glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(tree.scale));
+			placement.center = glm::vec3(placement.model * glm::vec4(mesh.GetCenter(), 1.0f));
+			placement.radius = mesh.GetRadius() * tree.scale;
+		}
+	}
+
+	// Planes of the frustum of a projection * view matrix, pointing inwards, as (normal, distance)
+	static void FrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+	{
+		glm::vec4 rows[4];
+		for (int row = 0; row < 4; row++)
+			rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row], viewProjection[2][row], viewProjection[3][row]);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			planes[axis * 2] = rows[3] + rows[axis];
+			planes[axis * 2 + 1] = rows[3] - rows[axis];
+		}
+		for (int plane = 0; plane < 6; plane++)
+			planes[plane] = planes[plane] / glm::length(glm::vec3(planes[plane]));
+	}
+
+	static bool SphereInFrustum(const glm::vec4 planes[6], const glm::vec3& center, float radius)
+	{
+		for (int plane = 0; plane < 6; plane++)
+			if (glm::dot(glm::vec3(planes[plane]), center) + planes[plane].w < -radius)
+				return false;
+		return true;
+	}
+
+	// Replaces the buffer's storage, orphaning the old one as InstancePaletteBuffer does
+	static void Upload(unsigned int buffer, const void* data, size_t size)
+	{
+		if (size == 0)
+			return;
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, size, data);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	static void AttachInstanceAttribute(unsigned int location, int size, size_t stride, size_t offset)
+	{
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, static_cast<GLsizei>(stride), (void*)offset);
+		glVertexAttribDivisor(location, 1);
+	}
+
+	std::vector<std::unique_ptr<LSystemMesh>> m_Variants;
+	std::vector<ForestTree> m_Trees;
+	std::vector<Placement> m_Placements;
+
+	// impostors
+	unsigned int m_Atlases[2] = { 0, 0 }; // albedo and coverage; normal and specular
+	int m_ViewCount = 1;
+	bool m_Baked = false;
+	float m_ImpostorDistance = 30.0f;
+	float m_FadeWidth = 5.0f;
+
+	// per frame
+	std::vector<std::vector<ForestMeshInstance>> m_Batches; // per variant and level of detail
+	std::vector<size_t> m_BatchFirst;
+	std::vector<ForestMeshInstance> m_MeshInstances;
+	std::vector<ForestImpostorInstance> m_ImpostorInstances;
+	int m_CulledCount = 0;
+	int m_MeshTreeCount = 0;
+	size_t m_MeshTriangleCount = 0;
+
+	unsigned int m_MeshInstanceVBO = 0;
+	unsigned int m_ImpostorVAO = 0;
+	unsigned int m_QuadVBO = 0;
+	unsigned int m_ImpostorInstanceVBO = 0;
+};
@@ -0,0 +1,393 @@
+#pragma once
+
+/* An LSystemTree's segments as one merged generalized-cylinder mesh instead of a box per segment. Segments
+   are joined into tubes along LSystemTree::Interpret's previousSegments: at every joint the segment goes on
+   into the successor that keeps closest to its direction, through one ring both share (its tangent halfway
+   between the two), so bends are smooth and nothing is drawn twice. The other successors start tubes of
+   their own, sunk into the joint by their radius so no gap shows; tubes end in a short cone.
+
+   Rings have fewer sides the thinner they are, and the mesh is built at several levels of detail that also
+   drop the branches below a fraction of the trunk's radius (with everything growing out of them). Each level
+   knows the largest error it makes in world units, so SelectLod can pick the coarsest one that stays within
+   a pixel at the tree's distance.
+
+   Vertices carry what the instanced segments did (wind sums and birth), plus the point they grow out of: a
+   ring grows from the start of the segment it ends (a tube's first ring from its own center), and
+   6.multiple_lights.vs animates the mesh with it while "treeMesh" is set. */
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <learnopengl/lsystem_tree.h>
+#include <learnopengl/shader_m.h>
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+struct TreeMeshVertex
+{
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 texCoords;    // u around the tube, v along it (one unit per trunk circumference)
+	glm::vec4 windCos;      // SegmentInstance's
+	glm::vec4 windSin;
+	glm::vec2 birth;
+	glm::vec3 growthOrigin; // where the vertex sits before its birth
+};
+
+// Ring sides at the trunk's radius (thinner rings get fewer, down to 3) and the thinnest branch kept, as a
+// fraction of the trunk's radius
+struct TreeMeshLodSettings
+{
+	int ringSides;
+	float minRadius;
+};
+
+class LSystemMesh
+{
+public:
+	static const int MaxLods = 4;
+
+	LSystemMesh()
+	{
+		glGenVertexArrays(MaxLods, m_VAO);
+		glGenBuffers(MaxLods, m_VBO);
+		glGenBuffers(MaxLods, m_EBO);
+		for (int lod = 0; lod < MaxLods; lod++)
+		{
+			glBindVertexArray(m_VAO[lod]);
+			glBindBuffer(GL_ARRAY_BUFFER, m_VBO[lod]);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO[lod]);
+			AttachAttribute(0, 3, offsetof(TreeMeshVertex, position));
+			AttachAttribute(1, 3, offsetof(TreeMeshVertex, normal));
+			AttachAttribute(2, 2, offsetof(TreeMeshVertex, texCoords));
+			AttachAttribute(7, 4, offsetof(TreeMeshVertex, windCos));
+			AttachAttribute(8, 4, offsetof(TreeMeshVertex, windSin));
+			AttachAttribute(9, 2, offsetof(TreeMeshVertex, birth));
+			AttachAttribute(10, 3, offsetof(TreeMeshVertex, growthOrigin));
+		}
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	~LSystemMesh()
+	{
+		glDeleteVertexArrays(MaxLods, m_VAO);
+		glDeleteBuffers(MaxLods, m_VBO);
+		glDeleteBuffers(MaxLods, m_EBO);
+	}
+
+	LSystemMesh(const LSystemMesh&) = delete;
+	LSystemMesh& operator=(const LSystemMesh&) = delete;
+
+	/* Builds and uploads every level from the segments and previousSegments of LSystemTree::Interpret (the
+	   segments' models are LSystemTree's unit cube scaled to the segment, so a segment starts at model[3],
+	   runs along model[1] and is length(model[0]) thick). Levels go from finest to coarsest. */
+	void Build(const std::vector<SegmentInstance>& segments, const std::vector<int>& previousSegments,
+		const std::vector<TreeMeshLodSettings>& lods = DefaultLods())
+	{
+		m_LodCount = glm::min(static_cast<int>(lods.size()), static_cast<int>(MaxLods));
+		m_Center = glm::vec3(0.0f);
+		m_Radius = 0.0f;
+		if (segments.empty())
+		{
+			for (int lod = 0; lod < m_LodCount; lod++)
+				m_Lods[lod] = LodInfo();
+			return;
+		}
+
+		// bounding sphere around the box of the segments' ends
+		float rootRadius = 0.0f;
+		glm::vec3 low(segments[0].model[3]), high(low);
+		for (const SegmentInstance& segment : segments)
+		{
+			glm::vec3 start(segment.model[3]);
+			glm::vec3 end = start + glm::vec3(segment.model[1]);
+			low = glm::min(low, glm::min(start, end));
+			high = glm::max(high, glm::max(start, end));
+			rootRadius = glm::max(rootRadius, SegmentRadius(segment));
+		}
+		m_Center = (low + high) * 0.5f;
+		for (const SegmentInstance& segment : segments)
+		{
+			glm::vec3 start(segment.model[3]);
+			float distance = glm::max(glm::length(start - m_Center), glm::length(start + glm::vec3(segment.model[1]) - m_Center));
+			m_Radius = glm::max(m_Radius, distance + SegmentRadius(segment));
+		}
+
+		std::vector<TreeMeshVertex> vertices;
+		std::vector<unsigned int> indices;
+		for (int lod = 0; lod < m_LodCount; lod++)
+		{
+			BuildLod(segments, previousSegments, lods[lod], rootRadius, vertices, indices, m_Lods[lod]);
+			glBindBuffer(GL_ARRAY_BUFFER, m_VBO[lod]);
+			glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(TreeMeshVertex), vertices.empty() ? NULL : vertices.data(), GL_STATIC_DRAW);
+			glBindVertexArray(m_VAO[lod]);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.empty() ? NULL : indices.data(), GL_STATIC_DRAW);
+		}
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// 12-sided trunk with every branch, then 8, 6 and 4 sides dropping branches under 10%, 20% and 40% of it
+	static std::vector<TreeMeshLodSettings> DefaultLods()
+	{
+		return { { 12, 0.0f }, { 8, 0.1f }, { 6, 0.2f }, { 4, 0.4f } };
+	}
+
+	// The coarsest level whose error covers at most pixelTolerance pixels at the distance of the tree's center
+	// (transformed by model); viewportHeight in pixels
+	int SelectLod(const glm::mat4& projection, const glm::mat4& view, float viewportHeight,
+		const glm::mat4& model = glm::mat4(1.0f), float pixelTolerance = 1.0f) const
+	{
+		float distance = glm::length(glm::vec3(view * model * glm::vec4(m_Center, 1.0f)));
+		return SelectLodAtDistance(distance, projection, viewportHeight, pixelTolerance);
+	}
+
+	// The same for a tree whose center is distance away (in the mesh's units: divide by the tree's scale)
+	int SelectLodAtDistance(float distance, const glm::mat4& projection, float viewportHeight, float pixelTolerance = 1.0f) const
+	{
+		float pixelsPerUnit = projection[1][1] * 0.5f * viewportHeight / glm::max(distance, 1e-4f);
+		int selected = 0;
+		for (int lod = 1; lod < m_LodCount; lod++)
+			if (m_Lods[lod].error * pixelsPerUnit <= pixelTolerance)
+				selected = lod;
+		return selected;
+	}
+
+	// One glDrawElements; the shader animates the mesh while "treeMesh" is set
+	void Draw(const Shader& shader, int lod) const
+	{
+		if (lod < 0 || lod >= m_LodCount || m_Lods[lod].indexCount == 0)
+			return;
+		shader.setBool("treeMesh", true);
+		glBindVertexArray(m_VAO[lod]);
+		glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(m_Lods[lod].indexCount), GL_UNSIGNED_INT, 0);
+		glBindVertexArray(0);
+		shader.setBool("treeMesh", false);
+	}
+
+	// instanceCount copies in one glDrawElementsInstanced, for callers that added per-instance attributes to
+	// GetVAO(lod) (the locations the mesh leaves free: 3 to 6 and 11 on)
+	void DrawInstanced(const Shader& shader, int lod, int instanceCount) const
+	{
+		if (lod < 0 || lod >= m_LodCount || m_Lods[lod].indexCount == 0 || instanceCount <= 0)
+			return;
+		shader.setBool("treeMesh", true);
+		glBindVertexArray(m_VAO[lod]);
+		glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(m_Lods[lod].indexCount), GL_UNSIGNED_INT, 0, instanceCount);
+		glBindVertexArray(0);
+		shader.setBool("treeMesh", false);
+	}
+
+	unsigned int GetVAO(int lod) const { return m_VAO[lod]; }
+	int GetLodCount() const { return m_LodCount; }
+	size_t GetVertexCount(int lod) const { return m_Lods[lod].vertexCount; }
+	size_t GetTriangleCount(int lod) const { return m_Lods[lod].indexCount / 3; }
+	size_t GetSegmentCount(int lod) const { return m_Lods[lod].segmentCount; }
+	// Largest distance, in world units, between the level's surface and the finest one's
+	float GetError(int lod) const { return m_Lods[lod].error; }
+	const glm::vec3& GetCenter() const { return m_Center; }
+	float GetRadius() const { return m_Radius; }
+
+private:
+	struct LodInfo
+	{
+		size_t vertexCount = 0;
+		size_t indexCount = 0;
+		size_t segmentCount = 0;
+		float error = 0.0f;
+	};
+
+	// ring vertices first .. first + sides, the last repeating the first with u = 1 for the texture seam
+	struct Ring
+	{
+		unsigned int first;
+		int sides;
+		glm::vec3 center;
+		glm::vec3 tangent;
+		glm::vec3 reference; // direction of the first vertex from the center
+		float v;
+	};
+
+	static float SegmentRadius(const SegmentInstance& segment) { return glm::length(glm::vec3(segment.model[0])) * 0.5f; }
+
+	static void BuildLod(const std::vector<SegmentInstance>& segments, const std::vector<int>& previousSegments,
+		const TreeMeshLodSettings& settings, float rootRadius, std::vector<TreeMeshVertex>& vertices, std::vector<unsigned int>& indices, LodInfo& info)
+	{
+		size_t count = segments.size();
+		vertices.clear();
+		indices.clear();
+		info = LodInfo();
+		float vScale = 1.0f / (glm::two_pi<float>() * rootRadius);
+
+		// a segment is kept if it's thick enough and so is what it grows out of (previous is always earlier)
+		std::vector<char> kept(count);
+		float dropped = 0.0f;
+		for (size_t i = 0; i < count; i++)
+		{
+			int previous = previousSegments[i];
+			float radius = SegmentRadius(segments[i]);
+			kept[i] = radius >= settings.minRadius * rootRadius && (previous < 0 || kept[previous]);
+			if (!kept[i])
+				dropped = glm::max(dropped, 2.0f * radius);
+			else
+				info.segmentCount++;
+		}
+
+		// each kept segment goes on into the kept successor closest to its direction
+		std::vector<int> next(count, -1);
+		std::vector<float> nextAlignment(count, -2.0f);
+		for (size_t i = 0; i < count; i++)
+		{
+			int previous = previousSegments[i];
+			if (!kept[i] || previous < 0)
+				continue;
+			float alignment = glm::dot(glm::normalize(glm::vec3(segments[previous].model[1])), glm::normalize(glm::vec3(segments[i].model[1])));
+			if (alignment > nextAlignment[previous])
+			{
+				next[previous] = static_cast<int>(i);
+				nextAlignment[previous] = alignment;
+			}
+		}
+
+		// ring of segment i's end, and the largest gap between a ring's polygon and its circle
+		std::vector<Ring> endRings(count);
+		float faceting = 0.0f;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (!kept[i])
+				continue;
+			const SegmentInstance& segment = segments[i];
+			int previous = previousSegments[i];
+			glm::vec3 start(segment.model[3]);
+			glm::vec3 axis(segment.model[1]);
+			glm::vec3 direction = glm::normalize(axis);
+			float radius = SegmentRadius(segment);
+
+			Ring startRing;
+			if (previous >= 0 && next[previous] == static_cast<int>(i))
+				startRing = endRings[previous];
+			else
+			{
+				glm::vec3 center = previous >= 0 ? start - direction * radius : start;
+				glm::vec3 reference = glm::normalize(glm::vec3(segment.model[0]));
+				startRing = AddRing(segment, center, direction, reference, radius, RingSides(settings, radius, rootRadius), center, 0.0f, vertices, faceting);
+			}
+
+			// the joint ring leans halfway into the successor, which tapers from it to its own radius
+			int successor = next[i];
+			glm::vec3 tangent = direction;
+			if (successor >= 0)
+			{
+				glm::vec3 bisector = direction + glm::normalize(glm::vec3(segments[successor].model[1]));
+				if (glm::length(bisector) > 0.001f)
+					tangent = glm::normalize(bisector);
+			}
+			// the start ring's reference carried along without twisting
+			glm::vec3 reference = startRing.reference - glm::dot(startRing.reference, tangent) * tangent;
+			reference = glm::length(reference) > 0.001f ? glm::normalize(reference) : glm::normalize(glm::vec3(segment.model[0]));
+			float v = startRing.v + glm::length(start + axis - startRing.center) * vScale;
+			Ring endRing = AddRing(segment, start + axis, tangent, reference, radius, RingSides(settings, radius, rootRadius), start, v, vertices, faceting);
+			endRings[i] = endRing;
+			Stitch(startRing, endRing, indices);
+
+			if (successor < 0)
+			{
+				TreeMeshVertex tip = vertices[endRing.first];
+				tip.position = endRing.center + tangent * radius;
+				tip.normal = tangent;
+				tip.texCoords = glm::vec2(0.5f, v + radius * vScale);
+				unsigned int tipIndex = static_cast<unsigned int>(vertices.size());
+				vertices.push_back(tip);
+				for (int side = 0; side < endRing.sides; side++)
+				{
+					indices.push_back(endRing.first + side);
+					indices.push_back(endRing.first + side + 1);
+					indices.push_back(tipIndex);
+				}
+			}
+		}
+
+		info.vertexCount = vertices.size();
+		info.indexCount = indices.size();
+		info.error = glm::max(dropped, faceting);
+	}
+
+	static int RingSides(const TreeMeshLodSettings& settings, float radius, float rootRadius)
+	{
+		int sides = static_cast<int>(std::round(settings.ringSides * std::sqrt(radius / rootRadius)));
+		return glm::clamp(sides, 3, glm::max(settings.ringSides, 3));
+	}
+
+	static Ring AddRing(const SegmentInstance& segment, const glm::vec3& center, const glm::vec3& tangent, const glm::vec3& reference,
+		float radius, int sides, const glm::vec3& growthOrigin, float v, std::vector<TreeMeshVertex>& vertices, float& faceting)
+	{
+		Ring ring;
+		ring.first = static_cast<unsigned int>(vertices.size());
+		ring.sides = sides;
+		ring.center = center;
+		ring.tangent = tangent;
+		ring.reference = reference;
+		ring.v = v;
+		faceting = glm::max(faceting, radius * (1.0f - std::cos(glm::pi<float>() / sides)));
+
+		glm::vec3 binormal = glm::cross(tangent, reference);
+		for (int side = 0; side <= sides; side++)
+		{
+			float u = static_cast<float>(side) / sides;
+			float angle = u * glm::two_pi<float>();
+			TreeMeshVertex vertex;
+			vertex.normal = std::cos(angle) * reference + std::sin(angle) * binormal;
+			vertex.position = center + vertex.normal * radius;
+			vertex.texCoords = glm::vec2(u, v);
+			vertex.windCos = segment.windCos;
+			vertex.windSin = segment.windSin;
+			vertex.birth = segment.birth;
+			vertex.growthOrigin = growthOrigin;
+			vertices.push_back(vertex);
+		}
+		return ring;
+	}
+
+	// Triangles between two rings, counter-clockwise seen from outside; the rings may have different sides,
+	// so it walks both by u and always advances the one whose next vertex comes first
+	static void Stitch(const Ring& lower, const Ring& upper, std::vector<unsigned int>& indices)
+	{
+		int a = 0;
+		int b = 0;
+		while (a < lower.sides || b < upper.sides)
+		{
+			bool advanceLower = b == upper.sides
+				|| (a < lower.sides && static_cast<float>(a + 1) / lower.sides <= static_cast<float>(b + 1) / upper.sides);
+			indices.push_back(lower.first + a);
+			if (advanceLower)
+			{
+				indices.push_back(lower.first + a + 1);
+				indices.push_back(upper.first + b);
+				a++;
+			}
+			else
+			{
+				indices.push_back(upper.first + b + 1);
+				indices.push_back(upper.first + b);
+				b++;
+			}
+		}
+	}
+
+	static void AttachAttribute(unsigned int location, int size, size_t offset)
+	{
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, sizeof(TreeMeshVertex), (void*)offset);
+	}
+
+	unsigned int m_VAO[MaxLods];
+	unsigned int m_VBO[MaxLods];
+	unsigned int m_EBO[MaxLods];
+	LodInfo m_Lods[MaxLods];
+	int m_LodCount = 0;
+	glm::vec3 m_Center = glm::vec3(0.0f);
+	float m_Radius = 0.0f;
+};
@@ -0,0 +1,457 @@
+#pragma once
+
+/* Turtle interpretation of an LSystem drawn as instanced segments. The turtle runs once and leaves one
+   SegmentInstance per drawn F in an instance buffer; each frame the whole tree is one glDrawArraysInstanced and
+   the vertex shader animates growth and wind from the per-segment attributes and a few uniforms. The turtle
+   runs again only when the system or the drawing parameters change.
+
+   Growth: a segment grows while the tip of the path from the root reaches along it, so with birth times
+   measured in path length a branch starts exactly when the segment it sprouts from is complete.
+   Wind: every branch (and the trunk) sways about its pivot, the turtle position where it started, by
+   amplitude * sin(frequency * time + phase); a point in a branch moves with all its ancestors. Linearized,
+   that displacement is sum(amplitude_k * sin(w t + phase_k) * (x - pivot_k)) over the ancestors k, which
+   splits into sin(w t) and cos(w t) terms whose pivot sums are baked per segment in windCos and windSin.
+
+   Interpretation can run on a TaskPool: everything between a '[' and its ']' depends only on the turtle at
+   the '[', so large bracketed subtrees become tasks of their own, started with that state, and their
+   segments are spliced back in string order. */
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <learnopengl/lsystem.h>
+#include <learnopengl/shader_m.h>
+#include <learnopengl/task_pool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Helper struct for turtle graphics state
+struct TurtleState
+{
+	glm::vec3 position;
+	glm::vec3 direction; // This is the 'forward' vector
+	glm::vec3 up;        // Local 'up' vector
+	glm::vec3 right;     // Local 'right' vector, taken as cross(direction, up)
+	float length;
+	float thickness;
+};
+
+// Instance attributes of one segment
+struct SegmentInstance
+{
+	glm::mat4 model;
+	glm::vec4 windCos; // sum over the branch and its ancestors of amplitude * cos(phase) * (pivot, 1)
+	glm::vec4 windSin; // the same with sin(phase)
+	glm::vec2 birth;   // growth progress (0 to 1) at which the segment starts and finishes growing
+};
+
+class LSystemTree
+{
+public:
+	LSystemTree() { glGenBuffers(1, &m_InstanceVBO); }
+	~LSystemTree() { glDeleteBuffers(1, &m_InstanceVBO); }
+
+	LSystemTree(const LSystemTree&) = delete;
+	LSystemTree& operator=(const LSystemTree&) = delete;
+
+	// Adds the SegmentInstance attributes to a VAO holding the segment mesh: the model matrix at location to
+	// location + 3 (a mat4 takes four), then windCos, windSin and birth
+	void AttachInstanceAttributes(unsigned int VAO, unsigned int location = 3) const
+	{
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, m_InstanceVBO);
+		for (unsigned int column = 0; column < 4; column++)
+			AttachAttribute(location + column, 4, offsetof(SegmentInstance, model) + column * sizeof(glm::vec4));
+		AttachAttribute(location + 4, 4, offsetof(SegmentInstance, windCos));
+		AttachAttribute(location + 5, 4, offsetof(SegmentInstance, windSin));
+		AttachAttribute(location + 6, 2, offsetof(SegmentInstance, birth));
+		glBindVertexArray(0);
+	}
+
+	// Re-runs the turtle (on pool if given) and re-uploads the instances if anything changed since the last
+	// call; true if it did
+	bool Update(const LSystem& system, const TurtleState& initialTurtleState, float angle, float scaleFactor, TaskPool* pool = nullptr)
+	{
+		if (m_Built && m_Version == system.GetVersion() && SameState(m_InitialState, initialTurtleState)
+			&& m_Angle == angle && m_ScaleFactor == scaleFactor)
+			return false;
+		m_Built = true;
+		m_Version = system.GetVersion();
+		m_InitialState = initialTurtleState;
+		m_Angle = angle;
+		m_ScaleFactor = scaleFactor;
+
+		m_Segments = Interpret(system, initialTurtleState, angle, scaleFactor, pool, &m_PreviousSegments);
+		glBindBuffer(GL_ARRAY_BUFFER, m_InstanceVBO);
+		glBufferData(GL_ARRAY_BUFFER, m_Segments.size() * sizeof(SegmentInstance), m_Segments.empty() ? NULL : m_Segments.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return true;
+	}
+
+	size_t GetSegmentCount() const { return m_Segments.size(); }
+	const std::vector<SegmentInstance>& GetSegments() const { return m_Segments; }
+	// Per segment, the one it starts from the end of (see Interpret)
+	const std::vector<int>& GetPreviousSegments() const { return m_PreviousSegments; }
+
+	// One draw call for the whole tree; segments not born yet collapse to a point in the shader. VAO must
+	// have had AttachInstanceAttributes, and the shader uses them while "instanced" is set.
+	void Draw(const Shader& shader, unsigned int VAO, int vertexCount) const
+	{
+		if (m_Segments.empty())
+			return;
+		shader.setBool("instanced", true);
+		glBindVertexArray(VAO);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, vertexCount, static_cast<GLsizei>(m_Segments.size()));
+		shader.setBool("instanced", false);
+	}
+
+	/* The segments of the system's string in string order, angle in degrees. Without a pool the string is
+	   streamed; with one it's materialized, pre-scanned for the bracket pairs worth a task, and the tasks run
+	   level by level (a task hands the large subtrees it meets to the next level with the turtle at their
+	   '['). The result is the same either way, bit for bit. Unmatched ']' are ignored.
+	   previousSegments, if given, gets for each segment the index of the one whose end it starts from, the
+	   parent's last segment for a branch's first (-1 at the root or after an undrawn F); a fork's segments
+	   share theirs. Meshes join segments into tubes by it. */
+	static std::vector<SegmentInstance> Interpret(const LSystem& system, const TurtleState& initialTurtleState, float angle, float scaleFactor,
+		TaskPool* pool = nullptr, std::vector<int>* previousSegments = nullptr)
+	{
+		Turtle turtle(initialTurtleState, angle, scaleFactor);
+		TurtleOutput output;
+
+		if (!pool || pool->GetThreadCount() == 1)
+		{
+			BranchState branch = turtle.Start();
+			std::vector<BranchState> stack;
+			for (LSystem::Cursor cursor = system.Begin(); !cursor.Done(); cursor.Next())
+				turtle.Step(cursor.Get(), cursor.GetPosition(), branch, stack, output);
+		}
+		else
+		{
+			std::string symbols = system.MaterializeParallel(*pool);
+			size_t taskSize = std::max<size_t>(symbols.size() / (static_cast<size_t>(pool->GetThreadCount()) * 16), 4096);
+			std::vector<std::pair<size_t, size_t>> subtrees = FindSubtrees(symbols, taskSize);
+
+			std::vector<TurtleTask> tasks(1);
+			tasks[0].begin = 0;
+			tasks[0].end = symbols.size();
+			tasks[0].entry = turtle.Start();
+			for (size_t levelBegin = 0; levelBegin < tasks.size(); )
+			{
+				size_t levelEnd = tasks.size();
+				pool->ParallelFor(static_cast<int>(levelEnd - levelBegin), 1, [&](int begin, int end, int)
+				{
+					for (int i = begin; i < end; i++)
+						turtle.Run(symbols, subtrees, tasks[levelBegin + i]);
+				});
+				// indexed, since adding tasks moves them
+				for (size_t i = levelBegin; i < levelEnd; i++)
+					for (size_t child = 0; child < tasks[i].children.size(); child++)
+					{
+						TurtleTask task;
+						task.begin = tasks[i].children[child].begin;
+						task.end = tasks[i].children[child].end;
+						task.entry = tasks[i].children[child].entry;
+						tasks[i].children[child].task = tasks.size();
+						tasks.push_back(std::move(task));
+					}
+				levelBegin = levelEnd;
+			}
+
+			size_t segmentCount = 0;
+			for (const TurtleTask& task : tasks)
+			{
+				segmentCount += task.output.segments.size();
+				output.maxDistance = glm::max(output.maxDistance, task.output.maxDistance);
+			}
+			output.segments.reserve(segmentCount);
+			output.positions.reserve(segmentCount);
+			output.previousPositions.reserve(segmentCount);
+			Splice(tasks, 0, output);
+		}
+
+		// birth in path length from the root -> fraction of the longest path
+		if (output.maxDistance > 0.0f)
+			for (SegmentInstance& segment : output.segments)
+				segment.birth /= output.maxDistance;
+
+		// segments are in string order, so their F positions are sorted
+		if (previousSegments)
+		{
+			previousSegments->resize(output.segments.size());
+			for (size_t i = 0; i < output.segments.size(); i++)
+				(*previousSegments)[i] = output.previousPositions[i] == SIZE_MAX ? -1 : static_cast<int>(
+					std::lower_bound(output.positions.begin(), output.positions.end(), output.previousPositions[i]) - output.positions.begin());
+		}
+		return std::move(output.segments);
+	}
+
+private:
+	// Turtle position, orientation (taking x, y, z to right, direction, up) and sizes, plus what the segments
+	// of the current branch inherit
+	struct BranchState
+	{
+		glm::vec3 position;
+		glm::quat orientation;
+		float length;
+		float thickness;
+		glm::vec4 windCos;
+		glm::vec4 windSin;
+		float distance;     // path length from the root
+		size_t lastSegment; // string position of the F that ended at position, SIZE_MAX for none
+	};
+
+	// Segments with the string positions of their F and of the F they continue from (SIZE_MAX for none)
+	struct TurtleOutput
+	{
+		std::vector<SegmentInstance> segments;
+		std::vector<size_t> positions;
+		std::vector<size_t> previousPositions;
+		float maxDistance = 0.0f;
+	};
+
+	// A large subtree met by a task: the symbols strictly inside its brackets and the turtle inside them
+	struct SubtreeStart
+	{
+		size_t segment; // where its segments go among its parent's
+		size_t begin;
+		size_t end;
+		BranchState entry;
+		size_t task;
+	};
+
+	struct TurtleTask
+	{
+		size_t begin = 0;
+		size_t end = 0;
+		BranchState entry;
+		TurtleOutput output;
+		std::vector<SubtreeStart> children; // in string order
+	};
+
+	// The six turns are fixed rotations in the turtle's own frame, so they're built once per interpretation
+	class Turtle
+	{
+	public:
+		Turtle(const TurtleState& initialTurtleState, float angle, float scaleFactor)
+			: m_Initial(initialTurtleState), m_ScaleFactor(scaleFactor)
+		{
+			float radians = glm::radians(angle);
+			m_Turns[0] = glm::angleAxis(radians, glm::vec3(0.0f, 0.0f, 1.0f));  // '+' yaw about up
+			m_Turns[1] = glm::angleAxis(-radians, glm::vec3(0.0f, 0.0f, 1.0f)); // '-'
+			m_Turns[2] = glm::angleAxis(radians, glm::vec3(1.0f, 0.0f, 0.0f));  // '&' pitch about right
+			m_Turns[3] = glm::angleAxis(-radians, glm::vec3(1.0f, 0.0f, 0.0f)); // '^'
+			m_Turns[4] = glm::angleAxis(radians, glm::vec3(0.0f, 1.0f, 0.0f));  // '\' roll about direction
+			m_Turns[5] = glm::angleAxis(-radians, glm::vec3(0.0f, 1.0f, 0.0f)); // '/'
+		}
+
+		BranchState Start() const
+		{
+			glm::vec3 direction = glm::normalize(m_Initial.direction);
+			glm::vec3 right = glm::normalize(glm::cross(direction, m_Initial.up));
+			glm::vec3 up = glm::cross(right, direction);
+
+			BranchState branch;
+			branch.position = m_Initial.position;
+			branch.orientation = glm::normalize(glm::quat_cast(glm::mat3(right, direction, up)));
+			branch.length = m_Initial.length;
+			branch.thickness = m_Initial.thickness;
+			branch.windCos = glm::vec4(0.0f);
+			branch.windSin = glm::vec4(0.0f);
+			branch.distance = 0.0f;
+			branch.lastSegment = SIZE_MAX;
+			AddWindPivot(branch, branch.position, SIZE_MAX); // the whole tree sways about its base
+			return branch;
+		}
+
+		// position is the symbol's in the string
+		void Step(char symbol, size_t position, BranchState& branch, std::vector<BranchState>& stack, TurtleOutput& output) const
+		{
+			switch (symbol)
+			{
+			case 'F': // Draw a line segment and move forward
+			{
+				glm::vec3 direction = branch.orientation * glm::vec3(0.0f, 1.0f, 0.0f);
+				if (branch.length > 0.001f && branch.thickness > 0.001f)
+				{
+					// translate * rotate * scale, with the segment cube's y axis turned onto the direction the
+					// shortest way: half that rotation as a quaternion is (1 + cos, axis * sin), no trigonometry
+					const glm::vec3 segmentDefaultUp = glm::vec3(0.0f, 1.0f, 0.0f);
+					glm::mat3 rotation(1.0f);
+					glm::vec3 rotationAxis = glm::cross(segmentDefaultUp, direction);
+					if (glm::length(rotationAxis) > 0.001f)
+						rotation = glm::mat3_cast(glm::normalize(glm::quat(1.0f + glm::dot(segmentDefaultUp, direction), rotationAxis)));
+					else if (direction.y < 0.0f)
+						rotation = glm::mat3(glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)); // straight down: half a turn about x
+
+					SegmentInstance segment;
+					segment.model = glm::mat4(glm::vec4(rotation[0] * branch.thickness, 0.0f), glm::vec4(rotation[1] * branch.length, 0.0f),
+						glm::vec4(rotation[2] * branch.thickness, 0.0f), glm::vec4(branch.position, 1.0f));
+					segment.windCos = branch.windCos;
+					segment.windSin = branch.windSin;
+					segment.birth = glm::vec2(branch.distance, branch.distance + branch.length);
+					output.segments.push_back(segment);
+					output.positions.push_back(position);
+					output.previousPositions.push_back(branch.lastSegment);
+					branch.lastSegment = position;
+				}
+				else
+					branch.lastSegment = SIZE_MAX; // a gap breaks the chain
+				branch.position += direction * branch.length;
+				branch.distance += branch.length;
+				output.maxDistance = glm::max(output.maxDistance, branch.distance);
+			}
+			break;
+			case '+': Turn(branch, 0); break;
+			case '-': Turn(branch, 1); break;
+			case '&': Turn(branch, 2); break;
+			case '^': Turn(branch, 3); break;
+			case '\\': Turn(branch, 4); break;
+			case '/': Turn(branch, 5); break;
+			case '[':
+				stack.push_back(branch);
+				OpenBranch(branch, position);
+				break;
+			case ']':
+				if (!stack.empty())
+				{
+					branch = stack.back();
+					stack.pop_back();
+				}
+				break;
+			}
+		}
+
+		// Interprets the task's range, skipping the large subtrees in it after recording where they start
+		void Run(const std::string& symbols, const std::vector<std::pair<size_t, size_t>>& subtrees, TurtleTask& task) const
+		{
+			BranchState branch = task.entry;
+			std::vector<BranchState> stack;
+			// subtrees are sorted by their '[': the next one in range is the first starting at or after begin
+			size_t next = std::lower_bound(subtrees.begin(), subtrees.end(), std::make_pair(task.begin, size_t(0))) - subtrees.begin();
+			for (size_t i = task.begin; i < task.end; i++)
+			{
+				if (next < subtrees.size() && subtrees[next].first == i)
+				{
+					SubtreeStart child;
+					child.segment = task.output.segments.size();
+					child.begin = i + 1;
+					child.end = subtrees[next].second;
+					child.entry = branch;
+					OpenBranch(child.entry, i);
+					child.task = 0;
+					task.children.push_back(child);
+					// the ']' restores the turtle, so carry on after it as if the subtree had been read;
+					// the subtrees nested in it are the child's
+					i = child.end;
+					while (next < subtrees.size() && subtrees[next].first < child.end)
+						next++;
+					continue;
+				}
+				Step(symbols[i], i, branch, stack, task.output);
+			}
+		}
+
+	private:
+		void Turn(BranchState& branch, int turn) const
+		{
+			branch.orientation = glm::normalize(branch.orientation * m_Turns[turn]);
+		}
+
+		// What the '[' at position does besides saving the turtle
+		void OpenBranch(BranchState& branch, size_t position) const
+		{
+			branch.length *= m_ScaleFactor;
+			branch.thickness *= m_ScaleFactor;
+			AddWindPivot(branch, branch.position, position);
+		}
+
+		TurtleState m_Initial;
+		float m_ScaleFactor;
+		glm::quat m_Turns[6];
+	};
+
+	// Bracket pairs enclosing at least minimumSize symbols, sorted by their '['
+	static std::vector<std::pair<size_t, size_t>> FindSubtrees(const std::string& symbols, size_t minimumSize)
+	{
+		std::vector<std::pair<size_t, size_t>> subtrees;
+		std::vector<size_t> opens;
+		for (size_t i = 0; i < symbols.size(); i++)
+		{
+			if (symbols[i] == '[')
+				opens.push_back(i);
+			else if (symbols[i] == ']' && !opens.empty())
+			{
+				if (i - opens.back() > minimumSize)
+					subtrees.push_back(std::make_pair(opens.back(), i));
+				opens.pop_back();
+			}
+		}
+		std::sort(subtrees.begin(), subtrees.end());
+		return subtrees;
+	}
+
+	// Appends a task's segments with its children's spliced in where they were met
+	static void Splice(const std::vector<TurtleTask>& tasks, size_t index, TurtleOutput& output)
+	{
+		const TurtleTask& task = tasks[index];
+		size_t copied = 0;
+		for (const SubtreeStart& child : task.children)
+		{
+			Append(task.output, copied, child.segment, output);
+			copied = child.segment;
+			Splice(tasks, child.task, output);
+		}
+		Append(task.output, copied, task.output.segments.size(), output);
+	}
+
+	static void Append(const TurtleOutput& source, size_t begin, size_t end, TurtleOutput& output)
+	{
+		output.segments.insert(output.segments.end(), source.segments.begin() + begin, source.segments.begin() + end);
+		output.positions.insert(output.positions.end(), source.positions.begin() + begin, source.positions.begin() + end);
+		output.previousPositions.insert(output.previousPositions.end(), source.previousPositions.begin() + begin, source.previousPositions.begin() + end);
+	}
+
+	static void AttachAttribute(unsigned int location, int size, size_t offset)
+	{
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, sizeof(SegmentInstance), (void*)offset);
+		glVertexAttribDivisor(location, 1);
+	}
+
+	static bool SameState(const TurtleState& a, const TurtleState& b)
+	{
+		return a.position == b.position && a.direction == b.direction && a.up == b.up && a.right == b.right
+			&& a.length == b.length && a.thickness == b.thickness;
+	}
+
+	// Adds a branch starting at pivot to the wind sums, with a phase hashed from the string position of its '['
+	// so it varies from branch to branch but not with rounding
+	static void AddWindPivot(BranchState& branch, const glm::vec3& pivot, size_t position)
+	{
+		uint64_t hash = static_cast<uint64_t>(position) * 0x9E3779B97F4A7C15ull;
+		hash ^= hash >> 29;
+		hash *= 0xBF58476D1CE4E5B9ull;
+		hash ^= hash >> 32;
+		float phase = static_cast<float>(hash >> 40) / 16777216.0f * glm::two_pi<float>();
+		branch.windCos += std::cos(phase) * glm::vec4(pivot, 1.0f);
+		branch.windSin += std::sin(phase) * glm::vec4(pivot, 1.0f);
+	}
+
+	unsigned int m_InstanceVBO = 0;
+	std::vector<SegmentInstance> m_Segments;
+	std::vector<int> m_PreviousSegments;
+
+	// What the instances were built from
+	bool m_Built = false;
+	uint64_t m_Version = 0;
+	TurtleState m_InitialState;
+	float m_Angle = 0.0f;
+	float m_ScaleFactor = 0.0f;
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+/* Read-only memory mapping of a whole file. Pages are loaded by the OS on first touch, so opening is
+   cheap and data is used in place instead of being read into separate buffers. */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile() { Close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const std::string& path)
+	{
+		Close();
+#ifdef _WIN32
+		m_File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (m_File == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(m_File, &size) || size.QuadPart == 0)
+		{
+			Close();
+			return false;
+		}
+		m_Mapping = CreateFileMappingA(m_File, NULL, PAGE_READONLY, 0, 0, NULL);
+		m_Data = m_Mapping ? MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+		m_Size = static_cast<size_t>(size.QuadPart);
+#else
+		int file = open(path.c_str(), O_RDONLY);
+		if (file < 0)
+			return false;
+		struct stat info;
+		if (fstat(file, &info) != 0 || info.st_size == 0)
+		{
+			close(file);
+			return false;
+		}
+		m_Size = static_cast<size_t>(info.st_size);
+		void* data = mmap(NULL, m_Size, PROT_READ, MAP_PRIVATE, file, 0);
+		close(file); // the mapping keeps the file alive
+		m_Data = data == MAP_FAILED ? NULL : data;
+#endif
+		if (!m_Data)
+		{
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void Close()
+	{
+#ifdef _WIN32
+		if (m_Data)
+			UnmapViewOfFile(m_Data);
+		if (m_Mapping)
+			CloseHandle(m_Mapping);
+		if (m_File != INVALID_HANDLE_VALUE)
+			CloseHandle(m_File);
+		m_Mapping = NULL;
+		m_File = INVALID_HANDLE_VALUE;
+#else
+		if (m_Data)
+			munmap(m_Data, m_Size);
+#endif
+		m_Data = NULL;
+		m_Size = 0;
+	}
+
+	const void* Data() const { return m_Data; }
+	size_t Size() const { return m_Size; }
+	bool IsOpen() const { return m_Data != NULL; }
+
+	// Modification time and size of a file, for cheap staleness checks; false if it doesn't exist
+	static bool GetFileStamp(const std::string& path, int64_t& modified, int64_t& size)
+	{
+#ifdef _WIN32
+		struct _stat64 info;
+		if (_stat64(path.c_str(), &info) != 0)
+			return false;
+#else
+		struct stat info;
+		if (stat(path.c_str(), &info) != 0)
+			return false;
+#endif
+		modified = static_cast<int64_t>(info.st_mtime);
+		size = static_cast<int64_t>(info.st_size);
+		return true;
+	}
+
+private:
+	void* m_Data = NULL;
+	size_t m_Size = 0;
+#ifdef _WIN32
+	HANDLE m_File = INVALID_HANDLE_VALUE;
+	HANDLE m_Mapping = NULL;
+#endif
+};
@@ -0,0 +1,270 @@
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <unordered_map>
+
+// uniform traffic of every Shader since the program started; take the difference of two snapshots to profile
+// a frame
+struct ShaderStats
+{
+    unsigned long long uniformCalls = 0;    // glUniform* calls
+    unsigned long long nameLookups = 0;     // setters (or getUniformLocation) given a name instead of a location
+    unsigned long long locationQueries = 0; // glGetUniformLocation calls, once per name and program
+};
+
+class Shader
+{
+public:
+    unsigned int ID;
+    // constructor generates the shader on the fly
+    // ------------------------------------------------------------------------
+    Shader(const char* vertexPath, const char* fragmentPath)
+    {
+        // 1. retrieve the vertex/fragment source code from filePath
+        std::string vertexCode;
+        std::string fragmentCode;
+        std::ifstream vShaderFile;
+        std::ifstream fShaderFile;
+        // ensure ifstream objects can throw exceptions:
+        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+        try
+        {
+            // open files
+            vShaderFile.open(vertexPath);
+            fShaderFile.open(fragmentPath);
+            std::stringstream vShaderStream, fShaderStream;
+            // read file's buffer contents into streams
+            vShaderStream << vShaderFile.rdbuf();
+            fShaderStream << fShaderFile.rdbuf();
+            // close file handlers
+            vShaderFile.close();
+            fShaderFile.close();
+            // convert stream into string
+            vertexCode = vShaderStream.str();
+            fragmentCode = fShaderStream.str();
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+        }
+        const char* vShaderCode = vertexCode.c_str();
+        const char * fShaderCode = fragmentCode.c_str();
+        // 2. compile shaders
+        unsigned int vertex, fragment;
+        // vertex shader
+        vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertex, 1, &vShaderCode, NULL);
+        glCompileShader(vertex);
+        checkCompileErrors(vertex, "VERTEX");
+        // fragment Shader
+        fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragment, 1, &fShaderCode, NULL);
+        glCompileShader(fragment);
+        checkCompileErrors(fragment, "FRAGMENT");
+        // shader Program
+        ID = glCreateProgram();
+        glAttachShader(ID, vertex);
+        glAttachShader(ID, fragment);
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+        // delete the shaders as they're linked into our program now and no longer necessary
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+
+    }
+    // activate the shader
+    // ------------------------------------------------------------------------
+    void use() const
+    {
+        glUseProgram(ID);
+    }
+    // location of a uniform, queried from GL the first time each name is asked for and cached with the program;
+    // -1 for names the program doesn't have (or optimized away), which every setter ignores. Resolve the
+    // uniforms set every frame once and pass the locations to the setters below to skip the lookup.
+    // ------------------------------------------------------------------------
+    GLint getUniformLocation(const std::string &name) const
+    {
+        stats().nameLookups++;
+        std::unordered_map<std::string, GLint>::const_iterator cached = uniformLocations.find(name);
+        if (cached != uniformLocations.end())
+            return cached->second;
+        stats().locationQueries++;
+        GLint location = glGetUniformLocation(ID, name.c_str());
+        uniformLocations.emplace(name, location);
+        return location;
+    }
+    // points the program's std140 uniform block at a binding point, where a buffer is bound with
+    // glBindBufferBase (see uniform_buffer.h); false if the program has no such block
+    // ------------------------------------------------------------------------
+    bool bindUniformBlock(const std::string &blockName, unsigned int bindingPoint) const
+    {
+        unsigned int blockIndex = glGetUniformBlockIndex(ID, blockName.c_str());
+        if (blockIndex == GL_INVALID_INDEX)
+            return false;
+        glUniformBlockBinding(ID, blockIndex, bindingPoint);
+        return true;
+    }
+    static ShaderStats& stats()
+    {
+        static ShaderStats shaderStats;
+        return shaderStats;
+    }
+    // utility uniform functions, by name
+    // ------------------------------------------------------------------------
+    void setBool(const std::string &name, bool value) const
+    {
+        setBool(getUniformLocation(name), value);
+    }
+    // ------------------------------------------------------------------------
+    void setInt(const std::string &name, int value) const
+    {
+        setInt(getUniformLocation(name), value);
+    }
+    // ------------------------------------------------------------------------
+    void setFloat(const std::string &name, float value) const
+    {
+        setFloat(getUniformLocation(name), value);
+    }
+    // ------------------------------------------------------------------------
+    void setVec2(const std::string &name, const glm::vec2 &value) const
+    {
+        setVec2(getUniformLocation(name), value);
+    }
+    void setVec2(const std::string &name, float x, float y) const
+    {
+        setVec2(getUniformLocation(name), x, y);
+    }
+    // ------------------------------------------------------------------------
+    void setVec3(const std::string &name, const glm::vec3 &value) const
+    {
+        setVec3(getUniformLocation(name), value);
+    }
+    void setVec3(const std::string &name, float x, float y, float z) const
+    {
+        setVec3(getUniformLocation(name), x, y, z);
+    }
+    // ------------------------------------------------------------------------
+    void setVec4(const std::string &name, const glm::vec4 &value) const
+    {
+        setVec4(getUniformLocation(name), value);
+    }
+    void setVec4(const std::string &name, float x, float y, float z, float w) const
+    {
+        setVec4(getUniformLocation(name), x, y, z, w);
+    }
+    // ------------------------------------------------------------------------
+    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    {
+        setMat2(getUniformLocation(name), mat);
+    }
+    // ------------------------------------------------------------------------
+    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    {
+        setMat3(getUniformLocation(name), mat);
+    }
+    // ------------------------------------------------------------------------
+    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    {
+        setMat4(getUniformLocation(name), mat);
+    }
+    // utility uniform functions, by location from getUniformLocation
+    // ------------------------------------------------------------------------
+    void setBool(GLint location, bool value) const
+    {
+        stats().uniformCalls++;
+        glUniform1i(location, (int)value);
+    }
+    void setInt(GLint location, int value) const
+    {
+        stats().uniformCalls++;
+        glUniform1i(location, value);
+    }
+    void setFloat(GLint location, float value) const
+    {
+        stats().uniformCalls++;
+        glUniform1f(location, value);
+    }
+    void setVec2(GLint location, const glm::vec2 &value) const
+    {
+        stats().uniformCalls++;
+        glUniform2fv(location, 1, &value[0]);
+    }
+    void setVec2(GLint location, float x, float y) const
+    {
+        stats().uniformCalls++;
+        glUniform2f(location, x, y);
+    }
+    void setVec3(GLint location, const glm::vec3 &value) const
+    {
+        stats().uniformCalls++;
+        glUniform3fv(location, 1, &value[0]);
+    }
+    void setVec3(GLint location, float x, float y, float z) const
+    {
+        stats().uniformCalls++;
+        glUniform3f(location, x, y, z);
+    }
+    void setVec4(GLint location, const glm::vec4 &value) const
+    {
+        stats().uniformCalls++;
+        glUniform4fv(location, 1, &value[0]);
+    }
+    void setVec4(GLint location, float x, float y, float z, float w) const
+    {
+        stats().uniformCalls++;
+        glUniform4f(location, x, y, z, w);
+    }
+    void setMat2(GLint location, const glm::mat2 &mat) const
+    {
+        stats().uniformCalls++;
+        glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat3(GLint location, const glm::mat3 &mat) const
+    {
+        stats().uniformCalls++;
+        glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat4(GLint location, const glm::mat4 &mat) const
+    {
+        stats().uniformCalls++;
+        glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
+    }
+
+private:
+    mutable std::unordered_map<std::string, GLint> uniformLocations;
+
+    // utility function for checking shader compilation/linking errors.
+    // ------------------------------------------------------------------------
+    void checkCompileErrors(GLuint shader, std::string type)
+    {
+        GLint success;
+        GLchar infoLog[1024];
+        if(type != "PROGRAM")
+        {
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+            if(!success)
+            {
+                glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+                std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+            }
+        }
+        else
+        {
+            glGetProgramiv(shader, GL_LINK_STATUS, &success);
+            if(!success)
+            {
+                glGetProgramInfoLog(shader, 1024, NULL, infoLog);
+                std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+            }
+        }
+    }
+};
+#endif
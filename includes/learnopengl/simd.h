@@ -0,0 +1,253 @@
+#pragma once
+
+/* Thin wrapper over the widest float vector the compiler targets (AVX, SSE2 or plain scalar),
+   so batch kernels are written once and run 8, 4 or 1 lanes at a time */
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define LEARNOPENGL_SIMD_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LEARNOPENGL_SIMD_SSE
+#endif
+
+#if defined(LEARNOPENGL_SIMD_AVX)
+
+struct SimdFloat
+{
+	static const int Width = 8;
+	__m256 v;
+
+	SimdFloat() = default;
+	SimdFloat(__m256 value) : v(value) {}
+
+	static SimdFloat Set1(float value) { return _mm256_set1_ps(value); }
+	static SimdFloat Load(const float* p) { return _mm256_load_ps(p); }
+	static SimdFloat LoadUnaligned(const float* p) { return _mm256_loadu_ps(p); }
+	void Store(float* p) const { _mm256_store_ps(p, v); }
+	void StoreUnaligned(float* p) const { _mm256_storeu_ps(p, v); }
+};
+
+inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return _mm256_add_ps(a.v, b.v); }
+inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return _mm256_sub_ps(a.v, b.v); }
+inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return _mm256_mul_ps(a.v, b.v); }
+inline SimdFloat operator/(SimdFloat a, SimdFloat b) { return _mm256_div_ps(a.v, b.v); }
+inline SimdFloat SimdMin(SimdFloat a, SimdFloat b) { return _mm256_min_ps(a.v, b.v); }
+inline SimdFloat SimdMax(SimdFloat a, SimdFloat b) { return _mm256_max_ps(a.v, b.v); }
+inline SimdFloat SimdSqrt(SimdFloat a) { return _mm256_sqrt_ps(a.v); }
+inline SimdFloat SimdAbs(SimdFloat a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+inline SimdFloat SimdFloor(SimdFloat a) { return _mm256_floor_ps(a.v); }
+// Takes the sign bit of s and applies it to a
+inline SimdFloat SimdXorSign(SimdFloat a, SimdFloat s) { return _mm256_xor_ps(a.v, _mm256_and_ps(s.v, _mm256_set1_ps(-0.0f))); }
+// Lane-wise mask ? a : b, where mask comes from a comparison
+inline SimdFloat SimdSelect(SimdFloat mask, SimdFloat a, SimdFloat b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+inline SimdFloat SimdLess(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+// Bit i set where lane i of a comparison mask is true
+inline int SimdMoveMask(SimdFloat mask) { return _mm256_movemask_ps(mask.v); }
+
+#elif defined(LEARNOPENGL_SIMD_SSE)
+
+struct SimdFloat
+{
+	static const int Width = 4;
+	__m128 v;
+
+	SimdFloat() = default;
+	SimdFloat(__m128 value) : v(value) {}
+
+	static SimdFloat Set1(float value) { return _mm_set1_ps(value); }
+	static SimdFloat Load(const float* p) { return _mm_load_ps(p); }
+	static SimdFloat LoadUnaligned(const float* p) { return _mm_loadu_ps(p); }
+	void Store(float* p) const { _mm_store_ps(p, v); }
+	void StoreUnaligned(float* p) const { _mm_storeu_ps(p, v); }
+};
+
+inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return _mm_add_ps(a.v, b.v); }
+inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return _mm_sub_ps(a.v, b.v); }
+inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return _mm_mul_ps(a.v, b.v); }
+inline SimdFloat operator/(SimdFloat a, SimdFloat b) { return _mm_div_ps(a.v, b.v); }
+inline SimdFloat SimdMin(SimdFloat a, SimdFloat b) { return _mm_min_ps(a.v, b.v); }
+inline SimdFloat SimdMax(SimdFloat a, SimdFloat b) { return _mm_max_ps(a.v, b.v); }
+inline SimdFloat SimdSqrt(SimdFloat a) { return _mm_sqrt_ps(a.v); }
+inline SimdFloat SimdAbs(SimdFloat a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+// SSE2 has no round instruction; truncate and correct the negative lanes
+inline SimdFloat SimdFloor(SimdFloat a)
+{
+	__m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+	return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, a.v), _mm_set1_ps(1.0f)));
+}
+inline SimdFloat SimdXorSign(SimdFloat a, SimdFloat s) { return _mm_xor_ps(a.v, _mm_and_ps(s.v, _mm_set1_ps(-0.0f))); }
+inline SimdFloat SimdSelect(SimdFloat mask, SimdFloat a, SimdFloat b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+inline SimdFloat SimdLess(SimdFloat a, SimdFloat b) { return _mm_cmplt_ps(a.v, b.v); }
+inline int SimdMoveMask(SimdFloat mask) { return _mm_movemask_ps(mask.v); }
+
+#else
+
+struct SimdFloat
+{
+	static const int Width = 1;
+	float v;
+
+	SimdFloat() = default;
+	SimdFloat(float value) : v(value) {}
+
+	static SimdFloat Set1(float value) { return value; }
+	static SimdFloat Load(const float* p) { return *p; }
+	static SimdFloat LoadUnaligned(const float* p) { return *p; }
+	void Store(float* p) const { *p = v; }
+	void StoreUnaligned(float* p) const { *p = v; }
+};
+
+inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return a.v + b.v; }
+inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return a.v - b.v; }
+inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return a.v * b.v; }
+inline SimdFloat operator/(SimdFloat a, SimdFloat b) { return a.v / b.v; }
+inline SimdFloat SimdMin(SimdFloat a, SimdFloat b) { return a.v < b.v ? a.v : b.v; }
+inline SimdFloat SimdMax(SimdFloat a, SimdFloat b) { return a.v > b.v ? a.v : b.v; }
+inline SimdFloat SimdSqrt(SimdFloat a) { return std::sqrt(a.v); }
+inline SimdFloat SimdAbs(SimdFloat a) { return std::fabs(a.v); }
+inline SimdFloat SimdFloor(SimdFloat a) { return std::floor(a.v); }
+inline SimdFloat SimdXorSign(SimdFloat a, SimdFloat s) { return std::signbit(s.v) ? -a.v : a.v; }
+// Scalar "masks" are 1.0f (true) or 0.0f (false)
+inline SimdFloat SimdSelect(SimdFloat mask, SimdFloat a, SimdFloat b) { return mask.v != 0.0f ? a.v : b.v; }
+inline SimdFloat SimdLess(SimdFloat a, SimdFloat b) { return a.v < b.v ? 1.0f : 0.0f; }
+inline int SimdMoveMask(SimdFloat mask) { return mask.v != 0.0f ? 1 : 0; }
+
+#endif
+
+/* Always four lanes, for kernels that work one glm::vec4 (a matrix column, a point) at a time rather than
+   across a batch; AVX builds use its SSE half */
+#if defined(LEARNOPENGL_SIMD_AVX) || defined(LEARNOPENGL_SIMD_SSE)
+
+struct SimdFloat4
+{
+	__m128 v;
+
+	SimdFloat4() = default;
+	SimdFloat4(__m128 value) : v(value) {}
+
+	static SimdFloat4 Set1(float value) { return _mm_set1_ps(value); }
+	static SimdFloat4 LoadUnaligned(const float* p) { return _mm_loadu_ps(p); }
+	void StoreUnaligned(float* p) const { _mm_storeu_ps(p, v); }
+};
+
+inline SimdFloat4 operator+(SimdFloat4 a, SimdFloat4 b) { return _mm_add_ps(a.v, b.v); }
+inline SimdFloat4 operator*(SimdFloat4 a, SimdFloat4 b) { return _mm_mul_ps(a.v, b.v); }
+
+#else
+
+struct SimdFloat4
+{
+	float v[4];
+
+	static SimdFloat4 Set1(float value) { return { { value, value, value, value } }; }
+	static SimdFloat4 LoadUnaligned(const float* p) { return { { p[0], p[1], p[2], p[3] } }; }
+	void StoreUnaligned(float* p) const { p[0] = v[0]; p[1] = v[1]; p[2] = v[2]; p[3] = v[3]; }
+};
+
+inline SimdFloat4 operator+(SimdFloat4 a, SimdFloat4 b) { return { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } }; }
+inline SimdFloat4 operator*(SimdFloat4 a, SimdFloat4 b) { return { { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } }; }
+
+#endif
+
+// Rounds a count up to a whole number of SIMD lanes
+inline int SimdPad(int count)
+{
+	return (count + SimdFloat::Width - 1) / SimdFloat::Width * SimdFloat::Width;
+}
+
+/* Sine and cosine of x radians, within 4e-6 for |x| up to a few thousand: x is taken to r in [-pi/2, pi/2]
+   about the nearest multiple q of pi, where Taylor series to r^9 and r^10 are close enough, and both change
+   sign for odd q */
+inline void SimdSinCos(SimdFloat x, SimdFloat& sine, SimdFloat& cosine)
+{
+	SimdFloat q = SimdFloor(x * SimdFloat::Set1(0.318309886f) + SimdFloat::Set1(0.5f));
+	// pi in two parts, the first exact in a few bits, so q * pi rounds away next to nothing
+	SimdFloat r = (x - q * SimdFloat::Set1(3.140625f)) - q * SimdFloat::Set1(9.67653589793e-4f);
+	SimdFloat r2 = r * r;
+	SimdFloat s = SimdFloat::Set1(2.75573192e-6f);
+	s = s * r2 + SimdFloat::Set1(-1.98412698e-4f);
+	s = s * r2 + SimdFloat::Set1(8.33333333e-3f);
+	s = s * r2 + SimdFloat::Set1(-1.66666667e-1f);
+	s = (s * r2) * r + r;
+	SimdFloat c = SimdFloat::Set1(-2.75573192e-7f);
+	c = c * r2 + SimdFloat::Set1(2.48015873e-5f);
+	c = c * r2 + SimdFloat::Set1(-1.38888889e-3f);
+	c = c * r2 + SimdFloat::Set1(4.16666667e-2f);
+	c = c * r2 + SimdFloat::Set1(-0.5f);
+	c = c * r2 + SimdFloat::Set1(1.0f);
+	SimdFloat odd = q - SimdFloat::Set1(2.0f) * SimdFloor(q * SimdFloat::Set1(0.5f));
+	SimdFloat sign = SimdFloat::Set1(1.0f) - SimdFloat::Set1(2.0f) * odd;
+	sine = s * sign;
+	cosine = c * sign;
+}
+
+/* Owning float/int storage aligned for SimdFloat::Load, used by the structure-of-arrays containers */
+class AlignedBuffer
+{
+public:
+	static const size_t Alignment = 32;
+
+	AlignedBuffer() = default;
+	explicit AlignedBuffer(size_t bytes) { Resize(bytes); }
+	AlignedBuffer(const AlignedBuffer& other) { *this = other; }
+	AlignedBuffer(AlignedBuffer&& other) noexcept : m_Data(other.m_Data), m_Size(other.m_Size) { other.m_Data = nullptr; other.m_Size = 0; }
+	~AlignedBuffer() { Release(); }
+
+	AlignedBuffer& operator=(const AlignedBuffer& other)
+	{
+		if (this != &other)
+		{
+			Resize(other.m_Size);
+			for (size_t i = 0; i < m_Size; i++)
+				m_Data[i] = other.m_Data[i];
+		}
+		return *this;
+	}
+
+	AlignedBuffer& operator=(AlignedBuffer&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Release();
+			m_Data = other.m_Data;
+			m_Size = other.m_Size;
+			other.m_Data = nullptr;
+			other.m_Size = 0;
+		}
+		return *this;
+	}
+
+	// Contents are zeroed
+	void Resize(size_t bytes)
+	{
+		Release();
+		if (bytes == 0)
+			return;
+		m_Data = static_cast<unsigned char*>(::operator new(bytes, std::align_val_t(Alignment)));
+		m_Size = bytes;
+		for (size_t i = 0; i < m_Size; i++)
+			m_Data[i] = 0;
+	}
+
+	template <typename T> T* As(size_t byteOffset = 0) { return reinterpret_cast<T*>(m_Data + byteOffset); }
+	template <typename T> const T* As(size_t byteOffset = 0) const { return reinterpret_cast<const T*>(m_Data + byteOffset); }
+	size_t Size() const { return m_Size; }
+
+private:
+	void Release()
+	{
+		if (m_Data)
+			::operator delete(m_Data, std::align_val_t(Alignment));
+		m_Data = nullptr;
+		m_Size = 0;
+	}
+
+	unsigned char* m_Data = nullptr;
+	size_t m_Size = 0;
+};
@@ -0,0 +1,188 @@
+#pragma once
+
+/* Flattened node hierarchy, compiled once so that a pose update is a single linear pass. A Skeleton is an
+   immutable asset loaded once per model (hierarchy, bind pose, inverse bind matrices, node names) and shared
+   through std::shared_ptr<const Skeleton> by every animator of that model, which then only keeps its own
+   playback state and palette. */
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/quaternion.hpp>
+#include <learnopengl/animation.h>
+#include <learnopengl/bone.h>
+
+// A node's transform relative to its parent, split so that poses can be blended component-wise
+struct LocalTransform
+{
+	glm::vec3 position;
+	glm::quat rotation;
+	glm::vec3 scale;
+};
+
+inline LocalTransform DecomposeTransform(const glm::mat4& transform)
+{
+	LocalTransform local;
+	local.position = glm::vec3(transform[3]);
+	local.scale = glm::vec3(glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])));
+	glm::mat3 rotation(glm::vec3(transform[0]) / local.scale.x, glm::vec3(transform[1]) / local.scale.y, glm::vec3(transform[2]) / local.scale.z);
+	local.rotation = glm::normalize(glm::quat_cast(rotation));
+	return local;
+}
+
+inline glm::mat4 ComposeTransform(const LocalTransform& local)
+{
+	return glm::translate(glm::mat4(1.0f), local.position) * glm::toMat4(local.rotation) * glm::scale(glm::mat4(1.0f), local.scale);
+}
+
+
+struct SkeletonNode
+{
+	glm::mat4 transformation; // bind pose transform relative to the parent
+	glm::mat4 offset;         // mesh space to bone space, only used when boneIndex >= 0
+	int parent;               // index of the parent node, always lower than this node's index; -1 for the root
+	int boneIndex;            // slot in the final bone matrices, -1 for nodes that don't skin any vertex
+};
+
+class Skeleton
+{
+public:
+	Skeleton() = default;
+
+	explicit Skeleton(Animation* animation)
+	{
+		const std::map<std::string, BoneInfo>& boneInfoMap = animation->GetBoneIDMap();
+		AddNode(&animation->GetRootNode(), -1, boneInfoMap);
+		// Bones the model knows but the hierarchy doesn't still need their palette slot
+		for (const auto& boneInfo : boneInfoMap)
+			m_BoneCount = glm::max(m_BoneCount, boneInfo.second.id + 1);
+		Finish();
+	}
+
+	// From nodes already in parent-before-child order, e.g. loaded from a cooked file
+	Skeleton(const std::vector<SkeletonNode>& nodes, const std::vector<std::string>& names)
+		: m_Nodes(nodes), m_Names(names)
+	{
+		for (const SkeletonNode& node : m_Nodes)
+			m_BoneCount = glm::max(m_BoneCount, node.boneIndex + 1);
+		Finish();
+	}
+
+	// Resolves the tracks of a clip against the nodes: one entry per node, nullptr where the clip doesn't animate it
+	std::vector<Bone*> BindAnimation(Animation* animation) const
+	{
+		std::vector<Bone*> tracks(m_Nodes.size(), nullptr);
+		for (size_t i = 0; i < m_Nodes.size(); i++)
+			tracks[i] = animation->FindBone(m_Names[i]);
+		return tracks;
+	}
+
+	// BindAnimation's result, worked out once per clip and shared by every animator of the skeleton. The clip
+	// must stay alive while the skeleton is used with it.
+	const std::vector<Bone*>& GetTracks(Animation* animation) const
+	{
+		std::lock_guard<std::mutex> lock(m_TracksMutex);
+		auto tracks = m_Tracks.find(animation);
+		if (tracks == m_Tracks.end())
+			tracks = m_Tracks.emplace(animation, BindAnimation(animation)).first;
+		return tracks->second;
+	}
+
+	// Forgets a clip's tracks; call before the clip is freed so a new clip at the same address isn't
+	// mistaken for it
+	void ReleaseTracks(Animation* animation) const
+	{
+		std::lock_guard<std::mutex> lock(m_TracksMutex);
+		m_Tracks.erase(animation);
+	}
+
+	const std::vector<SkeletonNode>& GetNodes() const { return m_Nodes; }
+	const std::string& GetNodeName(int index) const { return m_Names[index]; }
+	int GetNodeCount() const { return static_cast<int>(m_Nodes.size()); }
+	int GetBoneCount() const { return m_BoneCount; }
+
+	// Local transform of every node in the bind pose, split for blending
+	const std::vector<LocalTransform>& GetBindPose() const { return m_BindPose; }
+	// Mesh space to bone space per palette slot (identity for slots no node uses)
+	const std::vector<glm::mat4>& GetInverseBindMatrices() const { return m_InverseBindMatrices; }
+
+	// Node index by name, -1 if the skeleton has no such node
+	int FindNode(const std::string& name) const
+	{
+		auto node = m_NodeIndices.find(name);
+		return node != m_NodeIndices.end() ? node->second : -1;
+	}
+
+	// Heap and object bytes; paid once per model however many animators share the skeleton
+	size_t GetMemorySize() const
+	{
+		size_t size = sizeof(*this) + m_Nodes.capacity() * sizeof(SkeletonNode) + m_BindPose.capacity() * sizeof(LocalTransform)
+			+ m_InverseBindMatrices.capacity() * sizeof(glm::mat4) + m_Names.capacity() * sizeof(std::string)
+			+ m_NodeIndices.bucket_count() * sizeof(void*);
+		// Each name is held by m_Names and by a hash node of m_NodeIndices
+		for (const std::string& name : m_Names)
+			size += 2 * name.capacity() + sizeof(std::string) + sizeof(int) + 2 * sizeof(void*);
+
+		std::lock_guard<std::mutex> lock(m_TracksMutex);
+		for (const auto& tracks : m_Tracks)
+			size += tracks.second.capacity() * sizeof(Bone*) + sizeof(tracks) + 3 * sizeof(void*);
+		return size;
+	}
+
+private:
+	// Tables derived from the nodes
+	void Finish()
+	{
+		m_BindPose.clear();
+		m_InverseBindMatrices.assign(m_BoneCount, glm::mat4(1.0f));
+		for (size_t i = 0; i < m_Nodes.size(); i++)
+		{
+			m_BindPose.push_back(DecomposeTransform(m_Nodes[i].transformation));
+			if (m_Nodes[i].boneIndex >= 0)
+				m_InverseBindMatrices[m_Nodes[i].boneIndex] = m_Nodes[i].offset;
+			m_NodeIndices.emplace(m_Names[i], static_cast<int>(i));
+		}
+	}
+
+	// Depth-first pre-order, so every parent is stored before its children
+	void AddNode(const AssimpNodeData* src, int parent, const std::map<std::string, BoneInfo>& boneInfoMap)
+	{
+		SkeletonNode node;
+		node.transformation = src->transformation;
+		node.offset = glm::mat4(1.0f);
+		node.parent = parent;
+		node.boneIndex = -1;
+
+		auto boneInfo = boneInfoMap.find(src->name);
+		if (boneInfo != boneInfoMap.end())
+		{
+			node.boneIndex = boneInfo->second.id;
+			node.offset = boneInfo->second.offset;
+			m_BoneCount = glm::max(m_BoneCount, node.boneIndex + 1);
+		}
+
+		int index = static_cast<int>(m_Nodes.size());
+		m_Nodes.push_back(node);
+		m_Names.push_back(src->name);
+
+		for (int i = 0; i < src->childrenCount; i++)
+			AddNode(&src->children[i], index, boneInfoMap);
+	}
+
+	std::vector<SkeletonNode> m_Nodes;
+	std::vector<std::string> m_Names;
+	int m_BoneCount = 0;
+
+	std::vector<LocalTransform> m_BindPose;
+	std::vector<glm::mat4> m_InverseBindMatrices;
+	std::unordered_map<std::string, int> m_NodeIndices;
+
+	mutable std::mutex m_TracksMutex;
+	mutable std::map<Animation*, std::vector<Bone*>> m_Tracks;
+};
@@ -0,0 +1,174 @@
+#pragma once
+
+/* Small work-stealing thread pool for data-parallel loops. Each thread owns a queue of chunks, takes
+   work from the back of its own queue and steals from the front of the others once it runs dry. */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskPool
+{
+public:
+	// threadCount includes the calling thread, which helps out while it waits in ParallelFor
+	explicit TaskPool(int threadCount = static_cast<int>(std::thread::hardware_concurrency()))
+	{
+		if (threadCount < 1)
+			threadCount = 1;
+		for (int i = 0; i < threadCount; i++)
+			m_Queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+		for (int i = 1; i < threadCount; i++)
+			m_Threads.emplace_back(&TaskPool::WorkerLoop, this, i);
+	}
+
+	~TaskPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_WakeMutex);
+			m_Stop = true;
+		}
+		m_WakeUp.notify_all();
+		for (std::thread& thread : m_Threads)
+			thread.join();
+	}
+
+	TaskPool(const TaskPool&) = delete;
+	TaskPool& operator=(const TaskPool&) = delete;
+
+	int GetThreadCount() const { return static_cast<int>(m_Queues.size()); }
+
+	// Calls body(begin, end, threadIndex) for chunks of at most grainSize items covering [0, count) and
+	// returns once all of them have run. threadIndex is in [0, GetThreadCount()) and can index per-thread
+	// scratch memory. Meant to be called from one thread at a time.
+	template <typename Body>
+	void ParallelFor(int count, int grainSize, const Body& body)
+	{
+		if (count <= 0)
+			return;
+		if (grainSize < 1)
+			grainSize = 1;
+		if (GetThreadCount() == 1 || count <= grainSize)
+		{
+			body(0, count, 0);
+			return;
+		}
+
+		Job job;
+		job.body = &body;
+		job.invoke = [](const void* function, int begin, int end, int threadIndex)
+		{
+			(*static_cast<const Body*>(function))(begin, end, threadIndex);
+		};
+		int chunkCount = (count + grainSize - 1) / grainSize;
+		job.remaining = chunkCount;
+
+		// Deal the chunks out round-robin; stealing evens out whatever imbalance is left
+		for (int chunk = 0; chunk < chunkCount; chunk++)
+		{
+			Task task = { &job, chunk * grainSize, std::min((chunk + 1) * grainSize, count) };
+			WorkQueue& queue = *m_Queues[chunk % m_Queues.size()];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.tasks.push_back(task);
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_WakeMutex);
+			m_Pending += chunkCount;
+		}
+		m_WakeUp.notify_all();
+
+		Task task;
+		while (job.remaining.load(std::memory_order_acquire) > 0)
+		{
+			if (TakeTask(0, task))
+				Run(task, 0);
+			else
+				std::this_thread::yield();
+		}
+	}
+
+private:
+	struct Job
+	{
+		const void* body;
+		void (*invoke)(const void* body, int begin, int end, int threadIndex);
+		std::atomic<int> remaining;
+	};
+
+	struct Task
+	{
+		Job* job;
+		int begin;
+		int end;
+	};
+
+	struct WorkQueue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	void WorkerLoop(int threadIndex)
+	{
+		Task task;
+		for (;;)
+		{
+			if (TakeTask(threadIndex, task))
+			{
+				Run(task, threadIndex);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(m_WakeMutex);
+			m_WakeUp.wait(lock, [this] { return m_Stop || m_Pending > 0; });
+			if (m_Stop)
+				return;
+		}
+	}
+
+	// Own queue first (newest chunk, still warm in cache), then the oldest chunk of another thread
+	bool TakeTask(int threadIndex, Task& task)
+	{
+		int queueCount = static_cast<int>(m_Queues.size());
+		for (int i = 0; i < queueCount; i++)
+		{
+			int victim = (threadIndex + i) % queueCount;
+			WorkQueue& queue = *m_Queues[victim];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (queue.tasks.empty())
+				continue;
+			if (victim == threadIndex)
+			{
+				task = queue.tasks.back();
+				queue.tasks.pop_back();
+			}
+			else
+			{
+				task = queue.tasks.front();
+				queue.tasks.pop_front();
+			}
+			std::lock_guard<std::mutex> wakeLock(m_WakeMutex);
+			m_Pending--;
+			return true;
+		}
+		return false;
+	}
+
+	void Run(const Task& task, int threadIndex)
+	{
+		task.job->invoke(task.job->body, task.begin, task.end, threadIndex);
+		task.job->remaining.fetch_sub(1, std::memory_order_release);
+	}
+
+	std::vector<std::unique_ptr<WorkQueue>> m_Queues;
+	std::vector<std::thread> m_Threads;
+
+	std::mutex m_WakeMutex;
+	std::condition_variable m_WakeUp;
+	int m_Pending = 0;
+	bool m_Stop = false;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+/* A std140 uniform block in one buffer. Block is a struct laid out as the block is in the shaders: every vec3
+   (and every struct and array element) starts on 16 bytes, so vec3s are followed by a float or padding, and
+   the whole block is a multiple of 16 bytes. The block is uploaded whole, with a single glBufferSubData, and
+   read by every program pointed at the buffer's binding point. */
+
+#include <glad/glad.h>
+#include <learnopengl/shader_m.h>
+
+#include <string>
+
+template <typename Block>
+class UniformBuffer
+{
+public:
+	static_assert(sizeof(Block) % 16 == 0, "std140 pads a block to a multiple of 16 bytes");
+
+	explicit UniformBuffer(unsigned int bindingPoint)
+		: m_BindingPoint(bindingPoint)
+	{
+		glGenBuffers(1, &m_UBO);
+		glBindBuffer(GL_UNIFORM_BUFFER, m_UBO);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), NULL, GL_STREAM_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, m_BindingPoint, m_UBO);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	~UniformBuffer()
+	{
+		glDeleteBuffers(1, &m_UBO);
+	}
+
+	UniformBuffer(const UniformBuffer&) = delete;
+	UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+	// Points the shader's block at this buffer; only needed once per program
+	bool BindShader(const Shader& shader, const std::string& blockName) const
+	{
+		return shader.bindUniformBlock(blockName, m_BindingPoint);
+	}
+
+	// The storage is orphaned first, as BonePaletteBuffer::Upload does, so the driver needn't wait for draws
+	// still reading the last upload
+	void Upload(const Block& block)
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, m_UBO);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	unsigned int GetID() const { return m_UBO; }
+	unsigned int GetBindingPoint() const { return m_BindingPoint; }
+
+private:
+	unsigned int m_UBO = 0;
+	unsigned int m_BindingPoint;
+};
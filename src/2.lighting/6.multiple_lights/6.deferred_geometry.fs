@@ -0,0 +1,36 @@
+#version 330 core
+// The deferred path's geometry pass with 6.multiple_lights.vs: what 6.multiple_lights.fs lights with, written
+// to the G-buffer (DeferredShading) for 6.deferred_light.fs and 6.deferred_point_light.fs
+layout (location = 0) out vec4 AlbedoSpecular;
+layout (location = 1) out vec2 EncodedNormal;
+
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+    float shininess;
+};
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+in float Fade;
+
+uniform Material material;
+
+// the unit sphere folded onto an octahedron and that unfolded onto the square, 0 to 1
+vec2 EncodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 folded = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return (n.z >= 0.0 ? n.xy : folded) * 0.5 + 0.5;
+}
+
+void main()
+{
+    // the same dithered cross-fade into the forest's impostors as 6.multiple_lights.fs
+    if (Fade < 1.0 && fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715)))) >= Fade)
+        discard;
+    // the specular map is grey, so one channel of it is kept
+    AlbedoSpecular = vec4(texture(material.diffuse, TexCoords).rgb, texture(material.specular, TexCoords).r);
+    EncodedNormal = EncodeNormal(normalize(Normal));
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#version 330 core
+// The deferred path's full-screen light pass: the directional light and the flashlight, which reach every
+// pixel, lit as 6.multiple_lights.fs does from the G-buffer (DeferredShading). The fireflies are added after by
+// 6.deferred_point_light.fs.
+out vec4 FragColor;
+
+struct DirLight {
+    vec3 direction;
+	
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// the spot light's members are ordered for std140, each float filling the end of the vec3 before it
+struct SpotLight {
+    vec3 position;
+    float cutOff;
+    vec3 direction;
+    float outerCutOff;
+    vec3 ambient;
+    float constant;
+    vec3 diffuse;
+    float linear;
+    vec3 specular;
+    float quadratic;
+};
+
+uniform vec3 viewPos;
+// the same block as 6.multiple_lights.fs reads, of which the clusters go unused
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    SpotLight spotLight;
+    ivec4 clusterGrid;
+    vec4 clusterDepth;
+    vec4 clusterTileScale;
+};
+uniform float shininess;
+uniform mat4 inverseViewProjection;
+// the G-buffer
+uniform sampler2D gAlbedoSpecular;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 albedo, float specularStrength);
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, float specularStrength);
+
+vec3 DecodeNormal(vec2 encoded)
+{
+    encoded = encoded * 2.0 - 1.0;
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = clamp(-n.z, 0.0, 1.0);
+    n.xy += vec2(n.x >= 0.0 ? -fold : fold, n.y >= 0.0 ? -fold : fold);
+    return normalize(n);
+}
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, texel, 0).r;
+    // the background keeps the clear color
+    if (depth == 1.0)
+        discard;
+    vec4 position = inverseViewProjection * (vec4(gl_FragCoord.xy / vec2(textureSize(gDepth, 0)), depth, 1.0) * 2.0 - 1.0);
+    vec3 fragPos = position.xyz / position.w;
+    vec4 albedoSpecular = texelFetch(gAlbedoSpecular, texel, 0);
+    vec3 norm = DecodeNormal(texelFetch(gNormal, texel, 0).xy);
+    vec3 viewDir = normalize(viewPos - fragPos);
+
+    vec3 result = CalcDirLight(dirLight, norm, viewDir, albedoSpecular.rgb, albedoSpecular.a);
+    result += CalcSpotLight(spotLight, norm, fragPos, viewDir, albedoSpecular.rgb, albedoSpecular.a);
+    FragColor = vec4(result, 1.0);
+}
+
+// calculates the color when using a directional light.
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 albedo, float specularStrength)
+{
+    vec3 lightDir = normalize(-light.direction);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularStrength;
+    return (ambient + diffuse + specular);
+}
+
+// calculates the color when using a spot light.
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, float specularStrength)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
+    float theta = dot(lightDir, normalize(-light.direction)); 
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularStrength;
+    return (ambient + diffuse + specular) * attenuation * intensity;
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#version 330 core
+// The deferred path's point light pass: a firefly lighting the G-buffer's pixels its volume covers, as
+// 6.multiple_lights.fs lights a fragment, added onto 6.deferred_light.fs's result
+out vec4 FragColor;
+
+flat in vec4 LightPositionRadius;
+flat in vec4 LightColorAmbient;
+flat in vec4 LightAttenuation;
+
+uniform vec3 viewPos;
+uniform float shininess;
+uniform mat4 inverseViewProjection;
+// the G-buffer
+uniform sampler2D gAlbedoSpecular;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+
+vec3 DecodeNormal(vec2 encoded)
+{
+    encoded = encoded * 2.0 - 1.0;
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = clamp(-n.z, 0.0, 1.0);
+    n.xy += vec2(n.x >= 0.0 ? -fold : fold, n.y >= 0.0 ? -fold : fold);
+    return normalize(n);
+}
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, texel, 0).r;
+    if (depth == 1.0)
+        discard;
+    vec4 position = inverseViewProjection * (vec4(gl_FragCoord.xy / vec2(textureSize(gDepth, 0)), depth, 1.0) * 2.0 - 1.0);
+    vec3 fragPos = position.xyz / position.w;
+    float distance = length(LightPositionRadius.xyz - fragPos);
+    if (distance >= LightPositionRadius.w)
+        discard;
+    vec4 albedoSpecular = texelFetch(gAlbedoSpecular, texel, 0);
+    vec3 normal = DecodeNormal(texelFetch(gNormal, texel, 0).xy);
+    vec3 viewDir = normalize(viewPos - fragPos);
+
+    vec3 lightDir = (LightPositionRadius.xyz - fragPos) / distance;
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    float attenuation = 1.0 / (LightAttenuation.x + LightAttenuation.y * distance + LightAttenuation.z * (distance * distance));
+    // faded out towards the radius, as in 6.multiple_lights.fs
+    float window = clamp(1.0 - pow(distance / LightPositionRadius.w, 4.0), 0.0, 1.0);
+    attenuation *= window * window;
+    vec3 ambient = LightColorAmbient.rgb * LightColorAmbient.a * albedoSpecular.rgb;
+    vec3 diffuse = LightColorAmbient.rgb * diff * albedoSpecular.rgb;
+    vec3 specular = LightColorAmbient.rgb * spec * albedoSpecular.a;
+    FragColor = vec4((ambient + diffuse + specular) * attenuation, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+#version 330 core
+// A firefly's light volume (DeferredShading::DrawPointLights): the sphere it was culled with
+layout (location = 0) in vec3 aPos;
+// per light, a ClusteredPointLight: position and radius, color and ambient share, constant, linear and quadratic
+layout (location = 1) in vec4 aPositionRadius;
+layout (location = 2) in vec4 aColorAmbient;
+layout (location = 3) in vec4 aAttenuation;
+
+flat out vec4 LightPositionRadius;
+flat out vec4 LightColorAmbient;
+flat out vec4 LightAttenuation;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    LightPositionRadius = aPositionRadius;
+    LightColorAmbient = aColorAmbient;
+    LightAttenuation = aAttenuation;
+    gl_Position = projection * view * vec4(aPositionRadius.xyz + aPos * aPositionRadius.w, 1.0);
+}
\ No newline at end of file
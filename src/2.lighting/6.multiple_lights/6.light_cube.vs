@@ -1,11 +1,20 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+// one firefly per instance (FireflySwarm): its position as three planar arrays, then its color
+layout (location = 1) in float aInstanceX;
+layout (location = 2) in float aInstanceY;
+layout (location = 3) in float aInstanceZ;
+layout (location = 4) in vec3 aInstanceColor;
 
-uniform mat4 model;
+out vec3 LightColor;
+
+uniform float cubeSize;
 uniform mat4 view;
 uniform mat4 projection;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    LightColor = aInstanceColor;
+    vec3 worldPos = vec3(aInstanceX, aInstanceY, aInstanceZ) + aPos * cubeSize;
+    gl_Position = projection * view * vec4(worldPos, 1.0);
 }
\ No newline at end of file
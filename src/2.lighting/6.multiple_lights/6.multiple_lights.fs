@@ -15,8 +15,10 @@ struct DirLight {
     vec3 specular;
 };
 
+// fetched from pointLightData, see FetchPointLight
 struct PointLight {
     vec3 position;
+    float radius;
     
     float constant;
     float linear;
@@ -27,31 +29,41 @@ struct PointLight {
     vec3 specular;
 };
 
+// the spot light's members are ordered for std140, each float filling the end of the vec3 before it
 struct SpotLight {
     vec3 position;
-    vec3 direction;
     float cutOff;
+    vec3 direction;
     float outerCutOff;
-  
+    vec3 ambient;
     float constant;
+    vec3 diffuse;
     float linear;
+    vec3 specular;
     float quadratic;
-  
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;       
 };
 
-#define NR_POINT_LIGHTS 8
-
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
+in float Fade;
 
 uniform vec3 viewPos;
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform SpotLight spotLight;
+// the lights in one buffer, uploaded once a frame (LightBlock in multiple_lights.cpp) and shared by
+// 6.multiple_lights.fs and 6.tree_impostor.fs; the point lights are in the texture buffers of LightClusters,
+// listed per cluster of the view frustum, and these are its parameters
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    SpotLight spotLight;
+    ivec4 clusterGrid;       // tiles across, tiles up, depth slices, point lights
+    vec4 clusterDepth;       // near and far planes, scale and bias from the log of a view depth to its slice
+    vec4 clusterTileScale;   // tiles per pixel
+};
+// per point light 3 texels: position and radius, color and ambient share, constant, linear and quadratic
+uniform samplerBuffer pointLightData;
+// per cluster the offset and count of its lights in clusterLightIndices
+uniform usamplerBuffer clusterRanges;
+uniform usamplerBuffer clusterLightIndices;
 uniform Material material;
 
 // function prototypes
@@ -59,8 +71,41 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 
+// index of the cluster the fragment lies in, from its window position and depth
+int ClusterIndex()
+{
+    float nearPlane = clusterDepth.x;
+    float farPlane = clusterDepth.y;
+    float viewDepth = 2.0 * nearPlane * farPlane / (farPlane + nearPlane - (2.0 * gl_FragCoord.z - 1.0) * (farPlane - nearPlane));
+    ivec3 cluster = ivec3(ivec2(gl_FragCoord.xy * clusterTileScale.xy), int(floor(log(viewDepth) * clusterDepth.z + clusterDepth.w)));
+    cluster = clamp(cluster, ivec3(0), clusterGrid.xyz - 1);
+    return (cluster.z * clusterGrid.y + cluster.y) * clusterGrid.x + cluster.x;
+}
+
+PointLight FetchPointLight(int index)
+{
+    vec4 positionRadius = texelFetch(pointLightData, index * 3);
+    vec4 colorAmbient = texelFetch(pointLightData, index * 3 + 1);
+    vec4 attenuation = texelFetch(pointLightData, index * 3 + 2);
+    PointLight light;
+    light.position = positionRadius.xyz;
+    light.radius = positionRadius.w;
+    light.constant = attenuation.x;
+    light.linear = attenuation.y;
+    light.quadratic = attenuation.z;
+    light.ambient = colorAmbient.rgb * colorAmbient.a;
+    light.diffuse = colorAmbient.rgb;
+    light.specular = colorAmbient.rgb;
+    return light;
+}
+
 void main()
 {    
+    // forest trees fading into their impostors keep the pixels where a fixed noise is below their share,
+    // 6.tree_impostor.fs takes the rest
+    if (Fade < 1.0 && fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715)))) >= Fade)
+        discard;
+
     // properties
     vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(viewPos - FragPos);
@@ -73,9 +118,10 @@ void main()
     // == =====================================================
     // phase 1: directional lighting
     vec3 result = CalcDirLight(dirLight, norm, viewDir);
-    // phase 2: point lights
-    for(int i = 0; i < NR_POINT_LIGHTS; i++)
-        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);    
+    // phase 2: point lights, only those reaching the fragment's cluster
+    uvec2 range = texelFetch(clusterRanges, ClusterIndex()).xy;
+    for(uint i = 0u; i < range.y; i++)
+        result += CalcPointLight(FetchPointLight(int(texelFetch(clusterLightIndices, int(range.x + i)).r)), norm, FragPos, viewDir);    
     // phase 3: spot light
     result += CalcSpotLight(spotLight, norm, FragPos, viewDir);    
     
@@ -110,6 +156,9 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     // attenuation
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
+    // faded out towards the radius the light was culled with, so it never stops at a cluster's edge
+    float window = clamp(1.0 - pow(distance / light.radius, 4.0), 0.0, 1.0);
+    attenuation *= window * window;
     // combine results
     vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
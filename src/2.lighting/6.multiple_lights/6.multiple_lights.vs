@@ -2,19 +2,68 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+// per tree segment (LSystemTree's SegmentInstance), used while instanced is set; per forest tree
+// (LSystemForest's ForestMeshInstance) while treeInstances is set
+layout (location = 3) in mat4 aInstanceModel;
+layout (location = 7) in vec4 aWindCos;
+layout (location = 8) in vec4 aWindSin;
+layout (location = 9) in vec2 aBirth;
+// per vertex of the merged tree mesh (LSystemMesh), used while treeMesh is set, along with 7 to 9
+layout (location = 10) in vec3 aGrowthOrigin;
+layout (location = 11) in float aTreeFade;
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
+out float Fade; // share of the cross-fade to the tree's impostor, 1 for everything else
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+uniform bool instanced;
+uniform bool treeMesh;
+uniform bool treeInstances;
+
+// tree animation
+uniform float growthProgress; // 0 to 1
+uniform float time;
+uniform float windStrength;   // sway of each branch about its pivot, in radians
+uniform float windFrequency;
+uniform vec3 windDirection;   // horizontal, normalized
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;  
+    vec3 position = aPos;
+    mat4 world = model;
+    if (instanced) {
+        world = aInstanceModel;
+        // grows out of its base (the cube's bottom face) in length and thickness while the tree's growth
+        // front passes along it; unborn segments collapse to a point
+        float growth = smoothstep(aBirth.x, aBirth.y, growthProgress);
+        position = vec3(aPos.x * growth, (aPos.y + 0.5) * growth - 0.5, aPos.z * growth);
+    }
+    else if (treeMesh) {
+        // each vertex moves out from where its ring grows from, on the same schedule
+        float growth = smoothstep(aBirth.x, aBirth.y, growthProgress);
+        position = aGrowthOrigin + (aPos - aGrowthOrigin) * growth;
+    }
+    FragPos = vec3(world * vec4(position, 1.0));
+    if (instanced || treeMesh) {
+        // sum over the segment's branch and its ancestors of a small rotation about each pivot, bending the
+        // tree along the wind; the gust slowly varies the strength
+        float gust = windStrength * (0.75 + 0.25 * sin(time * 0.37));
+        vec3 offset = (aWindCos.w * FragPos - aWindCos.xyz) * sin(windFrequency * time)
+                    + (aWindSin.w * FragPos - aWindSin.xyz) * cos(windFrequency * time);
+        FragPos += gust * cross(normalize(cross(vec3(0.0, 1.0, 0.0), windDirection)), offset);
+    }
+    Fade = 1.0;
+    if (treeMesh && treeInstances) {
+        // a forest tree: so far everything was in the tree's own space, where its wind pivots are
+        world = aInstanceModel * world;
+        FragPos = vec3(aInstanceModel * vec4(FragPos, 1.0));
+        Fade = aTreeFade;
+    }
+    Normal = mat3(transpose(inverse(world))) * aNormal;  
     TexCoords = aTexCoords;
     
     gl_Position = projection * view * vec4(FragPos, 1.0);
@@ -0,0 +1,172 @@
+#version 330 core
+out vec4 FragColor;
+
+struct DirLight {
+    vec3 direction;
+	
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// fetched from pointLightData, see FetchPointLight
+struct PointLight {
+    vec3 position;
+    float radius;
+    
+    float constant;
+    float linear;
+    float quadratic;
+	
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// the spot light's members are ordered for std140, each float filling the end of the vec3 before it
+struct SpotLight {
+    vec3 position;
+    float cutOff;
+    vec3 direction;
+    float outerCutOff;
+    vec3 ambient;
+    float constant;
+    vec3 diffuse;
+    float linear;
+    vec3 specular;
+    float quadratic;
+};
+
+in vec3 FragPos;
+in vec2 TexCoords;
+in vec3 Right;
+in vec3 Up;
+in vec3 Toward;
+in float MeshFade;
+
+uniform vec3 viewPos;
+// the lights in one buffer, uploaded once a frame (LightBlock in multiple_lights.cpp) and shared by
+// 6.multiple_lights.fs and 6.tree_impostor.fs; the point lights are in the texture buffers of LightClusters,
+// listed per cluster of the view frustum, and these are its parameters
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    SpotLight spotLight;
+    ivec4 clusterGrid;       // tiles across, tiles up, depth slices, point lights
+    vec4 clusterDepth;       // near and far planes, scale and bias from the log of a view depth to its slice
+    vec4 clusterTileScale;   // tiles per pixel
+};
+// per point light 3 texels: position and radius, color and ambient share, constant, linear and quadratic
+uniform samplerBuffer pointLightData;
+// per cluster the offset and count of its lights in clusterLightIndices
+uniform usamplerBuffer clusterRanges;
+uniform usamplerBuffer clusterLightIndices;
+uniform float shininess;
+// baked by LSystemForest::BakeImpostors, premultiplied by coverage (alpha of the albedo)
+uniform sampler2D impostorAlbedo;
+uniform sampler2D impostorNormal;
+
+// the same lighting as 6.multiple_lights.fs, with the material's texels looked up in the atlases instead
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 albedo, float specularStrength);
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, float specularStrength);
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, float specularStrength);
+
+// index of the cluster the fragment lies in, from its window position and depth
+int ClusterIndex()
+{
+    float nearPlane = clusterDepth.x;
+    float farPlane = clusterDepth.y;
+    float viewDepth = 2.0 * nearPlane * farPlane / (farPlane + nearPlane - (2.0 * gl_FragCoord.z - 1.0) * (farPlane - nearPlane));
+    ivec3 cluster = ivec3(ivec2(gl_FragCoord.xy * clusterTileScale.xy), int(floor(log(viewDepth) * clusterDepth.z + clusterDepth.w)));
+    cluster = clamp(cluster, ivec3(0), clusterGrid.xyz - 1);
+    return (cluster.z * clusterGrid.y + cluster.y) * clusterGrid.x + cluster.x;
+}
+
+PointLight FetchPointLight(int index)
+{
+    vec4 positionRadius = texelFetch(pointLightData, index * 3);
+    vec4 colorAmbient = texelFetch(pointLightData, index * 3 + 1);
+    vec4 attenuation = texelFetch(pointLightData, index * 3 + 2);
+    PointLight light;
+    light.position = positionRadius.xyz;
+    light.radius = positionRadius.w;
+    light.constant = attenuation.x;
+    light.linear = attenuation.y;
+    light.quadratic = attenuation.z;
+    light.ambient = colorAmbient.rgb * colorAmbient.a;
+    light.diffuse = colorAmbient.rgb;
+    light.specular = colorAmbient.rgb;
+    return light;
+}
+
+void main()
+{
+    // the pixels the tree's mesh doesn't keep while they cross-fade (see 6.multiple_lights.fs)
+    if (fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715)))) < MeshFade)
+        discard;
+    vec4 albedo = texture(impostorAlbedo, TexCoords);
+    if (albedo.a < 0.5)
+        discard;
+    vec4 normalSpecular = texture(impostorNormal, TexCoords) / albedo.a;
+    vec3 baked = normalSpecular.xyz * 2.0 - 1.0;
+    vec3 norm = normalize(baked.x * Right + baked.y * Up + baked.z * Toward);
+    vec3 color = albedo.rgb / albedo.a;
+    float specularStrength = normalSpecular.a;
+    vec3 viewDir = normalize(viewPos - FragPos);
+
+    vec3 result = CalcDirLight(dirLight, norm, viewDir, color, specularStrength);
+    uvec2 range = texelFetch(clusterRanges, ClusterIndex()).xy;
+    for(uint i = 0u; i < range.y; i++)
+        result += CalcPointLight(FetchPointLight(int(texelFetch(clusterLightIndices, int(range.x + i)).r)), norm, FragPos, viewDir, color, specularStrength);
+    result += CalcSpotLight(spotLight, norm, FragPos, viewDir, color, specularStrength);
+    
+    FragColor = vec4(result, 1.0);
+}
+
+// calculates the color when using a directional light.
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 albedo, float specularStrength)
+{
+    vec3 lightDir = normalize(-light.direction);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularStrength;
+    return (ambient + diffuse + specular);
+}
+
+// calculates the color when using a point light.
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, float specularStrength)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
+    // faded out towards the radius the light was culled with, so it never stops at a cluster's edge
+    float window = clamp(1.0 - pow(distance / light.radius, 4.0), 0.0, 1.0);
+    attenuation *= window * window;
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularStrength;
+    return (ambient + diffuse + specular) * attenuation;
+}
+
+// calculates the color when using a spot light.
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, float specularStrength)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
+    float theta = dot(lightDir, normalize(-light.direction)); 
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularStrength;
+    return (ambient + diffuse + specular) * attenuation * intensity;
+}
\ No newline at end of file
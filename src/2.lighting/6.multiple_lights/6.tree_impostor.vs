@@ -0,0 +1,50 @@
+#version 330 core
+// quad corner, -1 to 1
+layout (location = 0) in vec2 aCorner;
+// per impostor (LSystemForest's ForestImpostorInstance)
+layout (location = 1) in vec4 aPositionScale;
+layout (location = 2) in vec3 aYawVariantFade;
+
+out vec3 FragPos;
+out vec2 TexCoords;
+out vec3 Right;   // the view's frame the normals were baked in
+out vec3 Up;
+out vec3 Toward;
+out float MeshFade;
+
+#define MAX_TREE_VARIANTS 16
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 viewPos;
+uniform int viewCount;
+uniform int variantCount;
+uniform vec4 variantBounds[MAX_TREE_VARIANTS]; // bounding sphere in the tree's own space
+
+void main()
+{
+    int variant = int(aYawVariantFade.y + 0.5);
+    float yaw = aYawVariantFade.x;
+    float scale = aPositionScale.w;
+    vec4 bounds = variantBounds[variant];
+
+    // the tree's bounding sphere in the world, turned by its yaw about the up axis
+    vec3 center = aPositionScale.xyz + scale * vec3(cos(yaw) * bounds.x + sin(yaw) * bounds.z, bounds.y, -sin(yaw) * bounds.x + cos(yaw) * bounds.z);
+    float radius = scale * bounds.w;
+
+    // turned about the up axis toward the camera, as the views were baked
+    vec3 toward = vec3(viewPos.x - center.x, 0.0, viewPos.z - center.z);
+    toward = length(toward) > 0.0001 ? normalize(toward) : vec3(0.0, 0.0, 1.0);
+    Up = vec3(0.0, 1.0, 0.0);
+    Right = cross(Up, toward);
+    Toward = toward;
+    FragPos = center + (Right * aCorner.x + Up * aCorner.y) * radius;
+
+    // the baked view nearest to the camera's direction in the tree's own space
+    float azimuth = atan(toward.x, toward.z) - yaw;
+    float tile = mod(floor(azimuth / 6.28318531 * float(viewCount) + 0.5), float(viewCount));
+    TexCoords = (vec2(tile, float(variant)) + aCorner * 0.5 + 0.5) / vec2(float(viewCount), float(variantCount));
+    MeshFade = aYawVariantFade.z;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
\ No newline at end of file
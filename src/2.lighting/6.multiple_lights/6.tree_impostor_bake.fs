@@ -0,0 +1,25 @@
+#version 330 core
+// Bakes a tree's impostor (LSystemForest::BakeImpostors) with 6.multiple_lights.vs: albedo and coverage, and
+// the normal in the view's frame with the specular strength, for 6.tree_impostor.fs to light
+layout (location = 0) out vec4 Albedo;
+layout (location = 1) out vec4 NormalSpecular;
+
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+    float shininess;
+};
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+
+uniform mat4 view;
+uniform Material material;
+
+void main()
+{
+    vec3 normal = normalize(mat3(view) * Normal);
+    Albedo = vec4(texture(material.diffuse, TexCoords).rgb, 1.0);
+    NormalSpecular = vec4(normal * 0.5 + 0.5, texture(material.specular, TexCoords).r);
+}
\ No newline at end of file
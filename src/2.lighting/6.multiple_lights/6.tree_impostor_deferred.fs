@@ -0,0 +1,37 @@
+#version 330 core
+// The deferred path's geometry pass for the forest's impostors with 6.tree_impostor.vs: the atlases' texels
+// in the G-buffer's layout, as 6.deferred_geometry.fs writes the meshes'
+layout (location = 0) out vec4 AlbedoSpecular;
+layout (location = 1) out vec2 EncodedNormal;
+
+in vec3 FragPos;
+in vec2 TexCoords;
+in vec3 Right;
+in vec3 Up;
+in vec3 Toward;
+in float MeshFade;
+
+// baked by LSystemForest::BakeImpostors, premultiplied by coverage (alpha of the albedo)
+uniform sampler2D impostorAlbedo;
+uniform sampler2D impostorNormal;
+
+vec2 EncodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 folded = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return (n.z >= 0.0 ? n.xy : folded) * 0.5 + 0.5;
+}
+
+void main()
+{
+    // the pixels the tree's mesh doesn't keep while they cross-fade (see 6.multiple_lights.fs)
+    if (fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715)))) < MeshFade)
+        discard;
+    vec4 albedo = texture(impostorAlbedo, TexCoords);
+    if (albedo.a < 0.5)
+        discard;
+    vec4 normalSpecular = texture(impostorNormal, TexCoords) / albedo.a;
+    vec3 baked = normalSpecular.xyz * 2.0 - 1.0;
+    AlbedoSpecular = vec4(albedo.rgb / albedo.a, normalSpecular.a);
+    EncodedNormal = EncodeNormal(normalize(baked.x * Right + baked.y * Up + baked.z * Toward));
+}
\ No newline at end of file
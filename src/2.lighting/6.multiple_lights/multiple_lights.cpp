@@ -11,14 +11,26 @@
 #include <learnopengl/filesystem.h>
 #include <learnopengl/shader_m.h>
 #include <learnopengl/camera.h>
-
+#include <learnopengl/deferred_shading.h>
+#include <learnopengl/firefly_swarm.h>
+#include <learnopengl/light_clusters.h>
+#include <learnopengl/lsystem.h>
+#include <learnopengl/lsystem_forest.h>
+#include <learnopengl/lsystem_mesh.h>
+#include <learnopengl/lsystem_tree.h>
+#include <learnopengl/task_pool.h>
+#include <learnopengl/uniform_buffer.h>
+
+#include <chrono>
 #include <iostream>
 #include <functional>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
+#include <random>
 #include <string>
-#include <map>
-#include <stack> // For L-system turtle graphics
+#include <algorithm>
+#include <thread>
 #include <vector>
 
 void framebuffer_size_callback(GLFWwindow * window, int width, int height);
@@ -44,7 +56,6 @@ float currentTime = 0.0f;
 
 // L-system parameters
 std::string lSystemAxiom = "F"; // Axiom is 'F' for this rule
-std::map<char, std::string> lSystemRules;
 int lSystemIterations = 8;
 float lSystemBranchAngle = 30.0f; 
 float lSystemBranchScale = 0.7f;
@@ -53,37 +64,104 @@ float lSystemBranchScale = 0.7f;
 float lSystemAnimationProgress = 0.0f; // 0.0 to 1.0, controls how much of the tree is 'grown'
 float lSystemGrowthSpeed = 0.04f; // Speed at which the tree grows
 
-// Global variable to store the generated L-system string
-std::string lSystemString;
-
-// Helper struct for turtle graphics state
-struct TurtleState {
-    glm::vec3 position;
-    glm::vec3 direction; // This is the 'forward' vector
-    glm::vec3 up;        // Local 'up' vector
-    glm::vec3 right;     // Local 'right' vector
-    float length;
-    float thickness;
+// L-system wind, animated in the vertex shader
+float lSystemWindStrength = 0.03f; // radians each branch sways about where it starts
+float lSystemWindFrequency = 1.3f;
+glm::vec3 lSystemWindDirection = glm::normalize(glm::vec3(1.0f, 0.0f, 0.3f));
+
+// draw the tree as one merged tube mesh at the level of detail its distance calls for, or (false) as a box per segment
+const bool lSystemUseMesh = true;
+
+// forest mode: this many trees scattered around the one above, seeded variants of a few L-systems, the near ones
+// drawn as instanced meshes and the far ones as impostors baked at load time (0 for the single tree only)
+const int lSystemForestTreeCount = 0;
+const unsigned int lSystemForestSeed = 1;
+const float lSystemForestRadius = 150.0f;
+const float lSystemForestImpostorDistance = 25.0f; // cross-fades to impostors over the next 5 units
+
+// The derived L-system; its string is streamed symbol by symbol and never stored
+LSystem lSystem;
+
+// print time and memory of deriving the tree with 1 to this many iterations, as a string and streamed (0 to skip)
+const int lSystemMeasureIterations = 0;
+// print time of deriving the string and interpreting it with the turtle at this many iterations on 1, 2, 4...
+// threads (0 to skip)
+const int lSystemParallelIterations = 0;
+
+// Global variables
+// the fireflies move as one structure-of-arrays swarm (FireflySwarm), updated with SIMD on the task pool and
+// drawn as a single instanced batch of cubes; a million still update at interactive rates
+const int fireflyCount = 12;
+// only the first this many of them give light
+const int fireflyLightCount = 4096;
+// print time of updating a swarm of this many fireflies on 1, 2, 4... threads (0 to skip)
+const int fireflySwarmMeasureCount = 0;
+// the fireflies' point lights, assigned to the clusters of the view frustum each frame (LightClusters) so a
+// fragment only shades the few that reach it: thousands cost about what a dozen do
+std::vector<ClusteredPointLight> fireflyLights;
+// or lit deferred, from a G-buffer (DeferredShading), with a light volume per firefly; G switches between the
+// two while running, and every few seconds each prints its frame time and the fragments it shaded
+bool deferredShading = false;
+bool deferredShadingKeyDown = false;
+
+// The Lights uniform block of 6.multiple_lights.fs and 6.tree_impostor.fs in std140 layout, where every vec3
+// starts on 16 bytes: the floats after a vec3 fill the rest, explicit padding where none follows
+struct DirLightStd140 {
+    glm::vec3 direction; float padding0;
+    glm::vec3 ambient; float padding1;
+    glm::vec3 diffuse; float padding2;
+    glm::vec3 specular; float padding3;
+};
+struct SpotLightStd140 {
+    glm::vec3 position; float cutOff;
+    glm::vec3 direction; float outerCutOff;
+    glm::vec3 ambient; float constant;
+    glm::vec3 diffuse; float linear;
+    glm::vec3 specular; float quadratic;
+};
+struct LightBlock {
+    DirLightStd140 dirLight;
+    SpotLightStd140 spotLight;
+    glm::ivec4 clusterGrid;
+    glm::vec4 clusterDepth;
+    glm::vec4 clusterTileScale;
 };
 
-struct Firefly {
-    glm::vec3 position;
-    glm::vec3 color;
-    float orbitRadius;
-    float orbitSpeed;
-    float orbitAngle;
+// A program drawing the tree and the forest, with the uniforms it is given every frame
+struct SceneProgram {
+    const Shader* shader;
+    GLint viewPos, projection, view, model, growthProgress, time;
 };
 
-// Global variables
-std::vector<Firefly> fireflies;
+// GPU time and fragments of one frame, read back once the GPU has them ready; a few sets take turns, so the
+// CPU never waits on a result however many frames the driver queues
+const int frameQuerySetCount = 4;
+struct FrameQueries {
+    unsigned int gpuTime, sceneSamples, lightSamples;
+    bool deferred;
+    bool pending;
+};
+// totals over the frames each path drew since the last print, forward then deferred
+struct ShadingPathStats {
+    int frames, measuredFrames;
+    double frameSeconds, gpuMilliseconds;
+    double sceneFragments, lightFragments;
+};
 
 // Function declarations
-void updateFireflies(float deltaTime);
-void generateFireflies();
-std::string generateLSystem(const std::string& axiom, const std::map<char, std::string>& rules, int iterations);
-void renderLSystemTree(const std::string& lSystemStr, Shader& shader, unsigned int VAO,
-    TurtleState initialTurtleState, // Changed to take an initial TurtleState
-    float angle, float scaleFactor, float currentTime, float animationProgress);
+void updateFireflies(FireflySwarm& swarm, TaskPool& pool, float deltaTime);
+void generateFireflies(FireflySwarm& swarm, int count);
+void printFireflySwarmScaling(int count);
+void printLSystemCosts(const LSystem& system, int maxIterations);
+void printLSystemParallelScaling(const LSystem& system, int iterations, const TurtleState& initialTurtleState);
+void printLSystemMeshLods(const LSystemMesh& mesh);
+void buildForest(LSystemForest& forest, const LSystem& system, const TurtleState& initialTurtleState, TaskPool& pool, const Shader& bakeShader);
+void fillFireflyLights(const FireflySwarm& swarm);
+void fillLightBlock(LightBlock& block, const LightClusters& clusters, int viewportWidth, int viewportHeight);
+void printUniformTraffic(const ShaderStats& frameStart, const ShaderStats& frameEnd, const LightClusters& clusters);
+SceneProgram resolveSceneProgram(const Shader& shader);
+bool readFrameQueries(FrameQueries& queries, ShadingPathStats stats[2]);
+void printShadingStats(ShadingPathStats stats[2], int pixelCount);
 
 
 int main()
@@ -132,6 +210,13 @@ int main()
     // ------------------------------------
     Shader lightingShader("6.multiple_lights.vs", "6.multiple_lights.fs");
     Shader lightCubeShader("6.light_cube.vs", "6.light_cube.fs");
+    Shader impostorShader("6.tree_impostor.vs", "6.tree_impostor.fs");
+    Shader impostorBakeShader("6.multiple_lights.vs", "6.tree_impostor_bake.fs");
+    // the deferred path: the tree and forest into the G-buffer, then its light pass
+    Shader gBufferShader("6.multiple_lights.vs", "6.deferred_geometry.fs");
+    Shader impostorGBufferShader("6.tree_impostor.vs", "6.tree_impostor_deferred.fs");
+    Shader deferredLightShader("6.deferred_light.vs", "6.deferred_light.fs");
+    Shader deferredPointLightShader("6.deferred_point_light.vs", "6.deferred_point_light.fs");
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
@@ -184,13 +269,18 @@ int main()
     srand(static_cast<unsigned int>(time(nullptr)));
 
     // L-system rules definition for a binary tree
-    lSystemRules['F'] = "F[+F][-F]"; // Simple binary branching
-    //lSystemRules['X'] = "F[+X][-X]"; // Example for a more complex axiom starting with 'X'
-
-    // Generate the L-system string
-    lSystemString = generateLSystem(lSystemAxiom, lSystemRules, lSystemIterations);
-    std::cout << "Generated L-system string (truncated): " << lSystemString.substr(0, glm::min((int)lSystemString.length(), 500)) << (lSystemString.length() > 500 ? "..." : "") << std::endl;
-
+    lSystem.SetAxiom(lSystemAxiom);
+    lSystem.SetIterations(lSystemIterations);
+    lSystem.SetRule('F', "F[+F][-F]"); // Simple binary branching
+    //lSystem.SetRule('X', "F[+X][-X]"); // Example for a more complex axiom starting with 'X'
+
+    // Print the start of the derived string, streamed straight from the rules
+    std::string preview;
+    for (LSystem::Cursor cursor = lSystem.Begin(); !cursor.Done() && preview.length() < 500; cursor.Next())
+        preview += cursor.Get();
+    std::cout << "Generated L-system string (" << lSystem.GetLength() << " symbols, truncated): " << preview << (lSystem.GetLength() > 500 ? "..." : "") << std::endl;
+    if (lSystemMeasureIterations > 0)
+        printLSystemCosts(lSystem, lSystemMeasureIterations);
 
     // first, configure the cube's VAO (and VBO)
     unsigned int VBO, cubeVAO;
@@ -208,6 +298,14 @@ int main()
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
     glEnableVertexAttribArray(2);
 
+    // the tree's segments are instances of the cube, their attributes in 3 to 9; the turtle runs on the pool
+    LSystemTree lSystemTree;
+    lSystemTree.AttachInstanceAttributes(cubeVAO);
+    TaskPool taskPool;
+    // or as a mesh of its own, rebuilt whenever the turtle runs again
+    LSystemMesh lSystemMesh;
+    LSystemForest lSystemForest;
+
     // second, configure the light's VAO (VBO stays the same; the vertices are the same for the light object which is also a 3D cube)
     unsigned int lightCubeVAO;
     glGenVertexArrays(1, &lightCubeVAO);
@@ -217,6 +315,10 @@ int main()
     // note that we update the lamp's position attribute's stride to reflect the updated buffer data
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
+    // and every firefly's position and color per instance, in 1 to 4
+    FireflySwarm fireflySwarm;
+    generateFireflies(fireflySwarm, fireflyCount);
+    fireflySwarm.AttachInstanceAttributes(lightCubeVAO);
 
     // load textures (we now use a utility function to keep the code more organized)
     // -----------------------------------------------------------------------------
@@ -226,9 +328,61 @@ int main()
 
     // shader configuration
     // --------------------
-    lightingShader.use();
-    lightingShader.setInt("material.diffuse", 0);
-    lightingShader.setInt("material.specular", 1);
+    for (const Shader* shader : { &lightingShader, &gBufferShader }) {
+        shader->use();
+        shader->setInt("material.diffuse", 0);
+        shader->setInt("material.specular", 1);
+        shader->setFloat("windStrength", lSystemWindStrength);
+        shader->setFloat("windFrequency", lSystemWindFrequency);
+        shader->setVec3("windDirection", lSystemWindDirection);
+    }
+    lightingShader.setFloat("material.shininess", 32.0f);
+    for (const Shader* shader : { &impostorShader, &deferredLightShader, &deferredPointLightShader }) {
+        shader->use();
+        shader->setFloat("shininess", 32.0f);
+    }
+    impostorBakeShader.use();
+    impostorBakeShader.setInt("material.diffuse", 0);
+    impostorBakeShader.setInt("material.specular", 1);
+
+    // every light goes into one uniform buffer a frame, read by both programs that light anything
+    UniformBuffer<LightBlock> lightBuffer(1); // binding point 0 is BonePaletteBuffer's default
+    lightBuffer.BindShader(lightingShader, "Lights");
+    lightBuffer.BindShader(impostorShader, "Lights");
+    lightBuffer.BindShader(deferredLightShader, "Lights");
+    LightBlock lightBlock = {};
+    // and the point lights into the texture buffers of their clusters, on texture units 4 to 6
+    LightClusters lightClusters;
+    lightClusters.SetNearSplit(5.0f); // slices go where the fireflies are, not the first few units in front
+    lightClusters.BindShader(lightingShader);
+    lightClusters.BindShader(impostorShader);
+    // the G-buffer on units 7 to 9, sized to the window in the render loop
+    DeferredShading deferred;
+    deferred.BindShader(deferredLightShader);
+    deferred.BindShader(deferredPointLightShader);
+    FrameQueries frameQueries[frameQuerySetCount] = {};
+    for (FrameQueries& queries : frameQueries) {
+        glGenQueries(1, &queries.gpuTime);
+        glGenQueries(1, &queries.sceneSamples);
+        glGenQueries(1, &queries.lightSamples);
+    }
+    ShadingPathStats shadingStats[2] = {};
+    float lastShadingPrint = 0.0f;
+
+    // the uniforms set every frame are resolved once; the setters then take their locations
+    const SceneProgram forwardScene = resolveSceneProgram(lightingShader);
+    const SceneProgram forwardImpostors = resolveSceneProgram(impostorShader);
+    const SceneProgram deferredScene = resolveSceneProgram(gBufferShader);
+    const SceneProgram deferredImpostors = resolveSceneProgram(impostorGBufferShader);
+    const GLint deferredLightViewPos = deferredLightShader.getUniformLocation("viewPos");
+    const GLint deferredLightInverseViewProjection = deferredLightShader.getUniformLocation("inverseViewProjection");
+    const GLint pointLightViewPos = deferredPointLightShader.getUniformLocation("viewPos");
+    const GLint pointLightProjection = deferredPointLightShader.getUniformLocation("projection");
+    const GLint pointLightView = deferredPointLightShader.getUniformLocation("view");
+    const GLint pointLightInverseViewProjection = deferredPointLightShader.getUniformLocation("inverseViewProjection");
+    const GLint lampProjection = lightCubeShader.getUniformLocation("projection");
+    const GLint lampView = lightCubeShader.getUniformLocation("view");
+    const GLint lampSize = lightCubeShader.getUniformLocation("cubeSize");
 
     // Define initial TurtleState for the tree
     TurtleState initialTurtleState;
@@ -256,14 +410,30 @@ int main()
     initialTurtleState.length = 2.0f;
     initialTurtleState.thickness = 0.3f;
 
+    if (lSystemParallelIterations > 0)
+        printLSystemParallelScaling(lSystem, lSystemParallelIterations, initialTurtleState);
+
+    if (lSystemForestTreeCount > 0) {
+        // the impostors are baked with the trees' own textures
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, diffuseMap);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, specularMap);
+        buildForest(lSystemForest, lSystem, initialTurtleState, taskPool, impostorBakeShader);
+        lSystemForest.BindImpostorShader(impostorShader);
+        lSystemForest.BindImpostorShader(impostorGBufferShader);
+    }
 
-    // Generate fireflies
-    generateFireflies();
+    if (fireflySwarmMeasureCount > 0)
+        printFireflySwarmScaling(fireflySwarmMeasureCount);
 
     // render loop
     // -----------
+    int frameCount = 0;
     while (!glfwWindowShouldClose(window))
     {
+        ShaderStats frameStart = Shader::stats();
+
         // per-frame time logic
         // --------------------
         float currentFrame = static_cast<float>(glfwGetTime());
@@ -284,56 +454,63 @@ int main()
         processInput(window);
 
         // update fireflies
-        updateFireflies(deltaTime);
+        updateFireflies(fireflySwarm, taskPool, deltaTime);
 
         // render
         // ------
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // view/projection transformations
+        float farPlane = lSystemForestTreeCount > 0 ? 400.0f : 100.0f; // far enough to see across the forest
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, farPlane);
+        glm::mat4 view = camera.GetViewMatrix();
 
-        // be sure to activate shader when setting uniforms/drawing objects
-        lightingShader.use();
-        lightingShader.setVec3("viewPos", camera.Position);
-        lightingShader.setFloat("material.shininess", 32.0f);
-
-        // directional light
-        lightingShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-        lightingShader.setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
-        lightingShader.setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
-        lightingShader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
-        // firefly lights (use up to NR_POINT_LIGHTS fireflies - ensure shader has enough)
-        for (int i = 0; i < fireflies.size(); i++) {
-            std::string prefix = "pointLights[" + std::to_string(i) + "]";
-            lightingShader.setVec3((prefix + ".position").c_str(), fireflies[i].position);
-            lightingShader.setVec3((prefix + ".ambient").c_str(), fireflies[i].color * 0.05f);
-            lightingShader.setVec3((prefix + ".diffuse").c_str(), fireflies[i].color);
-            lightingShader.setVec3((prefix + ".specular").c_str(), fireflies[i].color);
-            // Softer attenuation so light spreads further
-            lightingShader.setFloat((prefix + ".constant").c_str(), 1.0f);
-            lightingShader.setFloat((prefix + ".linear").c_str(), 0.07f);
-            lightingShader.setFloat((prefix + ".quadratic").c_str(), 0.017f);
+        // the point lights sorted into clusters (only forward shading needs them), then all other lights in a
+        // single upload
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        fillFireflyLights(fireflySwarm);
+        if (!deferredShading) {
+            lightClusters.Update(fireflyLights, view, glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, farPlane, &taskPool);
+            lightClusters.Bind();
+        }
+        fillLightBlock(lightBlock, lightClusters, framebufferWidth, framebufferHeight);
+        lightBuffer.Upload(lightBlock);
+
+        // this frame's GPU time and fragments, measured into whichever set of queries has been read back; if
+        // the GPU is so far behind that none has, the frame goes unmeasured rather than waiting for it
+        FrameQueries* queries = nullptr;
+        for (FrameQueries& candidate : frameQueries)
+            if (readFrameQueries(candidate, shadingStats) && !queries)
+                queries = &candidate;
+        shadingStats[deferredShading].frames++;
+        shadingStats[deferredShading].frameSeconds += deltaTime;
+        if (queries) {
+            queries->deferred = deferredShading;
+            glBeginQuery(GL_TIME_ELAPSED, queries->gpuTime);
         }
-        // spotLight
-        lightingShader.setVec3("spotLight.position", camera.Position);
-        lightingShader.setVec3("spotLight.direction", camera.Front);
-        lightingShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-        lightingShader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-        lightingShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-        lightingShader.setFloat("spotLight.constant", 1.0f);
-        lightingShader.setFloat("spotLight.linear", 0.09f);
-        lightingShader.setFloat("spotLight.quadratic", 0.032f);
-        lightingShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-        lightingShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
 
-        // view/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        lightingShader.setMat4("projection", projection);
-        lightingShader.setMat4("view", view);
+        // the tree and forest are either lit as they're drawn, or drawn into the G-buffer to be lit after
+        const SceneProgram& scene = deferredShading ? deferredScene : forwardScene;
+        const SceneProgram& impostors = deferredShading ? deferredImpostors : forwardImpostors;
+        if (deferredShading) {
+            deferred.Resize(framebufferWidth, framebufferHeight);
+            deferred.BeginGeometryPass();
+        }
+        else {
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
+        if (queries)
+            glBeginQuery(GL_SAMPLES_PASSED, queries->sceneSamples);
+
+        // be sure to activate shader when setting uniforms/drawing objects
+        scene.shader->use();
+        scene.shader->setVec3(scene.viewPos, camera.Position);
+        scene.shader->setMat4(scene.projection, projection);
+        scene.shader->setMat4(scene.view, view);
 
         // world transformation
         glm::mat4 model = glm::mat4(1.0f);
-        lightingShader.setMat4("model", model); // Set identity model for the scene itself
+        scene.shader->setMat4(scene.model, model); // Set identity model for the scene itself
 
         // bind diffuse map
         glActiveTexture(GL_TEXTURE0);
@@ -342,31 +519,83 @@ int main()
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, specularMap);
 
-        // render L-system fractal tree
-        glBindVertexArray(cubeVAO);
-        // Corrected call to renderLSystemTree
-        renderLSystemTree(lSystemString, lightingShader, cubeVAO,
-            initialTurtleState, // Pass the pre-initialized TurtleState
-            lSystemBranchAngle, lSystemBranchScale,
-            currentTime, lSystemAnimationProgress);
+        // render L-system fractal tree: the turtle only runs again if the rules or parameters changed,
+        // growth and wind are animated by the vertex shader from these two uniforms
+        if (lSystemTree.Update(lSystem, initialTurtleState, lSystemBranchAngle, lSystemBranchScale, &taskPool) && lSystemUseMesh) {
+            lSystemMesh.Build(lSystemTree.GetSegments(), lSystemTree.GetPreviousSegments());
+            printLSystemMeshLods(lSystemMesh);
+        }
+        scene.shader->setFloat(scene.growthProgress, lSystemAnimationProgress);
+        scene.shader->setFloat(scene.time, currentTime);
+        if (lSystemUseMesh)
+            lSystemMesh.Draw(*scene.shader, lSystemMesh.SelectLod(projection, view, (float)SCR_HEIGHT, model));
+        else
+            lSystemTree.Draw(*scene.shader, cubeVAO, 36);
+
+        // the forest, fully grown: meshes in one instanced draw per variant and level of detail, impostors in one
+        if (lSystemForestTreeCount > 0) {
+            lSystemForest.Update(projection, view, camera.Position, (float)SCR_HEIGHT);
+            scene.shader->setFloat(scene.growthProgress, 1.0f);
+            lSystemForest.DrawMeshes(*scene.shader);
+
+            impostors.shader->use();
+            impostors.shader->setMat4(impostors.projection, projection);
+            impostors.shader->setMat4(impostors.view, view);
+            impostors.shader->setVec3(impostors.viewPos, camera.Position);
+            lSystemForest.DrawImpostors(*impostors.shader);
+        }
+        if (queries)
+            glEndQuery(GL_SAMPLES_PASSED);
+
+        // deferred light pass into the window: the lights reaching every pixel over the whole screen, then each
+        // firefly over its volume
+        if (deferredShading) {
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(0, 0, framebufferWidth, framebufferHeight);
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            deferred.CopyDepth(0);
+            deferred.Bind();
+            glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+            deferredLightShader.use();
+            deferredLightShader.setVec3(deferredLightViewPos, camera.Position);
+            deferredLightShader.setMat4(deferredLightInverseViewProjection, inverseViewProjection);
+            deferred.DrawFullScreen();
+
+            if (queries)
+                glBeginQuery(GL_SAMPLES_PASSED, queries->lightSamples);
+            deferredPointLightShader.use();
+            deferredPointLightShader.setVec3(pointLightViewPos, camera.Position);
+            deferredPointLightShader.setMat4(pointLightProjection, projection);
+            deferredPointLightShader.setMat4(pointLightView, view);
+            deferredPointLightShader.setMat4(pointLightInverseViewProjection, inverseViewProjection);
+            deferred.DrawPointLights(fireflyLights);
+            if (queries)
+                glEndQuery(GL_SAMPLES_PASSED);
+        }
 
         // also draw the lamp object(s)
         lightCubeShader.use();
-        lightCubeShader.setMat4("projection", projection);
-        lightCubeShader.setMat4("view", view);
-
-        // render fireflies as small glowing cubes
-        glBindVertexArray(lightCubeVAO);
-        for (size_t i = 0; i < fireflies.size(); i++)
-        {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, fireflies[i].position);
-            model = glm::scale(model, glm::vec3(0.1f)); // Make them very small
-            lightCubeShader.setMat4("model", model);
-            lightCubeShader.setVec3("lightColor", fireflies[i].color);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+        lightCubeShader.setMat4(lampProjection, projection);
+        lightCubeShader.setMat4(lampView, view);
+        lightCubeShader.setFloat(lampSize, 0.1f); // Make them very small
+
+        // render fireflies as small glowing cubes, all in one draw
+        fireflySwarm.Draw(lightCubeVAO, 36);
+
+        if (queries) {
+            glEndQuery(GL_TIME_ELAPSED);
+            queries->pending = true;
+        }
+        if (currentTime - lastShadingPrint > 3.0f) {
+            printShadingStats(shadingStats, framebufferWidth * framebufferHeight);
+            lastShadingPrint = currentTime;
         }
 
+        // uniform traffic of one frame, once the tree is built and every name has been resolved
+        if (++frameCount == 2)
+            printUniformTraffic(frameStart, Shader::stats(), lightClusters);
+
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
         glfwSwapBuffers(window);
@@ -378,6 +607,11 @@ int main()
     glDeleteVertexArrays(1, &cubeVAO);
     glDeleteVertexArrays(1, &lightCubeVAO);
     glDeleteBuffers(1, &VBO);
+    for (FrameQueries& queries : frameQueries) {
+        glDeleteQueries(1, &queries.gpuTime);
+        glDeleteQueries(1, &queries.sceneSamples);
+        glDeleteQueries(1, &queries.lightSamples);
+    }
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
@@ -400,6 +634,14 @@ void processInput(GLFWwindow* window)
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+
+    // G switches between forward and deferred shading, once per press
+    bool deferredShadingKey = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+    if (deferredShadingKey && !deferredShadingKeyDown) {
+        deferredShading = !deferredShading;
+        printf("%s shading\n", deferredShading ? "deferred" : "forward");
+    }
+    deferredShadingKeyDown = deferredShadingKey;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -480,168 +722,279 @@ unsigned int loadTexture(char const* path)
     return textureID;
 }
 
-// Function to generate the L-system string
-std::string generateLSystem(const std::string& axiom, const std::map<char, std::string>& rules, int iterations) {
-    std::string current = axiom;
-    for (int i = 0; i < iterations; ++i) {
-        std::string next = "";
-        for (char c : current) {
-            if (rules.count(c)) {
-                next += rules.at(c);
-            }
-            else {
-                next += c;
-            }
-        }
-        current = next;
+// Time and memory of deriving the system with 1 to maxIterations iterations: building the whole string,
+// streaming it with a cursor (both counting the F symbols) and seeking to its middle
+void printLSystemCosts(const LSystem& system, int maxIterations) {
+    printf("%10s %14s | %12s %10s | %12s %10s | %10s\n", "iterations", "symbols", "string KB", "ms", "stream KB", "ms", "seek us");
+    LSystem measured = system;
+    for (int iterations = 1; iterations <= maxIterations; iterations++) {
+        measured.SetIterations(iterations);
+
+        auto start = std::chrono::steady_clock::now();
+        std::string materialized = measured.Materialize();
+        size_t stringSegments = std::count(materialized.begin(), materialized.end(), 'F');
+        double stringMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        size_t stringBytes = materialized.capacity();
+        materialized = std::string();
+
+        start = std::chrono::steady_clock::now();
+        size_t streamSegments = 0;
+        LSystem::Cursor cursor = measured.Begin();
+        size_t cursorBytes = cursor.GetMemorySize();
+        for (; !cursor.Done(); cursor.Next())
+            streamSegments += cursor.Get() == 'F';
+        double streamMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        char middle = measured.At(measured.GetLength() / 2);
+        double seekUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+        printf("%10d %14zu | %12.1f %10.2f | %12.1f %10.2f | %10.2f%s\n", iterations, measured.GetLength(),
+            stringBytes / 1024.0, stringMs, (measured.GetMemorySize() + cursorBytes) / 1024.0, streamMs, seekUs,
+            stringSegments != streamSegments || middle == 0 ? "  MISMATCH" : "");
     }
-    return current;
 }
 
-// Function to render the L-system tree using turtle graphics
-void renderLSystemTree(const std::string& lSystemStr, Shader& shader, unsigned int VAO,
-    TurtleState initialTurtleState,
-    float angle, float scaleFactor, float currentTime, // currentTime is already there
-    float animationProgress) // <--- NEW: Pass animationProgress here
-{
-    std::stack<TurtleState> stateStack;
-    TurtleState currentState = initialTurtleState;
-
-    glm::vec3 segmentDefaultUp = glm::vec3(0.0f, 1.0f, 0.0f);
+// Time of deriving the string generation by generation and of interpreting it with the turtle split at
+// brackets, on 1, 2, 4... up to every hardware thread, each result compared with the serial one
+void printLSystemParallelScaling(const LSystem& system, int iterations, const TurtleState& initialTurtleState) {
+    LSystem measured = system;
+    measured.SetIterations(iterations);
+    std::string expected = measured.Materialize();
+    std::vector<SegmentInstance> expectedSegments = LSystemTree::Interpret(measured, initialTurtleState, lSystemBranchAngle, lSystemBranchScale);
+    printf("%zu symbols, %zu segments at %d iterations\n%10s | %10s %10s | %10s %10s\n", expected.size(), expectedSegments.size(), iterations,
+        "threads", "derive ms", "speedup", "turtle ms", "speedup");
+
+    int maxThreads = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+    double singleMs = 0.0, singleTurtleMs = 0.0;
+    for (int threads = 1; ; threads = std::min(threads * 2, maxThreads)) {
+        TaskPool pool(threads);
+        auto start = std::chrono::steady_clock::now();
+        std::string derived = measured.MaterializeParallel(pool);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        // with one thread this is the streamed serial turtle
+        start = std::chrono::steady_clock::now();
+        std::vector<SegmentInstance> segments = LSystemTree::Interpret(measured, initialTurtleState, lSystemBranchAngle, lSystemBranchScale, &pool);
+        double turtleMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        bool segmentsMatch = segments.size() == expectedSegments.size()
+            && std::memcmp(segments.data(), expectedSegments.data(), segments.size() * sizeof(SegmentInstance)) == 0;
+
+        if (threads == 1) {
+            singleMs = ms;
+            singleTurtleMs = turtleMs;
+        }
+        printf("%10d | %10.2f %9.2fx | %10.2f %9.2fx%s\n", threads, ms, singleMs / ms, turtleMs, singleTurtleMs / turtleMs,
+            derived != expected || !segmentsMatch ? "  MISMATCH" : "");
+        if (threads == maxThreads)
+            break;
+    }
+}
 
-    // Calculate how many characters of the L-system string to process
-    // This will effectively grow the tree segment by segment.
-    size_t charsToProcess = static_cast<size_t>(lSystemStr.length() * animationProgress);
-    charsToProcess = glm::min(charsToProcess, lSystemStr.length()); // Ensure it doesn't exceed string length
+// print the size of each level of detail of the tree mesh
+void printLSystemMeshLods(const LSystemMesh& mesh) {
+    printf("%10s | %10s %10s %10s %10s\n", "tree LOD", "segments", "vertices", "triangles", "error");
+    for (int lod = 0; lod < mesh.GetLodCount(); lod++)
+        printf("%10d | %10zu %10zu %10zu %10.4f\n", lod, mesh.GetSegmentCount(lod), mesh.GetVertexCount(lod), mesh.GetTriangleCount(lod), mesh.GetError(lod));
+}
 
-    // The per-segment growth animation is now mostly handled by the overall progress
-    // We can simplify the smoothProgress or remove it if we want distinct segments popping in.
-    // For now, let's keep it simple and just draw segments if they are 'processed'.
+// Variants of the demo's tree and of a bushier 3D one with jittered angles and scales, scattered around the
+// single tree and baked into impostors
+void buildForest(LSystemForest& forest, const LSystem& system, const TurtleState& initialTurtleState, TaskPool& pool, const Shader& bakeShader) {
+    auto start = std::chrono::steady_clock::now();
+    std::mt19937 random(lSystemForestSeed);
+    auto jitter = [&random](float amount) { return 1.0f + amount * (static_cast<float>(random() >> 8) / 8388608.0f - 1.0f); };
+
+    // every variant grows from its own origin; the forest places it
+    TurtleState turtle = initialTurtleState;
+    turtle.position = glm::vec3(0.0f);
+    LSystem binary = system;
+    binary.SetIterations(glm::min(system.GetIterations(), 7));
+    for (int i = 0; i < 3; i++)
+        forest.AddVariant(binary, turtle, lSystemBranchAngle * jitter(0.25f), lSystemBranchScale * jitter(0.05f), &pool);
+
+    LSystem bush("A", 6);
+    bush.SetRule('A', "[&FA]/////[&FA]///////[&FA]");
+    bush.SetRule('F', "S/////F");
+    bush.SetRule('S', "F");
+    turtle.length = 1.0f;
+    turtle.thickness = 0.25f;
+    for (int i = 0; i < 3; i++)
+        forest.AddVariant(bush, turtle, 22.5f * jitter(0.25f), 0.8f * jitter(0.05f), &pool);
+
+    forest.Scatter(lSystemForestTreeCount, initialTurtleState.position, 8.0f, lSystemForestRadius, lSystemForestSeed);
+    forest.SetImpostorDistance(lSystemForestImpostorDistance, 5.0f);
+    forest.BakeImpostors(bakeShader);
+    printf("forest: %d trees of %d variants built and baked in %.1f ms\n", lSystemForestTreeCount, forest.GetVariantCount(),
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
 
-    for (size_t i = 0; i < charsToProcess; ++i) { // <--- CHANGE: Loop only up to charsToProcess
-        char c = lSystemStr[i];
-        switch (c) {
-        case 'F': // Draw a line segment and move forward
-        {
-            float currentSegmentLength = currentState.length; // No longer scaled by smoothProgress directly
-            float currentSegmentThickness = currentState.thickness;
+// the first fireflies as point lights, their radius where their attenuation leaves less than 8 bits show
+void fillFireflyLights(const FireflySwarm& swarm) {
+    fireflyLights.resize(std::min(swarm.GetCount(), fireflyLightCount));
+    for (size_t i = 0; i < fireflyLights.size(); i++) {
+        ClusteredPointLight& light = fireflyLights[i];
+        light.position = swarm.GetPosition(static_cast<int>(i));
+        light.color = swarm.GetColor(static_cast<int>(i));
+        light.ambient = 0.05f;
+        // the attenuation table's row for a range of 7, so each light covers few clusters however many there are
+        light.constant = 1.0f;
+        light.linear = 0.7f;
+        light.quadratic = 1.8f;
+        light.radius = LightClusters::LightRadius(light.color, light.constant, light.linear, light.quadratic);
+        light.padding = 0.0f;
+    }
+}
 
-            if (currentSegmentLength > 0.001f && currentSegmentThickness > 0.001f) {
-                glm::mat4 model = glm::mat4(1.0f);
-                model = glm::translate(model, currentState.position);
+// the scene's other lights in the Lights block's layout, shared by the trees and their impostors, with where
+// to find the fireflies' clusters
+void fillLightBlock(LightBlock& block, const LightClusters& clusters, int viewportWidth, int viewportHeight) {
+    // directional light
+    block.dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+    block.dirLight.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+    block.dirLight.diffuse = glm::vec3(0.4f, 0.4f, 0.4f);
+    block.dirLight.specular = glm::vec3(0.5f, 0.5f, 0.5f);
+    // firefly lights
+    block.clusterGrid = clusters.GetGridParameters();
+    block.clusterDepth = clusters.GetDepthParameters();
+    block.clusterTileScale = clusters.GetTileParameters(viewportWidth, viewportHeight);
+    // spotLight
+    block.spotLight.position = camera.Position;
+    block.spotLight.direction = camera.Front;
+    block.spotLight.ambient = glm::vec3(0.0f, 0.0f, 0.0f);
+    block.spotLight.diffuse = glm::vec3(1.0f, 1.0f, 1.0f);
+    block.spotLight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+    block.spotLight.constant = 1.0f;
+    block.spotLight.linear = 0.09f;
+    block.spotLight.quadratic = 0.032f;
+    block.spotLight.cutOff = glm::cos(glm::radians(12.5f));
+    block.spotLight.outerCutOff = glm::cos(glm::radians(15.0f));
+}
 
-                glm::vec3 rotationAxis = glm::cross(segmentDefaultUp, currentState.direction);
-                float rotationAngle = glm::acos(glm::dot(segmentDefaultUp, currentState.direction));
+// Uniform calls of a frame against what setting the lights by name took before they moved into the Lights
+// block and the clusters' buffers: per lit program, viewPos, 4 for the directional light, 7 per firefly light
+// and 10 for the spot light, each looking its location up by name
+void printUniformTraffic(const ShaderStats& frameStart, const ShaderStats& frameEnd, const LightClusters& clusters) {
+    size_t lightCallsByName = 1 + 4 + 7 * fireflyLights.size() + 10;
+    printf("uniforms per frame: %llu calls, %llu of them by name, %llu locations queried from GL, plus 1 light buffer upload of %zu bytes\n",
+        frameEnd.uniformCalls - frameStart.uniformCalls, frameEnd.nameLookups - frameStart.nameLookups,
+        frameEnd.locationQueries - frameStart.locationQueries, sizeof(LightBlock));
+    printf("  and %d point lights in %d clusters: %zu references, %.1f lights in an average lit cluster (%d of them), at most %d in one, %zu dropped\n",
+        clusters.GetLightCount(), clusters.GetClusterCount(), clusters.GetIndexCount(), clusters.GetAverageClusterLights(),
+        clusters.GetOccupiedClusterCount(), clusters.GetMaxClusterLights(), clusters.GetDroppedCount());
+    printf("  (the lights alone were %zu calls by name per lit program, %zu with the forest's impostors)\n",
+        lightCallsByName, 2 * lightCallsByName);
+}
 
-                if (glm::length(rotationAxis) > 0.001f) {
-                    model = glm::rotate(model, rotationAngle, glm::normalize(rotationAxis));
-                }
+// the uniforms a scene program is given every frame; impostor programs have no model, growth or time, which
+// leaves those at -1 and their setters doing nothing
+SceneProgram resolveSceneProgram(const Shader& shader) {
+    SceneProgram program;
+    program.shader = &shader;
+    program.viewPos = shader.getUniformLocation("viewPos");
+    program.projection = shader.getUniformLocation("projection");
+    program.view = shader.getUniformLocation("view");
+    program.model = shader.getUniformLocation("model");
+    program.growthProgress = shader.getUniformLocation("growthProgress");
+    program.time = shader.getUniformLocation("time");
+    return program;
+}
 
-                model = glm::scale(model, glm::vec3(currentSegmentThickness, currentSegmentLength, currentSegmentThickness));
+// adds the frame measured into queries to its path's totals once the GPU has all of its results, without
+// waiting for them; true if the queries are free to measure another frame
+bool readFrameQueries(FrameQueries& queries, ShadingPathStats stats[2]) {
+    if (!queries.pending)
+        return true;
+    // results only arrive in order within a target, so each is asked for
+    GLuint timeAvailable = GL_FALSE, sceneAvailable = GL_FALSE, lightAvailable = GL_TRUE;
+    glGetQueryObjectuiv(queries.gpuTime, GL_QUERY_RESULT_AVAILABLE, &timeAvailable);
+    glGetQueryObjectuiv(queries.sceneSamples, GL_QUERY_RESULT_AVAILABLE, &sceneAvailable);
+    if (queries.deferred)
+        glGetQueryObjectuiv(queries.lightSamples, GL_QUERY_RESULT_AVAILABLE, &lightAvailable);
+    if (!timeAvailable || !sceneAvailable || !lightAvailable)
+        return false;
+    GLuint64 gpuNanoseconds = 0;
+    GLuint sceneSamples = 0, lightSamples = 0;
+    glGetQueryObjectui64v(queries.gpuTime, GL_QUERY_RESULT, &gpuNanoseconds);
+    glGetQueryObjectuiv(queries.sceneSamples, GL_QUERY_RESULT, &sceneSamples);
+    if (queries.deferred)
+        glGetQueryObjectuiv(queries.lightSamples, GL_QUERY_RESULT, &lightSamples);
+    ShadingPathStats& path = stats[queries.deferred];
+    path.gpuMilliseconds += gpuNanoseconds * 1e-6;
+    path.sceneFragments += sceneSamples;
+    path.lightFragments += lightSamples;
+    path.measuredFrames++;
+    queries.pending = false;
+    return true;
+}
 
-                shader.setMat4("model", model);
-                glDrawArrays(GL_TRIANGLES, 0, 36);
-            }
-            currentState.position += currentState.direction * currentSegmentLength;
-        }
-        break;
-        // ... (rest of the cases +, -, &, ^, \, /, [, ]) ...
-        case '+':
-        {
-            currentState.direction = glm::rotate(currentState.direction, glm::radians(angle), currentState.up);
-            currentState.right = glm::rotate(currentState.right, glm::radians(angle), currentState.up);
-            currentState.direction = glm::normalize(currentState.direction);
-            currentState.right = glm::normalize(currentState.right);
-        }
-        break;
-        case '-':
-        {
-            currentState.direction = glm::rotate(currentState.direction, glm::radians(-angle), currentState.up);
-            currentState.right = glm::rotate(currentState.right, glm::radians(-angle), currentState.up);
-            currentState.direction = glm::normalize(currentState.direction);
-            currentState.right = glm::normalize(currentState.right);
-        }
-        break;
-        case '&':
-        {
-            currentState.direction = glm::rotate(currentState.direction, glm::radians(angle), currentState.right);
-            currentState.up = glm::rotate(currentState.up, glm::radians(angle), currentState.right);
-            currentState.direction = glm::normalize(currentState.direction);
-            currentState.up = glm::normalize(currentState.up);
-        }
-        break;
-        case '^':
-        {
-            currentState.direction = glm::rotate(currentState.direction, glm::radians(-angle), currentState.right);
-            currentState.up = glm::rotate(currentState.up, glm::radians(-angle), currentState.right);
-            currentState.direction = glm::normalize(currentState.direction);
-            currentState.up = glm::normalize(currentState.up);
-        }
-        break;
-        case '\\':
-        {
-            currentState.up = glm::rotate(currentState.up, glm::radians(angle), currentState.direction);
-            currentState.right = glm::rotate(currentState.right, glm::radians(angle), currentState.direction);
-            currentState.up = glm::normalize(currentState.up);
-            currentState.right = glm::normalize(currentState.right);
-        }
-        break;
-        case '/':
-        {
-            currentState.up = glm::rotate(currentState.up, glm::radians(-angle), currentState.direction);
-            currentState.right = glm::rotate(currentState.right, glm::radians(-angle), currentState.direction);
-            currentState.up = glm::normalize(currentState.up);
-            currentState.right = glm::normalize(currentState.right);
-        }
-        break;
-        case '[':
-            stateStack.push(currentState);
-            currentState.length *= scaleFactor;
-            currentState.thickness *= scaleFactor;
-            break;
-        case ']':
-            currentState = stateStack.top();
-            stateStack.pop();
-            break;
-        }
+// each path's averages since the last print: frame and GPU time, and the scene's fragments per pixel, which
+// forward shading lights as they're drawn and deferred shading only writes to the G-buffer, lighting its
+// light volumes' fragments instead. GPU figures average the frames whose queries have been read back so far.
+void printShadingStats(ShadingPathStats stats[2], int pixelCount) {
+    for (int deferred = 0; deferred < 2; deferred++) {
+        ShadingPathStats& path = stats[deferred];
+        if (path.frames == 0 || path.measuredFrames == 0)
+            continue;
+        printf("%s shading: %.2f ms a frame, %.2f ms on the GPU, %.2f scene fragments a pixel",
+            deferred ? "deferred" : "forward", 1000.0 * path.frameSeconds / path.frames, path.gpuMilliseconds / path.measuredFrames,
+            path.sceneFragments / path.measuredFrames / pixelCount);
+        if (deferred)
+            printf(", %.2f light volume fragments a pixel", path.lightFragments / path.measuredFrames / pixelCount);
+        printf(" over %d frames, %d measured on the GPU\n", path.frames, path.measuredFrames);
+        path = ShadingPathStats();
     }
 }
 
 // update firefly positions
-void updateFireflies(float deltaTime) {
+void updateFireflies(FireflySwarm& swarm, TaskPool& pool, float deltaTime) {
     // Define a fixed center for firefly orbits, near the base of the L-system tree
     glm::vec3 orbitCenter = glm::vec3(0.0f, -1.0f, 0.0f); // Roughly where the L-system tree starts to branch
 
-    for (auto& firefly : fireflies) {
-        firefly.orbitAngle += firefly.orbitSpeed * deltaTime;
-
-        // Calculate orbit position around the fixed center
-        float x = cos(firefly.orbitAngle) * firefly.orbitRadius;
-        float z = sin(firefly.orbitAngle) * firefly.orbitRadius;
-
-        // Add some vertical variation to the orbit
-        float y = sin(firefly.orbitAngle * 0.5f) * 0.3f; // Gentle vertical movement
-
-        firefly.position = orbitCenter + glm::vec3(x, y, z);
-    }
+    // each circles it with some vertical variation, sin(angle / 2) * 0.3, for gentle vertical movement
+    swarm.Update(deltaTime, orbitCenter, &pool);
 }
 
 // generate fireflies around the base of the tree
-void generateFireflies() {
+void generateFireflies(FireflySwarm& swarm, int count) {
     // Create fireflies centered around a fixed point
-    for (int i = 0; i < 12; i++) {
-        Firefly firefly;
-        // Structured orbits
-        firefly.orbitRadius = 1.5f + (static_cast<float>(i) * 0.1f); // Radii spread out
-        firefly.orbitSpeed = 0.5f + (static_cast<float>(i) * 0.05f); // Speeds vary slightly
-        firefly.orbitAngle = (static_cast<float>(i) * 30.0f) * 3.14159f / 180.0f; // Staggered initial angles
+    swarm.Resize(count);
+    for (int i = 0; i < count; i++) {
+        // Structured orbits, as many per unit of area at every radius
+        float orbitRadius = 1.5f + 1.2f * std::sqrt(static_cast<float>(i)); // Radii spread out
+        float orbitSpeed = 0.5f + (static_cast<float>(i % 12) * 0.05f); // Speeds vary slightly
+        float orbitAngle = (static_cast<float>(i) * 137.5f) * 3.14159f / 180.0f; // Staggered initial angles, golden angle apart
 
         // Structured firefly colors (warm, slightly varying hues)
         float r = 0.8f + (static_cast<float>(rand()) / RAND_MAX * 0.2f);
         float g = 0.6f + (static_cast<float>(rand()) / RAND_MAX * 0.2f);
         float b = 0.2f + (static_cast<float>(rand()) / RAND_MAX * 0.1f);
-        firefly.color = glm::vec3(r, g, b);
 
-        fireflies.push_back(firefly);
+        swarm.Set(i, orbitRadius, orbitSpeed, orbitAngle, glm::vec3(r, g, b));
+    }
+}
+
+// Time of one update of a swarm of count fireflies (the orbit step and streaming the positions into the mapped
+// instance buffer) on 1, 2, 4... up to every hardware thread, the best of a few frames
+void printFireflySwarmScaling(int count) {
+    FireflySwarm swarm;
+    generateFireflies(swarm, count);
+    printf("%d fireflies, %d SIMD lanes\n%10s | %10s %10s\n", count, SimdFloat::Width, "threads", "update ms", "speedup");
+
+    int maxThreads = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+    double singleMs = 0.0;
+    for (int threads = 1; ; threads = std::min(threads * 2, maxThreads)) {
+        TaskPool pool(threads);
+        double ms = 1e30;
+        for (int frame = 0; frame < 8; frame++) {
+            auto start = std::chrono::steady_clock::now();
+            updateFireflies(swarm, pool, 1.0f / 60.0f);
+            ms = std::min(ms, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        if (threads == 1)
+            singleMs = ms;
+        printf("%10d | %10.2f %9.2fx\n", threads, ms, singleMs / ms);
+        if (threads == maxThreads)
+            break;
     }
 }
\ No newline at end of file
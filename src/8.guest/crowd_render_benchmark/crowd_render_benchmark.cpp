@@ -0,0 +1,196 @@
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/shader_m.h>
+#include <learnopengl/model_animation.h>
+#include <learnopengl/bone_palette.h>
+#include <learnopengl/instance_palette.h>
+#include <learnopengl/crowd_animator.h>
+#include <learnopengl/task_pool.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Headless: renders through EGL without a window, so it runs on Mesa's llvmpipe software renderer with no
+// display or GPU (LIBGL_ALWAYS_SOFTWARE=1 picks llvmpipe even where a GPU is present)
+
+bool createContext();
+std::vector<glm::mat4> gridModels(int instanceCount);
+struct FrameTiming
+{
+	int drawCalls = 0;
+	double submitMs = 0.0; // issuing the frame's GL calls
+	double frameMs = 0.0;  // until the renderer has finished it
+};
+FrameTiming measureFrames(const std::function<int()>& drawFrame);
+
+// settings
+const unsigned int SCR_WIDTH = 1000;
+const unsigned int SCR_HEIGHT = 800;
+const int instanceCounts[] = { 1, 10, 100, 250, 500, 1000 };
+const int framesPerMeasurement = 10;
+
+int main()
+{
+	if (!createContext())
+		return -1;
+	if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+	{
+		printf("Failed to initialize GLAD\n");
+		return -1;
+	}
+	printf("renderer: %s\n", glGetString(GL_RENDERER));
+
+	// everything goes to an offscreen framebuffer the size of the demo's window
+	unsigned int framebuffer, colorBuffer, depthBuffer;
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glGenRenderbuffers(1, &colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, SCR_WIDTH, SCR_HEIGHT);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		printf("Framebuffer is not complete\n");
+		return -1;
+	}
+	glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+	glEnable(GL_DEPTH_TEST);
+
+	stbi_set_flip_vertically_on_load(true);
+	const std::string shaderDirectory = FileSystem::getPath("src/8.guest/skeletal_animation/");
+	Shader ourShader((shaderDirectory + "anim_model.vs").c_str(), (shaderDirectory + "anim_model.fs").c_str());
+	BonePaletteBuffer bonePalette;
+	bonePalette.BindShader(ourShader);
+	InstancePaletteBuffer instancePalette;
+	instancePalette.BindShader(ourShader);
+
+	Model ourModel(FileSystem::getPath("resources/objects/skelly/skelly.dae"));
+	Animation idle(FileSystem::getPath("resources/objects/skelly/Idle.dae"), &ourModel);
+	Animation dance(FileSystem::getPath("resources/objects/skelly/Breakdance_1990.dae"), &ourModel);
+	Animation moonwalk(FileSystem::getPath("resources/objects/skelly/Moonwalk.dae"), &ourModel);
+
+	TaskPool pool;
+	printf("%zu meshes, %d frames per measurement; submit is the CPU time to issue a frame, frame includes glFinish\n",
+		ourModel.meshes.size(), framesPerMeasurement);
+	printf("  %10s | %26s | %26s | %8s\n", "", "per character", "instanced", "speedup");
+	printf("  %10s | %6s %9s %9s | %6s %9s %9s | %8s\n", "characters", "draws", "submit ms", "frame ms", "draws", "submit ms", "frame ms", "frame");
+	for (int instanceCount : instanceCounts)
+	{
+		// the crowd is animated once and both paths draw the same palettes, so only rendering is timed
+		CrowdAnimator crowd(&idle);
+		int clips[3] = { crowd.AddClip(&idle), crowd.AddClip(&dance), crowd.AddClip(&moonwalk) };
+		for (int i = 0; i < instanceCount; i++)
+			crowd.AddInstance(clips[i % 3], 0.37f * i);
+		crowd.Update(1.0f, pool);
+		std::vector<glm::mat4> models = gridModels(instanceCount);
+
+		int columns = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(instanceCount))));
+		glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
+		glm::mat4 view = glm::lookAt(glm::vec3(0.0f, columns * 0.6f, columns * 0.9f + 2.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		ourShader.use();
+		ourShader.setMat4("projection", projection);
+		ourShader.setMat4("view", view);
+
+		// one palette upload and one Model::Draw per character, as the demo draws its one character
+		FrameTiming perCharacter = measureFrames([&]()
+		{
+			ourShader.use();
+			for (int i = 0; i < instanceCount; i++)
+			{
+				bonePalette.Upload(crowd.GetPalette(i), crowd.GetBoneCount());
+				ourShader.setMat4("model", models[i]);
+				ourModel.Draw(ourShader);
+			}
+			return instanceCount * static_cast<int>(ourModel.meshes.size());
+		});
+
+		FrameTiming instanced = measureFrames([&]()
+		{
+			instancePalette.SetInstances(models.data(), crowd.GetPalettes().data(), instanceCount, crowd.GetBoneCount());
+			return instancePalette.Draw(ourModel, ourShader);
+		});
+
+		printf("  %10d | %6d %9.2f %9.2f | %6d %9.2f %9.2f | %7.2fx\n", instanceCount,
+			perCharacter.drawCalls, perCharacter.submitMs, perCharacter.frameMs,
+			instanced.drawCalls, instanced.submitMs, instanced.frameMs, perCharacter.frameMs / instanced.frameMs);
+	}
+	return 0;
+}
+
+// Surfaceless EGL context with desktop GL 3.3 core, the version the demos ask GLFW for
+// -------------------------------------------------------------------------------------
+bool createContext()
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	EGLDisplay display = getPlatformDisplay ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL) : EGL_NO_DISPLAY;
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor) || !eglBindAPI(EGL_OPENGL_API))
+	{
+		printf("Failed to initialize surfaceless EGL (needs Mesa)\n");
+		return false;
+	}
+
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttributes);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+	{
+		printf("Failed to create an OpenGL 3.3 context\n");
+		return false;
+	}
+	return true;
+}
+
+// Characters on a square grid around the origin, at the scale the demo draws skelly
+// ----------------------------------------------------------------------------------
+std::vector<glm::mat4> gridModels(int instanceCount)
+{
+	int columns = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(instanceCount))));
+	std::vector<glm::mat4> models(instanceCount);
+	for (int i = 0; i < instanceCount; i++)
+	{
+		glm::vec3 position((i % columns - (columns - 1) * 0.5f) * 0.8f, -0.4f, (i / columns - (columns - 1) * 0.5f) * 0.8f);
+		models[i] = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.5f));
+	}
+	return models;
+}
+
+// Average times of drawFrame over framesPerMeasurement frames after one warm-up frame, waiting for the
+// renderer to finish each; drawFrame returns its number of draw calls
+// ---------------------------------------------------------------------------------------------------------
+FrameTiming measureFrames(const std::function<int()>& drawFrame)
+{
+	FrameTiming timing;
+	for (int i = 0; i <= framesPerMeasurement; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		timing.drawCalls = drawFrame();
+		auto submitted = std::chrono::steady_clock::now();
+		glFinish();
+		if (i == 0)
+			continue;
+		timing.submitMs += std::chrono::duration<double, std::milli>(submitted - start).count() / framesPerMeasurement;
+		timing.frameMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / framesPerMeasurement;
+	}
+	return timing;
+}
@@ -0,0 +1,229 @@
+#include <assimp/scene.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/bone.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Headless: nothing here touches OpenGL, so it runs without a GPU or a display
+
+enum Pattern
+{
+	FORWARD = 0,
+	LOOP_WRAP,
+	RANDOM_SEEK,
+	PATTERN_COUNT
+};
+
+struct Sample
+{
+	glm::vec3 position;
+	glm::quat rotation;
+	glm::vec3 scale;
+};
+
+Bone buildSyntheticBone(int keyCount, std::mt19937& random);
+std::vector<float> playbackTimes(Pattern pattern, int keyCount, std::mt19937& random);
+Sample sampleLinearScan(const Bone& bone, float animationTime);
+Sample sampleCursor(const Bone& bone, float animationTime, BoneCursor& cursor);
+template <typename SampleFunction>
+double nanosecondsPerSample(const std::vector<float>& times, SampleFunction sample);
+
+// settings
+const int trackLengths[] = { 100, 1000, 10000, 100000 };
+const char* patternNames[PATTERN_COUNT] = { "forward", "loop wraps", "random seeks" };
+const int samplesPerPass = 4096;
+const double secondsPerMeasurement = 0.2;
+
+// written by every timed sample so none of them can be optimized away
+float checksum = 0.0f;
+
+int main()
+{
+	printf("ns per sample of one bone's position, rotation and scale tracks, keys about one tick apart\n");
+	printf("%8s  %-13s %12s %10s %10s %16s\n", "keys", "pattern", "linear scan", "cursor", "resampled", "resample error");
+
+	std::mt19937 random(1234);
+	for (int keyCount : trackLengths)
+	{
+		Bone bone = buildSyntheticBone(keyCount, random);
+		// one sample per tick over the same span, as Animator::ResampleAnimation would at the clip's tick rate
+		Bone resampled = bone;
+		resampled.Resample(1.0f, static_cast<float>(keyCount - 1));
+
+		for (int pattern = 0; pattern < PATTERN_COUNT; pattern++)
+		{
+			std::vector<float> times = playbackTimes(static_cast<Pattern>(pattern), keyCount, random);
+
+			// the cursor must find the very keys the scan does; resampling moves the keys, so it's only close
+			int mismatches = 0;
+			float resampleError = 0.0f;
+			BoneCursor cursor, resampledCursor;
+			for (float time : times)
+			{
+				Sample expected = sampleLinearScan(bone, time);
+				Sample fromCursor = sampleCursor(bone, time, cursor);
+				Sample fromResampled = sampleCursor(resampled, time, resampledCursor);
+				if (fromCursor.position != expected.position || fromCursor.scale != expected.scale)
+					mismatches++;
+				resampleError = glm::max(resampleError, glm::length(fromResampled.position - expected.position));
+			}
+			if (mismatches > 0)
+				printf("cursor lookup differs from the linear scan in %d of %d samples\n", mismatches, samplesPerPass);
+
+			double linearNs = nanosecondsPerSample(times, [&](float time) { return sampleLinearScan(bone, time); });
+			cursor = BoneCursor();
+			double cursorNs = nanosecondsPerSample(times, [&](float time) { return sampleCursor(bone, time, cursor); });
+			resampledCursor = BoneCursor();
+			double resampledNs = nanosecondsPerSample(times, [&](float time) { return sampleCursor(resampled, time, resampledCursor); });
+
+			printf("%8d  %-13s %12.1f %10.1f %10.1f %16g\n", keyCount, patternNames[pattern], linearNs, cursorNs, resampledNs, resampleError);
+		}
+	}
+	return 0;
+}
+
+// One bone with keyCount position, rotation and scale keys. The first and last keys sit on ticks 0 and
+// keyCount - 1, the ones between up to 0.3 ticks off their tick, as exporters that drop redundant keys leave
+// them: evenly spaced tracks would be indexed directly by the cursor path too, leaving nothing to compare.
+// ------------------------------------------------------------------------------------------------------------
+Bone buildSyntheticBone(int keyCount, std::mt19937& random)
+{
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	aiNodeAnim channel;
+	channel.mNumPositionKeys = keyCount;
+	channel.mNumRotationKeys = keyCount;
+	channel.mNumScalingKeys = keyCount;
+	channel.mPositionKeys = new aiVectorKey[keyCount];
+	channel.mRotationKeys = new aiQuatKey[keyCount];
+	channel.mScalingKeys = new aiVectorKey[keyCount];
+	for (int i = 0; i < keyCount; i++)
+	{
+		double time = i == 0 || i == keyCount - 1 ? i : i + 0.3 * unit(random);
+		glm::quat rotation = glm::normalize(glm::quat(unit(random), unit(random), unit(random), unit(random)));
+
+		aiVectorKey& position = channel.mPositionKeys[i];
+		position.mTime = time;
+		position.mValue.x = unit(random);
+		position.mValue.y = unit(random);
+		position.mValue.z = unit(random);
+
+		aiQuatKey& orientation = channel.mRotationKeys[i];
+		orientation.mTime = time;
+		orientation.mValue.w = rotation.w;
+		orientation.mValue.x = rotation.x;
+		orientation.mValue.y = rotation.y;
+		orientation.mValue.z = rotation.z;
+
+		aiVectorKey& scale = channel.mScalingKeys[i];
+		scale.mTime = time;
+		scale.mValue.x = scale.mValue.y = scale.mValue.z = 1.0f + 0.1f * unit(random);
+	}
+	// the channel frees its key arrays, Bone has copied them
+	return Bone("synthetic", 0, &channel);
+}
+
+// samplesPerPass animation times (in ticks) for a track spanning [0, keyCount - 1], all short of its last key:
+// - forward: steady playback at two samples per key, wrapping at the end; it starts a little before the
+//   middle of long tracks, so the linear scan pays its cost averaged over a whole loop
+// - loop wraps: every other sample wraps from the end of the track back to its start, the others jump
+//   forward to the end again
+// - random seeks: anywhere in the track
+// ------------------------------------------------------------------------------------------------------------
+std::vector<float> playbackTimes(Pattern pattern, int keyCount, std::mt19937& random)
+{
+	float duration = static_cast<float>(keyCount - 1);
+	std::uniform_real_distribution<float> halfTick(0.0f, 0.5f);
+	std::uniform_real_distribution<float> anywhere(0.0f, duration);
+
+	float forwardStart = glm::max(0.0f, 0.5f * duration - 0.25f * samplesPerPass);
+
+	std::vector<float> times(samplesPerPass);
+	for (int i = 0; i < samplesPerPass; i++)
+	{
+		if (pattern == FORWARD)
+			times[i] = std::fmod(forwardStart + 0.5f * i, duration);
+		else if (pattern == LOOP_WRAP)
+			times[i] = i % 2 == 0 ? duration - halfTick(random) - 0.01f : halfTick(random);
+		else
+			times[i] = anywhere(random);
+	}
+	return times;
+}
+
+// The lookup Bone used before playback cursors: every track is scanned from its first key
+// ------------------------------------------------------------------------------------------------------------
+template <typename Key>
+int linearScan(const std::vector<Key>& keys, float animationTime)
+{
+	for (int index = 0; index < static_cast<int>(keys.size()) - 1; ++index)
+	{
+		if (animationTime < keys[index + 1].timeStamp)
+			return index;
+	}
+	return static_cast<int>(keys.size()) - 2;
+}
+
+Sample sampleLinearScan(const Bone& bone, float animationTime)
+{
+	const std::vector<KeyPosition>& positions = bone.GetPositionKeys();
+	const std::vector<KeyRotation>& rotations = bone.GetRotationKeys();
+	const std::vector<KeyScale>& scales = bone.GetScaleKeys();
+	Sample sample;
+
+	int p0Index = linearScan(positions, animationTime);
+	float scaleFactor = bone.GetScaleFactor(positions[p0Index].timeStamp, positions[p0Index + 1].timeStamp, animationTime);
+	sample.position = glm::mix(positions[p0Index].position, positions[p0Index + 1].position, scaleFactor);
+
+	p0Index = linearScan(rotations, animationTime);
+	scaleFactor = bone.GetScaleFactor(rotations[p0Index].timeStamp, rotations[p0Index + 1].timeStamp, animationTime);
+	sample.rotation = glm::normalize(glm::slerp(rotations[p0Index].orientation, rotations[p0Index + 1].orientation, scaleFactor));
+
+	p0Index = linearScan(scales, animationTime);
+	scaleFactor = bone.GetScaleFactor(scales[p0Index].timeStamp, scales[p0Index + 1].timeStamp, animationTime);
+	sample.scale = glm::mix(scales[p0Index].scale, scales[p0Index + 1].scale, scaleFactor);
+	return sample;
+}
+
+// Bone's own path: cursor lookup on the original keys, direct indexing on resampled ones
+// ------------------------------------------------------------------------------------------------------------
+Sample sampleCursor(const Bone& bone, float animationTime, BoneCursor& cursor)
+{
+	Sample sample;
+	sample.position = bone.GetInterpolatedPosition(animationTime, cursor);
+	sample.rotation = bone.GetInterpolatedRotation(animationTime, cursor);
+	sample.scale = bone.GetInterpolatedScaling(animationTime, cursor);
+	return sample;
+}
+
+// Passes over times for about secondsPerMeasurement after one warm-up pass
+// ------------------------------------------------------------------------------------------------------------
+template <typename SampleFunction>
+double nanosecondsPerSample(const std::vector<float>& times, SampleFunction sample)
+{
+	auto pass = [&]()
+	{
+		for (float time : times)
+		{
+			Sample result = sample(time);
+			checksum += result.position.x + result.rotation.w + result.scale.x;
+		}
+	};
+
+	pass();
+	int passes = 0;
+	double seconds = 0.0;
+	auto start = std::chrono::steady_clock::now();
+	do
+	{
+		pass();
+		passes++;
+		seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	} while (seconds < secondsPerMeasurement);
+	return seconds * 1e9 / (static_cast<double>(passes) * times.size());
+}
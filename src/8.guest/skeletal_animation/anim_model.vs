@@ -14,28 +14,53 @@ uniform mat4 model;
 
 const int MAX_BONES = 100;
 const int MAX_BONE_INFLUENCE = 4;
-uniform mat4 finalBonesMatrices[MAX_BONES];
+// Bone matrices are affine, so only their top three rows are stored, as the columns of a mat3x4:
+// vec4(p, 1.0) * m transforms p
+layout (std140) uniform BonePalette
+{
+    mat3x4 finalBonesMatrices[MAX_BONES];
+};
+
+// Instanced crowds (InstancePaletteBuffer): every instance's model matrix followed by its bone matrices,
+// three texels per matrix, starting at gl_InstanceID * instanceStride matrices
+uniform bool instanced;
+uniform samplerBuffer instanceMatrices;
+uniform int instanceStride;
+
+mat3x4 fetchMatrix(int index)
+{
+    int texel = index * 3;
+    return mat3x4(texelFetch(instanceMatrices, texel), texelFetch(instanceMatrices, texel + 1),
+                  texelFetch(instanceMatrices, texel + 2));
+}
+
+mat4 toMat4(mat3x4 m)
+{
+    return transpose(mat4(m[0], m[1], m[2], vec4(0.0, 0.0, 0.0, 1.0)));
+}
 
 out vec2 TexCoords;
 
 void main()
 {
+    int instanceBase = gl_InstanceID * instanceStride;
+    int boneCount = instanced ? instanceStride - 1 : MAX_BONES;
     vec4 totalPosition = vec4(0.0f);
     for(int i = 0 ; i < MAX_BONE_INFLUENCE ; i++)
     {
         if(boneIds[i] == -1) 
             continue;
-        if(boneIds[i] >=MAX_BONES) 
+        if(boneIds[i] >=boneCount) 
         {
             totalPosition = vec4(pos,1.0f);
             break;
         }
-        vec4 localPosition = finalBonesMatrices[boneIds[i]] * vec4(pos,1.0f);
+        mat3x4 boneMatrix = instanced ? fetchMatrix(instanceBase + 1 + boneIds[i]) : finalBonesMatrices[boneIds[i]];
+        vec4 localPosition = vec4(vec4(pos,1.0f) * boneMatrix, 1.0f);
         totalPosition += localPosition * weights[i];
-        vec3 localNormal = mat3(finalBonesMatrices[boneIds[i]]) * norm;
    }
 	
-    mat4 viewModel = view * model;
+    mat4 viewModel = view * (instanced ? toMat4(fetchMatrix(instanceBase)) : model);
     gl_Position =  projection * viewModel * totalPosition;
 	TexCoords = tex;
 }
@@ -10,14 +10,26 @@
 #include <learnopengl/camera.h>
 #include <learnopengl/animator.h>
 #include <learnopengl/model_animation.h>
-
+#include <learnopengl/bone_palette.h>
+#include <learnopengl/instance_palette.h>
+#include <learnopengl/crowd_animator.h>
+#include <learnopengl/cooked_animation.h>
+#include <learnopengl/clip_manager.h>
+
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <memory>
 
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
+void measureCrowdScaling(Animation* idle, Animation* dance, Animation* moonwalk, int instanceCount);
+void measureCrowdLod(Animation* idle, Animation* dance, Animation* moonwalk, int instanceCount, int boneBudget);
+void printBakeTradeoffs(Animation* animation, const char* name);
+void printInstanceFootprint(const std::shared_ptr<const Skeleton>& skeleton, Animation* clip1, Animation* clip2, int instanceCount);
 
 // settings
 const unsigned int SCR_WIDTH = 1000;
@@ -29,23 +41,57 @@ float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
 
+// load skeleton and clips from a cooked binary file next to the DAE files, cooking it whenever it's
+// missing or older than the sources. Only SIMD sampling of whole clips works from it; the other options
+// below need the Assimp-loaded clips and always use the DAE path.
+const bool useCookedAnimations = true;
+
+// Scalar samples bone by bone, SoaSimd all bones at once from structure-of-arrays clips,
+// Compressed from quantized, key-reduced copies of the clips
+const SamplingPath samplingPath = SamplingPath::SoaSimd;
+// the SIMD sampler's largest acceptable difference from the scalar path (position and scale in model
+// units, rotation in radians). Its nlerp stays within 1e-4 rad of slerp for keys up to 90 degrees apart and
+// under 1e-3 rad for any keys, so a larger error means a sampling bug rather than the approximation
+const SoaSamplingError soaSamplingTolerance = { 1e-3f, 1e-3f, 1e-4f };
+
+// play unblended clips from palettes baked at bakeRate frames per second (Disabled samples them live)
+const BakedPlayback bakedPlayback = BakedPlayback::Disabled;
+const float bakeRate = 30.0f;
+
+// print the memory/CPU/error table of baked playback at a few rates before starting
+const bool measureBaking = false;
+
+// time a crowd update at 1 to 16 threads before starting (number of characters, 0 to skip)
+const int crowdScalingInstances = 0;
+
+// with the crowd above, compare full-rate updates against update-rate LOD with and without a budget of
+// this many bone evaluations per frame (0 to skip)
+const int crowdLodBoneBudget = 0;
+
+// print the memory of this many animators sharing one skeleton before starting (0 to skip)
+const int footprintInstances = 0;
+
+// animate this many extra characters on a grid behind the first and draw them all with one instanced draw
+// call per mesh (0 to skip)
+const int crowdRenderInstances = 0;
+
+// on the DAE path with SoaSimd sampling, load only the idle clip before the first frame and the others on a
+// background thread when they're first wanted, prefetching the clips reachable from the current state (the
+// cooked file already maps its clips on demand). Time to first frame and peak clip memory are printed either way.
+const bool lazyClipLoading = true;
+// estimated bytes of loaded clips above which the least recently used ones are freed again (0 for no limit)
+const size_t clipMemoryBudget = 0;
+
 // timing
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-// Flags for desired animation state (mutually exclusive)
-bool requestDance = false;
-bool requestMoonwalk = false;
-
-
-enum AnimState {
-	IDLE = 1,
-	IDLE_DANCE,
-	DANCE_IDLE,
-	IDLE_MOONWALK,
-	MOONWALK_IDLE,
+// Clips of the locomotion blend, in the order they're added to the blend tree
+enum LocomotionClip {
+	IDLE = 0,
 	DANCE,
-	MOONWALK
+	MOONWALK,
+	CLIP_COUNT
 };
 
 int main()
@@ -97,17 +143,183 @@ int main()
 	// -------------------------
 	Shader ourShader("anim_model.vs", "anim_model.fs");
 
+	// bone matrices go to the shader's BonePalette uniform block in one buffer update per frame
+	BonePaletteBuffer bonePalette;
+	bonePalette.BindShader(ourShader);
+
+	// a crowd's matrices all go to one texture buffer instead; its sampler needs a unit of its own even
+	// when no crowd is drawn
+	InstancePaletteBuffer instancePalette;
+	instancePalette.BindShader(ourShader);
+
 
 	// load models
 	// -----------
-	Model ourModel(FileSystem::getPath("resources/objects/skelly/skelly.dae"));
-	Animation idleAnimation(FileSystem::getPath("resources/objects/skelly/Idle.dae"), &ourModel);
-	Animation danceAnimation(FileSystem::getPath("resources/objects/skelly/Breakdance_1990.dae"), &ourModel);
-	Animation moonwalkAnimation(FileSystem::getPath("resources/objects/skelly/Moonwalk.dae"), &ourModel);
-	Animator animator(&idleAnimation);
-	enum AnimState charState = IDLE;
-	float blendAmount = 0.0f;
+	auto startupStart = std::chrono::steady_clock::now();
+	// the mesh still comes from Assimp, only the animation data is cooked
+	const std::string modelPath = FileSystem::getPath("resources/objects/skelly/skelly.dae");
+	Model ourModel(modelPath);
+
+	const std::string clipPaths[CLIP_COUNT] = {
+		FileSystem::getPath("resources/objects/skelly/Idle.dae"),
+		FileSystem::getPath("resources/objects/skelly/Breakdance_1990.dae"),
+		FileSystem::getPath("resources/objects/skelly/Moonwalk.dae")
+	};
+	const std::vector<std::string> clipNames = { "IDLE", "DANCE", "MOONWALK" };
+	const std::vector<std::string> sourcePaths = { modelPath, clipPaths[IDLE], clipPaths[DANCE], clipPaths[MOONWALK] };
+	const std::string cookedPath = FileSystem::getPath("resources/objects/skelly/skelly.animcooked");
+	bool needsSourceClips = samplingPath != SamplingPath::SoaSimd || bakedPlayback != BakedPlayback::Disabled || measureBaking || crowdScalingInstances > 0
+		|| footprintInstances > 0 || crowdRenderInstances > 0;
+
+	// startup cost of the animation data: run twice to see the cold (DAE, then cooking) and warm (cooked) paths
+	auto loadStart = std::chrono::steady_clock::now();
+	CookedAnimationFile cooked;
+	bool useCooked = useCookedAnimations && !needsSourceClips && cooked.Open(cookedPath, sourcePaths);
+	for (int clip = 0; clip < CLIP_COUNT && useCooked; clip++)
+		useCooked = cooked.FindClip(clipNames[clip]) >= 0;
+	// the clip manager owns the DAE clips; lazily only idle is loaded here, the rest as the state machine
+	// asks for them
+	AnimationClipManager clipManager(&ourModel, clipMemoryBudget);
+	for (int clip = 0; clip < CLIP_COUNT; clip++)
+		clipManager.AddClip(clipPaths[clip]);
+	bool lazyClips = lazyClipLoading && !useCooked && !needsSourceClips;
+	Animation* animations[CLIP_COUNT] = {};
+	if (!useCooked)
+		for (int clip = 0; clip < CLIP_COUNT; clip++)
+			if (!lazyClips || clip == IDLE)
+				animations[clip] = clipManager.Load(clip);
+	Animator animator = useCooked ? Animator(cooked.GetSharedSkeleton()) : Animator(animations[IDLE]);
+	if (animator.GetSkeleton().GetBoneCount() > BonePaletteBuffer::MaxBones)
+	{
+		std::cout << "ERROR::SKELETON:: " << animator.GetSkeleton().GetBoneCount() << " bones, anim_model.vs skins at most " << BonePaletteBuffer::MaxBones << std::endl;
+		glfwTerminate();
+		return -1;
+	}
+	printf("animation data loaded from %s in %.1f ms\n", useCooked ? "cooked file" : lazyClips ? "DAE files (idle only)" : "DAE files",
+		std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count());
+
+	// with lazy loading the file is written once every clip has been loaded
+	bool cookPending = !useCooked && useCookedAnimations;
+	auto cookClips = [&]()
+	{
+		std::vector<Animation*> clips = { clipManager.GetAnimation(IDLE), clipManager.GetAnimation(DANCE), clipManager.GetAnimation(MOONWALK) };
+		if (!CookedAnimationFile::Cook(cookedPath, sourcePaths, animator.GetSkeleton(), clips[IDLE]->GetBoneIDMap(), clipNames, clips))
+			printf("could not write %s\n", cookedPath.c_str());
+		cookPending = false;
+	};
+	if (cookPending && !lazyClips)
+		cookClips();
+
+	if (crowdScalingInstances > 0)
+		measureCrowdScaling(animations[IDLE], animations[DANCE], animations[MOONWALK], crowdScalingInstances);
+	if (crowdScalingInstances > 0 && crowdLodBoneBudget > 0)
+		measureCrowdLod(animations[IDLE], animations[DANCE], animations[MOONWALK], crowdScalingInstances, crowdLodBoneBudget);
+
+	if (samplingPath == SamplingPath::SoaSimd && !useCooked)
+	{
+		// from here on every clip is loaded with its SoaClip
+		clipManager.SetSkeleton(animator.GetSharedSkeleton());
+		for (int clip = 0; clip < CLIP_COUNT; clip++)
+			if (animations[clip])
+				animator.SetSoaClip(animations[clip], clipManager.GetSoaClip(clip));
+
+		// accuracy of the SIMD sampler against the scalar Bone path
+		if (animations[DANCE])
+		{
+			SoaSamplingError error = clipManager.GetSoaClip(DANCE)->CompareWithScalar(animator.GetSkeleton(), animations[DANCE], 1000);
+			bool withinTolerance = error.position <= soaSamplingTolerance.position && error.rotation <= soaSamplingTolerance.rotation
+				&& error.scale <= soaSamplingTolerance.scale;
+			printf("SIMD sampling (%d lanes) max error: position %g, rotation %g rad, scale %g%s\n",
+				SimdFloat::Width, error.position, error.rotation, error.scale, withinTolerance ? "" : "  MISMATCH");
+			if (!withinTolerance)
+			{
+				std::cout << "ERROR::SOA_SAMPLING:: SIMD sampling differs from the scalar path by more than the tolerance" << std::endl;
+				glfwTerminate();
+				return -1;
+			}
+		}
+	}
+
+	CompressedClip compressedClips[CLIP_COUNT];
+	if (samplingPath == SamplingPath::Compressed)
+	{
+		for (int clip = 0; clip < CLIP_COUNT; clip++)
+		{
+			compressedClips[clip] = CompressedClip(animator.GetSkeleton(), animations[clip]);
+			animator.SetCompressedClip(animations[clip], &compressedClips[clip]);
+
+			// memory saved and worst bone-space error against the uncompressed clip
+			CompressionReport report = compressedClips[clip].Measure(animator.GetSkeleton(), animations[clip], 1000);
+			printf("%s: %zu -> %zu bytes (%.1f%%), %d -> %d keys, %d constant tracks, max error: position %g, rotation %g rad, scale %g\n",
+				clipNames[clip].c_str(), report.uncompressedBytes, report.compressedBytes, 100.0 * report.compressedBytes / report.uncompressedBytes,
+				report.uncompressedKeys, report.compressedKeys, report.constantTracks,
+				report.maxPositionError, report.maxRotationError, report.maxScaleError);
+		}
+	}
+	animator.SetSamplingPath(samplingPath);
+
+	// one bake per clip; every animator playing the clip can share it
+	BakedClip bakedClips[CLIP_COUNT];
+	if (bakedPlayback != BakedPlayback::Disabled)
+	{
+		for (int clip = 0; clip < CLIP_COUNT; clip++)
+		{
+			bakedClips[clip] = BakedClip(animator.GetSkeleton(), animations[clip], bakeRate);
+			animator.SetBakedClip(animations[clip], &bakedClips[clip]);
+		}
+		animator.SetBakedPlayback(bakedPlayback);
+	}
+	if (measureBaking)
+		printBakeTradeoffs(animations[DANCE], "Breakdance");
+	if (footprintInstances > 0)
+		printInstanceFootprint(animator.GetSharedSkeleton(), animations[DANCE], animations[MOONWALK], footprintInstances);
+
+	// All three clips sit under one lerp node; a transition is just its weights moving
+	BlendTree blendTree;
+	int clipNodes[CLIP_COUNT];
+	for (int clip = 0; clip < CLIP_COUNT; clip++)
+	{
+		int slot = useCooked ? blendTree.AddClip(&cooked.GetClip(cooked.FindClip(clipNames[clip])))
+			: animations[clip] ? blendTree.AddClip(animations[clip]) : blendTree.AddClip();
+		clipNodes[clip] = blendTree.AddClipNode(slot);
+	}
+	int locomotion = blendTree.AddLerpNode({ clipNodes[IDLE], clipNodes[DANCE], clipNodes[MOONWALK] });
+	blendTree.SetRoot(locomotion);
+	animator.SetBlendTree(&blendTree);
+
+	// the crowd cycles through the three clips, a third of a second apart
+	std::unique_ptr<CrowdAnimator> crowd;
+	std::vector<glm::mat4> crowdModels;
+	TaskPool crowdPool;
+	if (crowdRenderInstances > 0)
+	{
+		crowd.reset(new CrowdAnimator(animator.GetSharedSkeleton()));
+		int crowdClips[CLIP_COUNT];
+		for (int clip = 0; clip < CLIP_COUNT; clip++)
+			crowdClips[clip] = crowd->AddClip(animations[clip]);
+		int columns = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(crowdRenderInstances))));
+		for (int i = 0; i < crowdRenderInstances; i++)
+		{
+			crowd->AddInstance(crowdClips[i % CLIP_COUNT], 0.37f * i);
+			glm::vec3 position((i % columns - (columns - 1) * 0.5f) * 0.8f, -0.4f, -1.5f - (i / columns) * 0.8f);
+			crowdModels.push_back(glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.5f)));
+		}
+	}
+
+	// an evicted clip leaves an empty slot behind, refilled when it's loaded again
+	clipManager.SetEvictCallback([&](int clip, Animation* animation, const SoaClip* soaClip)
+	{
+		blendTree.SetClip(clip, nullptr, nullptr);
+		animator.ReleaseClip(animation, soaClip);
+	});
+
+	// clips each state can move to next, prefetched while in it
+	const std::vector<int> reachableClips[CLIP_COUNT] = { { DANCE, MOONWALK }, { IDLE }, { IDLE } };
+
+	int currentClip = IDLE;
+	int lastSnapClip = -1;
 	float blendRate = 2.0f; // Adjusted blend rate for faster blending (e.g., blend in 0.5s at 60fps)
+	bool firstFrame = true;
 
 	// render loop
 	// -----------
@@ -123,211 +335,81 @@ int main()
 		processInput(window);
 
 		// --- Animation Input Handling ---
-		// Determine desired animation state based on current key presses.
-		// These flags dictate the desired state for the *next* state machine evaluation.
-		// Ensure mutual exclusivity for 'continuous' animation requests.
-		bool currentFrameRequestDance = false;
-		bool currentFrameRequestMoonwalk = false;
-
+		// LEFT/RIGHT blend into dance/moonwalk while held and back to idle once released.
+		int requestedClip = IDLE;
 		if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS) {
-			currentFrameRequestDance = true;
+			requestedClip = DANCE;
 		}
 		else if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) {
-			currentFrameRequestMoonwalk = true;
+			requestedClip = MOONWALK;
 		}
 
-		if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS) {
-			animator.PlayAnimation(&idleAnimation, NULL, 0.0f, 0.0f, 0.0f);
-			charState = IDLE;
-			blendAmount = 0.0f;
-			requestDance = false;
-			requestMoonwalk = false;
+		// 1/2/3 cut straight to a clip from its first frame, without blending
+		int snapClip = -1;
+		if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS)
+			snapClip = IDLE;
+		else if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS)
+			snapClip = DANCE;
+		else if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS)
+			snapClip = MOONWALK;
+
+		// A clip that is still loading can't be blended in yet: the state stays where it is, and so does the
+		// pose, until the clip is ready
+		if (lazyClips)
+		{
+			clipManager.Request(snapClip >= 0 ? snapClip : requestedClip);
+			for (int clip = 0; clip < CLIP_COUNT; clip++)
+				if (blendTree.GetWeight(locomotion, clip) > 0.0f)
+					clipManager.Request(clip);
+			for (int clip : reachableClips[currentClip])
+				clipManager.Prefetch(clip);
+			clipManager.Update();
+
+			for (int clip = 0; clip < CLIP_COUNT; clip++)
+				if (clipManager.IsReady(clip) && !blendTree.GetClipAnimation(clip))
+				{
+					Animation* animation = clipManager.GetAnimation(clip);
+					blendTree.SetClip(clip, animation, nullptr);
+					if (clipManager.GetSoaClip(clip))
+						animator.SetSoaClip(animation, clipManager.GetSoaClip(clip));
+				}
+			if (snapClip >= 0 && !blendTree.GetClipAnimation(snapClip))
+				snapClip = -1;
+			if (!blendTree.GetClipAnimation(requestedClip))
+				requestedClip = currentClip;
+
+			if (cookPending && clipManager.IsReady(IDLE) && clipManager.IsReady(DANCE) && clipManager.IsReady(MOONWALK))
+				cookClips();
 		}
-		else if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS) {
-			animator.PlayAnimation(&danceAnimation, NULL, 0.0f, 0.0f, 0.0f);
-			charState = DANCE;
-			blendAmount = 0.0f;
-			requestDance = true;
-			requestMoonwalk = false;
-		}
-		else if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS) {
-			animator.PlayAnimation(&moonwalkAnimation, NULL, 0.0f, 0.0f, 0.0f);
-			charState = MOONWALK;
-			blendAmount = 0.0f;
-			requestDance = false;
-			requestMoonwalk = true;
+
+		if (snapClip >= 0) {
+			requestedClip = snapClip;
+			if (snapClip != lastSnapClip)
+				blendTree.SetClipTime(snapClip, 0.0f);
+			for (int clip = 0; clip < CLIP_COUNT; clip++)
+				blendTree.SetWeight(locomotion, clip, clip == snapClip ? 1.0f : 0.0f);
 		}
-		else {
-			// If no direct 1, 2, 3 key was pressed, then use the continuous input from LEFT/RIGHT
-			requestDance = currentFrameRequestDance;
-			requestMoonwalk = currentFrameRequestMoonwalk;
+		lastSnapClip = snapClip;
+
+		// Move every weight towards its target; a clip fading in from nothing starts at its first frame
+		for (int clip = 0; clip < CLIP_COUNT; clip++) {
+			float weight = blendTree.GetWeight(locomotion, clip);
+			float target = clip == requestedClip ? 1.0f : 0.0f;
+			if (weight < BlendEpsilon && target > 0.0f)
+				blendTree.SetClipTime(clip, 0.0f);
+			if (target > weight)
+				weight = glm::min(weight + blendRate * deltaTime, target);
+			else
+				weight = glm::max(weight - blendRate * deltaTime, target);
+			blendTree.SetWeight(locomotion, clip, weight);
 		}
 
-		// Update the animator *before* processing input that changes state, but after setting request flags.
 		animator.UpdateAnimation(deltaTime);
 
-		// State machine logic
-		switch (charState) {
-		case IDLE:
-			// Ensure we are playing the idle animation if nothing else is blending
-			if (animator.m_CurrentAnimation != &idleAnimation || animator.m_CurrentAnimation2 != NULL) {
-				animator.PlayAnimation(&idleAnimation, NULL, animator.m_CurrentTime, 0.0f, 0.0f);
-			}
-
-			if (requestDance) {
-				blendAmount = 0.0f;
-				animator.PlayAnimation(&idleAnimation, &danceAnimation, animator.m_CurrentTime, 0.0f, blendAmount);
-				charState = IDLE_DANCE;
-			}
-			else if (requestMoonwalk) { // This will only be reached if requestDance is false
-				blendAmount = 0.0f;
-				animator.PlayAnimation(&idleAnimation, &moonwalkAnimation, animator.m_CurrentTime, 0.0f, blendAmount);
-				charState = IDLE_MOONWALK;
-			}
-			break;
-
-		case IDLE_DANCE:
-			blendAmount += blendRate * deltaTime;
-			if (blendAmount >= 1.0f) {
-				blendAmount = 1.0f;
-				animator.PlayAnimation(&danceAnimation, NULL, animator.m_CurrentTime2, 0.0f, 0.0f);
-				charState = DANCE;
-			}
-			else {
-				animator.PlayAnimation(&idleAnimation, &danceAnimation, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
-			}
-			// If we stop requesting dance during blend-in, blend back to idle immediately
-			if (!requestDance && animator.m_CurrentAnimation2 == &danceAnimation) {
-				blendAmount = 1.0f - blendAmount; // Reverse the blend amount to start blending out
-				animator.PlayAnimation(&danceAnimation, &idleAnimation, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
-				charState = DANCE_IDLE;
-			}
-			// If we request moonwalk during blend-in to dance, transition to blend out of dance and into moonwalk
-			else if (requestMoonwalk) {
-				blendAmount = 0.0f;
-				animator.PlayAnimation(&idleAnimation, &moonwalkAnimation, animator.m_CurrentTime, 0.0f, blendAmount); // Blend from current idle time
-				charState = IDLE_MOONWALK;
-			}
-			break;
-
-		case DANCE: // Fully dancing
-			// Guard: Ensure DANCE animation is explicitly set without blending.
-			if (animator.m_CurrentAnimation != &danceAnimation || animator.m_CurrentAnimation2 != NULL) {
-				animator.PlayAnimation(&danceAnimation, NULL, animator.m_CurrentTime, 0.0f, 0.0f);
-			}
-
-			if (!requestDance) { // Blend out if key is released
-				blendAmount = 0.0f;
-				animator.PlayAnimation(&danceAnimation, &idleAnimation, animator.m_CurrentTime, 0.0f, blendAmount);
-				charState = DANCE_IDLE;
-			}
-			else if (requestMoonwalk) { // If moonwalk is requested while dancing
-				blendAmount = 0.0f;
-				animator.PlayAnimation(&danceAnimation, &moonwalkAnimation, animator.m_CurrentTime, 0.0f, blendAmount);
-				charState = MOONWALK; // Directly switch to MOONWALK for now, or you could introduce DANCE_MOONWALK state
-			}
-			break;
-
-		case DANCE_IDLE: // Blending out of dance
-			blendAmount += blendRate * deltaTime;
-			if (blendAmount >= 1.0f) {
-				blendAmount = 1.0f;
-				animator.PlayAnimation(&idleAnimation, NULL, animator.m_CurrentTime2, 0.0f, 0.0f);
-				charState = IDLE;
-			}
-			else {
-				animator.PlayAnimation(&danceAnimation, &idleAnimation, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
-			}
-			// If dance is requested again during blend-out
-			if (requestDance && animator.m_CurrentAnimation2 == &idleAnimation) {
-				blendAmount = 1.0f - blendAmount; // Reverse the blend amount to blend back into dance
-				animator.PlayAnimation(&idleAnimation, &danceAnimation, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
-				charState = IDLE_DANCE;
-			}
-			else if (requestMoonwalk) { // If moonwalk is requested during blend-out of dance
-				blendAmount = 0.0f;
-				animator.PlayAnimation(&idleAnimation, &moonwalkAnimation, animator.m_CurrentTime, 0.0f, blendAmount);
-				charState = IDLE_MOONWALK;
-			}
-			break;
-
-		case IDLE_MOONWALK:
-			blendAmount += blendRate * deltaTime;
-			if (blendAmount >= 1.0f) {
-				blendAmount = 1.0f;
-				animator.PlayAnimation(&moonwalkAnimation, NULL, animator.m_CurrentTime2, 0.0f, 0.0f);
-				charState = MOONWALK;
-			}
-			else {
-				animator.PlayAnimation(&idleAnimation, &moonwalkAnimation, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
-			}
-			// If we stop requesting moonwalk during blend-in, blend back to idle immediately
-			if (!requestMoonwalk && animator.m_CurrentAnimation2 == &moonwalkAnimation) {
-				blendAmount = 1.0f - blendAmount; // Reverse the blend amount
-				animator.PlayAnimation(&moonwalkAnimation, &idleAnimation, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
-				charState = MOONWALK_IDLE;
-			}
-			else if (requestDance) { // If dance is requested during blend-in to moonwalk
-				blendAmount = 0.0f;
-				animator.PlayAnimation(&idleAnimation, &danceAnimation, animator.m_CurrentTime, 0.0f, blendAmount);
-				charState = IDLE_DANCE;
-			}
-			break;
-
-		case MOONWALK: // Fully moonwalking
-			if (animator.m_CurrentAnimation != &moonwalkAnimation || animator.m_CurrentAnimation2 != NULL) {
-				animator.PlayAnimation(&moonwalkAnimation, NULL, animator.m_CurrentTime, 0.0f, 0.0f);
-			}
-
-			if (!requestMoonwalk) { // Blend out if key is released
-				blendAmount = 0.0f;
-				animator.PlayAnimation(&moonwalkAnimation, &idleAnimation, animator.m_CurrentTime, 0.0f, blendAmount);
-				charState = MOONWALK_IDLE;
-			}
-			else if (requestDance) { // If dance is requested while moonwalking
-				blendAmount = 0.0f;
-				animator.PlayAnimation(&moonwalkAnimation, &idleAnimation, animator.m_CurrentTime, 0.0f, blendAmount);
-				charState = DANCE; // Directly switch to DANCE for now
-			}
-			break;
-
-		case MOONWALK_IDLE: // Blending out of moonwalk
-			blendAmount += blendRate * deltaTime;
-			if (blendAmount >= 1.0f) {
-				blendAmount = 1.0f;
-				animator.PlayAnimation(&idleAnimation, NULL, animator.m_CurrentTime2, 0.0f, 0.0f);
-				charState = IDLE;
-			}
-			else {
-				animator.PlayAnimation(&moonwalkAnimation, &idleAnimation, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
-			}
-			// If moonwalk is requested again during blend-out
-			if (requestMoonwalk && animator.m_CurrentAnimation2 == &idleAnimation) {
-				blendAmount = 1.0f - blendAmount; // Reverse the blend amount
-				animator.PlayAnimation(&idleAnimation, &moonwalkAnimation, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
-				charState = IDLE_MOONWALK;
-			}
-			else if (requestDance) { // If dance is requested during blend-out of moonwalk
-				blendAmount = 0.0f;
-				animator.PlayAnimation(&idleAnimation, &danceAnimation, animator.m_CurrentTime, 0.0f, blendAmount);
-				charState = IDLE_DANCE;
-			}
-			break;
-		}
-
 		// For debugging state changes
-		static AnimState lastCharState = IDLE;
-		if (charState != lastCharState) {
-			switch (charState) {
-			case IDLE: printf("STATE: IDLE\n"); break;
-			case IDLE_DANCE: printf("STATE: IDLE_DANCE (Blending in)\n"); break;
-			case DANCE: printf("STATE: DANCE (Playing full animation)\n"); break;
-			case DANCE_IDLE: printf("STATE: DANCE_IDLE (Blending out)\n"); break;
-			case IDLE_MOONWALK: printf("STATE: IDLE_MOONWALK (Blending in)\n"); break;
-			case MOONWALK: printf("STATE: MOONWALK (Playing full animation)\n"); break;
-			case MOONWALK_IDLE: printf("STATE: MOONWALK_IDLE (Blending out)\n"); break;
-			}
-			lastCharState = charState;
+		if (requestedClip != currentClip) {
+			printf("STATE: %s\n", clipNames[requestedClip].c_str());
+			currentClip = requestedClip;
 		}
 
 		// render
@@ -342,9 +424,7 @@ int main()
 		ourShader.setMat4("projection", projection);
 		ourShader.setMat4("view", view);
 
-		auto transforms = animator.GetFinalBoneMatrices();
-		for (int i = 0; i < transforms.size(); ++i)
-			ourShader.setMat4("finalBonesMatrices[" + std::to_string(i) + "]", transforms[i]);
+		bonePalette.Upload(animator.GetFinalBoneMatrices());
 
 
 		// render the loaded model
@@ -354,13 +434,31 @@ int main()
 		ourShader.setMat4("model", model);
 		ourModel.Draw(ourShader);
 
+		if (crowd)
+		{
+			crowd->Update(deltaTime, crowdPool);
+			instancePalette.SetInstances(crowdModels.data(), crowd->GetPalettes().data(), crowdRenderInstances, crowd->GetBoneCount());
+			instancePalette.Draw(ourModel, ourShader);
+		}
+
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
 		glfwSwapBuffers(window);
 		glfwPollEvents();
+
+		if (firstFrame)
+		{
+			printf("first frame %.1f ms after loading started (%s)\n",
+				std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupStart).count(),
+				useCooked ? "cooked clips" : lazyClips ? "lazy DAE clips" : "eager DAE clips");
+			firstFrame = false;
+		}
 	}
 
+	if (!useCooked)
+		printf("peak clip memory %.1f KB, %d evictions\n", clipManager.GetPeakMemoryUsage() / 1024.0, clipManager.GetEvictionCount());
+
 	// glfw: terminate, clearing all previously allocated GLFW resources.
 	// ------------------------------------------------------------------
 	glfwTerminate();
@@ -384,6 +482,166 @@ void processInput(GLFWwindow* window)
 		camera.ProcessKeyboard(RIGHT, deltaTime);
 }
 
+// animates a crowd sharing the three clips with 1, 2, 4, 8 and 16 threads and prints the time per update
+// ---------------------------------------------------------------------------------------------------------
+void measureCrowdScaling(Animation* idle, Animation* dance, Animation* moonwalk, int instanceCount)
+{
+	CrowdAnimator crowd(idle);
+	int clips[3] = { crowd.AddClip(idle), crowd.AddClip(dance), crowd.AddClip(moonwalk) };
+	for (int i = 0; i < instanceCount; i++)
+	{
+		int instance = crowd.AddInstance(clips[i % 3], static_cast<float>(i));
+		// every fourth character blends into another clip, like the state machine does during transitions
+		if (i % 4 == 0)
+			crowd.PlayAnimation(instance, clips[i % 3], clips[(i + 1) % 3], static_cast<float>(i), 0.0f, 0.5f);
+	}
+
+	const int frames = 60;
+	double singleThreadMs = 0.0;
+	for (int threads = 1; threads <= 16; threads *= 2)
+	{
+		TaskPool pool(threads);
+		crowd.Update(1.0f / 60.0f, pool); // warm up caches and per-thread scratch
+
+		auto start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < frames; frame++)
+			crowd.Update(1.0f / 60.0f, pool);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+		if (threads == 1)
+			singleThreadMs = ms;
+
+		printf("crowd of %d: %2d threads %8.3f ms per update (%.2fx)\n", instanceCount, threads, ms, singleThreadMs / ms);
+	}
+}
+
+// Time per update and bone evaluations per frame of a crowd spread from 0 to 80 units away, a third of it
+// off-screen, with full-rate updates, LOD only, and LOD under the bone budget
+// ---------------------------------------------------------------------------------------------------------
+void measureCrowdLod(Animation* idle, Animation* dance, Animation* moonwalk, int instanceCount, int boneBudget)
+{
+	CrowdAnimator crowd(idle);
+	int clips[3] = { crowd.AddClip(idle), crowd.AddClip(dance), crowd.AddClip(moonwalk) };
+	for (int i = 0; i < instanceCount; i++)
+		crowd.AddInstance(clips[i % 3], static_cast<float>(i));
+
+	TaskPool pool;
+	const int frames = 120;
+	const float dt = 1.0f / 60.0f;
+	printf("crowd of %d, %d bone evaluations each\n", instanceCount, crowd.GetSkeleton().GetNodeCount());
+	printf("  %-16s %10s %8s %8s %12s %12s\n", "mode", "ms/update", "updated", "deferred", "evaluated", "skipped");
+
+	for (int mode = 0; mode < 3; mode++)
+	{
+		AnimationLodSettings settings;
+		settings.boneBudget = mode == 2 ? boneBudget : 0;
+		AnimationLodScheduler lod(settings);
+		lod.Resize(instanceCount);
+		for (int i = 0; i < instanceCount; i++)
+			lod.SetView(i, 80.0f * i / instanceCount, i % 3 != 0);
+
+		double ms = 0.0;
+		AnimationLodStats total;
+		for (int frame = 0; frame < frames; frame++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			if (mode == 0)
+				crowd.Update(dt, pool);
+			else
+				crowd.Update(dt, pool, lod);
+			ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			const AnimationLodStats& stats = lod.GetStats();
+			total.updated += mode == 0 ? instanceCount : stats.updated;
+			total.deferred += stats.deferred;
+			total.boneEvaluations += mode == 0 ? instanceCount * crowd.GetSkeleton().GetNodeCount() : stats.boneEvaluations;
+			total.skippedBoneEvaluations += stats.skippedBoneEvaluations;
+		}
+
+		const char* names[3] = { "full rate", "LOD", "LOD + budget" };
+		printf("  %-16s %10.3f %8d %8d %12d %12d\n", names[mode], ms / frames, total.updated / frames, total.deferred / frames,
+			total.boneEvaluations / frames, total.skippedBoneEvaluations / frames);
+	}
+}
+
+// Memory, update cost and worst palette error (largest matrix element difference against live sampling) of
+// baked playback at a few rates
+void printBakeTradeoffs(Animation* animation, const char* name)
+{
+	const int frames = 2000;
+	const float dt = 1.0f / 60.0f;
+
+	Animator live(animation);
+	std::vector<std::vector<BoneMatrix>> reference;
+	auto start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < frames; frame++)
+	{
+		live.UpdateAnimation(dt);
+		reference.push_back(live.GetFinalBoneMatrices());
+	}
+	double liveUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / frames;
+
+	printf("%s baked playback (%d bones)\n", name, live.GetSkeleton().GetBoneCount());
+	printf("  %-22s %10s %12s %12s\n", "mode", "memory", "us/update", "max error");
+	printf("  %-22s %10s %12.2f %12s\n", "live sampling", "-", liveUs, "-");
+
+	const float rates[] = { 15.0f, 30.0f, 60.0f };
+	for (float rate : rates)
+	{
+		BakedClip baked(live.GetSkeleton(), animation, rate);
+		for (BakedPlayback playback : { BakedPlayback::Nearest, BakedPlayback::Interpolated })
+		{
+			Animator animator(animation);
+			animator.SetBakedClip(animation, &baked);
+			animator.SetBakedPlayback(playback);
+
+			double us = 0.0;
+			float maxError = 0.0f;
+			for (int frame = 0; frame < frames; frame++)
+			{
+				auto frameStart = std::chrono::steady_clock::now();
+				animator.UpdateAnimation(dt);
+				us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - frameStart).count();
+
+				for (int bone = 0; bone < baked.GetBoneCount(); bone++)
+					for (int column = 0; column < 3; column++)
+					{
+						glm::vec4 difference = glm::abs(animator.GetFinalBoneMatrices()[bone][column] - reference[frame][bone][column]);
+						maxError = glm::max(maxError, glm::max(glm::max(difference.x, difference.y), glm::max(difference.z, difference.w)));
+					}
+			}
+
+			char mode[32];
+			snprintf(mode, sizeof(mode), "%2.0f Hz %s", rate, playback == BakedPlayback::Nearest ? "nearest" : "interpolated");
+			printf("  %-22s %8.1fKB %12.2f %12g\n", mode, baked.GetMemorySize() / 1024.0, us / frames, maxError);
+		}
+	}
+}
+
+// Per-instance and total memory of animators that share one skeleton, each blending two clips, against the
+// 4 KB per instance target
+// ------------------------------------------------------------------------------------------------------
+void printInstanceFootprint(const std::shared_ptr<const Skeleton>& skeleton, Animation* clip1, Animation* clip2, int instanceCount)
+{
+	std::vector<Animator> animators;
+	animators.reserve(instanceCount);
+	size_t instanceBytes = 0;
+	for (int i = 0; i < instanceCount; i++)
+	{
+		animators.emplace_back(skeleton);
+		animators.back().PlayAnimation(clip1, clip2, static_cast<float>(i), 0.0f, 0.5f);
+		animators.back().UpdateAnimation(0.0f); // binds both clips
+		instanceBytes += animators.back().GetMemorySize();
+	}
+
+	CrowdAnimator crowd(skeleton);
+	printf("%d bones, %d nodes, shared skeleton %.1f KB\n", skeleton->GetBoneCount(), skeleton->GetNodeCount(), skeleton->GetMemorySize() / 1024.0);
+	printf("  Animator:       %6zu bytes per instance (%s 4 KB), %.2f MB for %d\n", instanceBytes / instanceCount,
+		instanceBytes / instanceCount < 4096 ? "under" : "over", instanceBytes / (1024.0 * 1024.0), instanceCount);
+	printf("  CrowdAnimator:  %6zu bytes per instance (%s 4 KB), %.2f MB for %d\n", crowd.GetInstanceMemorySize(),
+		crowd.GetInstanceMemorySize() < 4096 ? "under" : "over", crowd.GetInstanceMemorySize() * instanceCount / (1024.0 * 1024.0), instanceCount);
+	printf("  of which a palette is %zu bytes (%zu per bone), three of them for LOD crowds\n", skeleton->GetBoneCount() * sizeof(BoneMatrix), sizeof(BoneMatrix));
+}
+
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
 // ---------------------------------------------------------------------------------------------
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
@@ -0,0 +1,239 @@
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/animator.h>
+#include <learnopengl/blend_tree.h>
+#include <learnopengl/cooked_animation.h>
+#include <learnopengl/cpu_skinning.h>
+#include <learnopengl/task_pool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Headless: nothing here touches OpenGL, so it runs without a GPU or a display
+
+bool loadSkinnedMesh(const std::string& path, std::map<std::string, BoneInfo>& boneInfoMap, SkinningMesh& mesh);
+std::vector<glm::mat4> posePalette(const CookedAnimationFile& cooked, int clip, float seconds);
+void buildSyntheticMesh(int vertexCount, int boneCount, SkinningMesh& mesh, std::vector<glm::mat4>& palette);
+void benchmark(const char* name, SkinningMesh& mesh, const std::vector<glm::mat4>& palette);
+
+// settings
+const int syntheticVertexCount = 1000000;
+const int syntheticBoneCount = 100; // MAX_BONES in anim_model.vs
+const double secondsPerMeasurement = 0.5;
+
+int main()
+{
+	// skelly is posed with the dance clip from the cooked file the skeletal_animation demo writes, whose bone
+	// ids are the ones that demo's Model assigned
+	const std::string modelPath = FileSystem::getPath("resources/objects/skelly/skelly.dae");
+	const std::vector<std::string> sourcePaths = {
+		modelPath,
+		FileSystem::getPath("resources/objects/skelly/Idle.dae"),
+		FileSystem::getPath("resources/objects/skelly/Breakdance_1990.dae"),
+		FileSystem::getPath("resources/objects/skelly/Moonwalk.dae")
+	};
+	CookedAnimationFile cooked;
+	int clip = cooked.Open(FileSystem::getPath("resources/objects/skelly/skelly.animcooked"), sourcePaths) ? cooked.FindClip("DANCE") : -1;
+	if (clip < 0)
+		printf("no cooked clips (run skeletal_animation once to write them), skinning skelly in its bind pose\n");
+
+	std::map<std::string, BoneInfo> boneInfoMap;
+	if (clip >= 0)
+		boneInfoMap = cooked.GetBoneInfoMap();
+	SkinningMesh skelly;
+	if (loadSkinnedMesh(modelPath, boneInfoMap, skelly))
+	{
+		std::vector<glm::mat4> palette = clip >= 0 ? posePalette(cooked, clip, 1.0f)
+			: std::vector<glm::mat4>(glm::max(1, static_cast<int>(boneInfoMap.size())), glm::mat4(1.0f));
+		benchmark("skelly", skelly, palette);
+	}
+	else
+		printf("could not load %s\n", modelPath.c_str());
+
+	SkinningMesh synthetic;
+	std::vector<glm::mat4> syntheticPalette;
+	buildSyntheticMesh(syntheticVertexCount, syntheticBoneCount, synthetic, syntheticPalette);
+	benchmark("synthetic", synthetic, syntheticPalette);
+	return 0;
+}
+
+// Reads every mesh of the file with the same post-processing and bone id rules as Model: ids come from
+// boneInfoMap, bones it doesn't know yet are appended in the order they're met, and each vertex keeps its
+// first four influences
+// ------------------------------------------------------------------------------------------------------------
+bool loadSkinnedMesh(const std::string& path, std::map<std::string, BoneInfo>& boneInfoMap, SkinningMesh& mesh)
+{
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace);
+	if (!scene || !scene->mRootNode)
+		return false;
+
+	std::vector<const aiNode*> stack = { scene->mRootNode };
+	while (!stack.empty())
+	{
+		const aiNode* node = stack.back();
+		stack.pop_back();
+		// Model recurses depth first, children in order
+		for (unsigned int i = node->mNumChildren; i > 0; i--)
+			stack.push_back(node->mChildren[i - 1]);
+
+		for (unsigned int m = 0; m < node->mNumMeshes; m++)
+		{
+			const aiMesh* source = scene->mMeshes[node->mMeshes[m]];
+			std::vector<glm::ivec4> boneIds(source->mNumVertices, glm::ivec4(-1));
+			std::vector<glm::vec4> weights(source->mNumVertices, glm::vec4(0.0f));
+			for (unsigned int b = 0; b < source->mNumBones; b++)
+			{
+				const aiBone* bone = source->mBones[b];
+				auto found = boneInfoMap.find(bone->mName.C_Str());
+				if (found == boneInfoMap.end())
+				{
+					BoneInfo info;
+					info.id = static_cast<int>(boneInfoMap.size());
+					info.offset = glm::mat4(1.0f);
+					found = boneInfoMap.emplace(bone->mName.C_Str(), info).first;
+				}
+				for (unsigned int w = 0; w < bone->mNumWeights; w++)
+				{
+					unsigned int vertex = bone->mWeights[w].mVertexId;
+					for (int slot = 0; slot < SkinningMesh::MaxInfluences; slot++)
+						if (boneIds[vertex][slot] < 0)
+						{
+							boneIds[vertex][slot] = found->second.id;
+							weights[vertex][slot] = bone->mWeights[w].mWeight;
+							break;
+						}
+				}
+			}
+
+			mesh.Reserve(mesh.GetVertexCount() + static_cast<int>(source->mNumVertices));
+			for (unsigned int v = 0; v < source->mNumVertices; v++)
+			{
+				glm::vec3 normal = source->HasNormals() ? glm::vec3(source->mNormals[v].x, source->mNormals[v].y, source->mNormals[v].z) : glm::vec3(0.0f);
+				mesh.AddVertex(glm::vec3(source->mVertices[v].x, source->mVertices[v].y, source->mVertices[v].z), normal, boneIds[v], weights[v]);
+			}
+		}
+	}
+	return mesh.GetVertexCount() > 0;
+}
+
+// Palette of a cooked clip at the given time, through the same blend tree path the demo uses
+// -------------------------------------------------------------------------------------------
+std::vector<glm::mat4> posePalette(const CookedAnimationFile& cooked, int clip, float seconds)
+{
+	Animator animator(cooked.GetSharedSkeleton());
+	BlendTree tree;
+	tree.SetRoot(tree.AddClipNode(tree.AddClip(&cooked.GetClip(clip))));
+	animator.SetBlendTree(&tree);
+	animator.UpdateAnimation(seconds);
+
+	// the skinning kernels take full matrices
+	std::vector<glm::mat4> palette;
+	for (const BoneMatrix& bone : animator.GetFinalBoneMatrices())
+		palette.push_back(ToMat4(bone));
+	return palette;
+}
+
+// Random points on a unit cube with random unit normals, skinned to up to four random bones of a palette of
+// random rigid transforms. One vertex in four has fewer influences, padded with -1 like real meshes.
+// ---------------------------------------------------------------------------------------------------------
+void buildSyntheticMesh(int vertexCount, int boneCount, SkinningMesh& mesh, std::vector<glm::mat4>& palette)
+{
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::uniform_int_distribution<int> anyBone(0, boneCount - 1);
+	auto randomDirection = [&]()
+	{
+		glm::vec3 direction(unit(random), unit(random), unit(random));
+		return glm::dot(direction, direction) > 1e-6f ? glm::normalize(direction) : glm::vec3(0.0f, 1.0f, 0.0f);
+	};
+
+	palette.resize(boneCount);
+	for (glm::mat4& bone : palette)
+	{
+		glm::vec3 translation(unit(random), unit(random), unit(random));
+		bone = glm::rotate(glm::translate(glm::mat4(1.0f), translation), unit(random) * glm::pi<float>(), randomDirection());
+	}
+
+	mesh.Reserve(vertexCount);
+	for (int v = 0; v < vertexCount; v++)
+	{
+		int influences = v % 4 == 0 ? 1 + v / 4 % SkinningMesh::MaxInfluences : SkinningMesh::MaxInfluences;
+		glm::ivec4 boneIds(-1);
+		glm::vec4 weights(0.0f);
+		float total = 0.0f;
+		for (int i = 0; i < influences; i++)
+		{
+			boneIds[i] = anyBone(random);
+			weights[i] = 0.1f + 0.5f * (unit(random) + 1.0f);
+			total += weights[i];
+		}
+		mesh.AddVertex(glm::vec3(unit(random), unit(random), unit(random)), randomDirection(), boneIds, weights / total);
+	}
+}
+
+// Vertices per second of the shader-order reference and of the SIMD kernel on 1, 2, 4... threads, with the
+// largest component difference between the two outputs
+// -------------------------------------------------------------------------------------------------------------
+void benchmark(const char* name, SkinningMesh& mesh, const std::vector<glm::mat4>& palette)
+{
+	int vertexCount = mesh.GetVertexCount();
+	int boneCount = static_cast<int>(palette.size());
+	std::vector<glm::vec3> referencePositions(vertexCount), referenceNormals(vertexCount);
+	std::vector<glm::vec3> positions(vertexCount), normals(vertexCount);
+
+	// repeats skin for about secondsPerMeasurement after one warm-up run
+	auto verticesPerSecond = [&](const auto& skin)
+	{
+		skin();
+		int runs = 0;
+		double seconds = 0.0;
+		auto start = std::chrono::steady_clock::now();
+		do
+		{
+			skin();
+			runs++;
+			seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		} while (seconds < secondsPerMeasurement);
+		return static_cast<double>(vertexCount) * runs / seconds;
+	};
+
+	printf("%s: %d vertices, %d bones\n", name, vertexCount, boneCount);
+	double referenceRate = verticesPerSecond([&]() { mesh.SkinReference(palette.data(), boneCount, referencePositions.data(), referenceNormals.data()); });
+	printf("  %-20s %10.1f Mverts/s\n", "scalar reference", referenceRate / 1e6);
+
+	int maxThreads = glm::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+	for (int threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		TaskPool pool(threads);
+		double rate = verticesPerSecond([&]() { mesh.Skin(palette.data(), boneCount, positions.data(), normals.data(), &pool); });
+
+		float positionError = 0.0f;
+		float normalError = 0.0f;
+		for (int v = 0; v < vertexCount; v++)
+		{
+			glm::vec3 positionDifference = glm::abs(positions[v] - referencePositions[v]);
+			glm::vec3 normalDifference = glm::abs(normals[v] - referenceNormals[v]);
+			positionError = glm::max(positionError, glm::max(positionDifference.x, glm::max(positionDifference.y, positionDifference.z)));
+			normalError = glm::max(normalError, glm::max(normalDifference.x, glm::max(normalDifference.y, normalDifference.z)));
+		}
+
+		char mode[32];
+		snprintf(mode, sizeof(mode), "SIMD, %d thread%s", threads, threads == 1 ? "" : "s");
+		printf("  %-20s %10.1f Mverts/s (%.2fx)  max error: position %g, normal %g\n",
+			mode, rate / 1e6, rate / referenceRate, positionError, normalError);
+	}
+}